@@ -0,0 +1,134 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Counts allocations of loading a motion and of authoring one in bulk
+// from name-keyed maps, as an editor or a converter would.
+//
+// usage: bench_allocations [keyframes] [joints] [effectors]
+
+#include <flom/frame.hpp>
+#include <flom/motion.hpp>
+#include <flom/range.hpp>
+
+#include "bench.hpp"
+#include "memory.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+using PositionsMap = std::unordered_map<std::string, double>;
+using EffectorsMap = std::unordered_map<std::string, flom::Effector>;
+
+std::vector<std::pair<PositionsMap, EffectorsMap>>
+to_maps(const flom::Motion &m) {
+  std::vector<std::pair<PositionsMap, EffectorsMap>> maps;
+  for (auto const &[t, frame] : m.const_keyframes()) {
+    maps.emplace_back(frame.positions().to_map(), frame.effectors().to_map());
+  }
+  return maps;
+}
+
+// Runs f once and prints its time and allocations per keyframe
+template <typename F>
+void measure(const std::string &name, std::size_t keyframes, F &&f) {
+  namespace bench = flom::bench;
+
+  bench::reset_allocation_stats();
+  auto const start = std::chrono::steady_clock::now();
+  f();
+  auto const end = std::chrono::steady_clock::now();
+  auto const stats = bench::allocation_stats();
+
+  std::chrono::duration<double, std::nano> const elapsed = end - start;
+  auto const n = static_cast<double>(keyframes);
+  bench::print_result(name, elapsed.count() / n, "ns/keyframe");
+  bench::print_result(name + ": allocations",
+                      static_cast<double>(stats.count) / n, "/keyframe");
+  bench::print_result(name + ": allocated",
+                      static_cast<double>(stats.bytes) / n, "B/keyframe");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 10000);
+  auto const joints = arg_or(argc, argv, 2, 30);
+  auto const effectors = arg_or(argc, argv, 3, 4);
+
+  std::cout << keyframes << " keyframes, " << joints << " joints, "
+            << effectors << " effectors" << std::endl;
+
+  auto const source = bench::synthesize_motion(joints, effectors, keyframes);
+
+  std::ostringstream os;
+  source.dump(os);
+  std::istringstream is{os.str()};
+  measure("load", keyframes, [&] {
+    bench::do_not_optimize(flom::Motion::load(is));
+  });
+
+  auto maps = to_maps(source);
+  measure("author: Frame from maps", keyframes, [&] {
+    auto m = source;
+    m.clear_keyframes();
+    std::vector<std::pair<double, flom::Frame>> frames;
+    frames.reserve(keyframes);
+    for (std::size_t k = 0; k < keyframes; k++) {
+      auto &[frame_positions, frame_effectors] = maps[k];
+      frames.emplace_back(static_cast<double>(k) / 10,
+                          flom::Frame{std::move(frame_positions),
+                                      std::move(frame_effectors)});
+    }
+    m.insert_keyframes(std::move(frames));
+    bench::do_not_optimize(m);
+  });
+
+  maps = to_maps(source);
+  measure("author: setters", keyframes, [&] {
+    auto m = source;
+    m.clear_keyframes();
+    auto frame = m.new_keyframe();
+    for (std::size_t k = 0; k < keyframes; k++) {
+      auto &[frame_positions, frame_effectors] = maps[k];
+      frame.set_positions(std::move(frame_positions));
+      frame.set_effectors(std::move(frame_effectors));
+      m.insert_keyframe(static_cast<double>(k) / 10, frame);
+    }
+    bench::do_not_optimize(m);
+  });
+
+  return EXIT_SUCCESS;
+}
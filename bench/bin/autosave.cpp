@@ -0,0 +1,85 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Measures periodic autosave of a large motion being edited: each save
+// follows an edit of one keyframe, as an editor saving every few seconds.
+//
+// usage: bench_autosave [keyframes] [saves] [joints] [effectors]
+
+#include <flom/motion.hpp>
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 100000);
+  auto const saves = arg_or(argc, argv, 2, 20);
+  auto const joints = arg_or(argc, argv, 3, 30);
+  auto const effectors = arg_or(argc, argv, 4, 4);
+
+  std::cout << keyframes << " keyframes, " << saves << " saves, " << joints
+            << " joints, " << effectors << " effectors" << std::endl;
+
+  auto motion = bench::synthesize_motion(joints, effectors, keyframes);
+  auto const frame = motion.new_keyframe();
+  // Replaces a keyframe in the middle, or appends one
+  auto const edit = [&](std::size_t i) {
+    auto const t = i % 2 == 0 ? motion.length() / 2 : motion.length() + 0.1;
+    motion.insert_keyframe(t, frame);
+  };
+
+  bench::print_result("is_valid", bench::ns_per_op(1000, [&](auto) {
+                        bench::do_not_optimize(motion.is_valid());
+                      }),
+                      "ns/op");
+  bench::print_result("edit", bench::ns_per_op(saves, edit) / 1e3, "us/save");
+
+  std::ostringstream os;
+  auto const save = [&](const std::string &name, auto &&dump) {
+    bench::print_result(name, bench::ns_per_op(saves, [&](auto i) {
+                          edit(i);
+                          os.str({});
+                          dump(os);
+                          bench::do_not_optimize(os);
+                        }) / 1e6,
+                        "ms/save");
+  };
+  save("edit + dump", [&](auto &o) { motion.dump(o); });
+  save("edit + dump_columnar", [&](auto &o) { motion.dump_columnar(o); });
+  save("edit + dump_json", [&](auto &o) { motion.dump_json(o); });
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Measures copying a motion and holding many copies at once,
+// and the cost of the first modification of a copy.
+//
+// usage: bench_copy [copies] [keyframes] [joints] [effectors]
+
+#include <flom/motion.hpp>
+
+#include "bench.hpp"
+#include "memory.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const copies = arg_or(argc, argv, 1, 100);
+  auto const keyframes = arg_or(argc, argv, 2, 10000);
+  auto const joints = arg_or(argc, argv, 3, 30);
+  auto const effectors = arg_or(argc, argv, 4, 4);
+
+  std::cout << copies << " copies, " << keyframes << " keyframes, " << joints
+            << " joints, " << effectors << " effectors" << std::endl;
+
+  auto const source = bench::synthesize_motion(joints, effectors, keyframes);
+
+  std::vector<flom::Motion> motions;
+  motions.reserve(copies);
+  bench::reset_allocation_stats();
+  auto const live_before = bench::allocation_stats().live_bytes;
+  auto const copy_ns = bench::ns_per_op(
+      copies, [&](auto) { motions.push_back(source); });
+  auto const stats = bench::allocation_stats();
+  auto const held_kib =
+      static_cast<double>(stats.live_bytes - live_before) / 1024;
+
+  bench::print_result("copy", copy_ns, "ns/op");
+  bench::print_result("copy: allocations",
+                      static_cast<double>(stats.count) /
+                          static_cast<double>(copies),
+                      "/op");
+  bench::print_result("copies: heap", held_kib, "KiB");
+
+  auto const set_loop_ns = bench::ns_per_op(copies, [&](auto i) {
+    motions[i].set_loop(flom::LoopType::Wrap);
+  });
+  bench::print_result("first set_loop of a copy", set_loop_ns, "ns/op");
+
+  auto const frame = source.new_keyframe();
+  auto const insert_ns = bench::ns_per_op(copies, [&](auto i) {
+    motions[i].insert_keyframe(source.length() + 1, frame);
+  });
+  bench::print_result("first insert_keyframe of a copy", insert_ns, "ns/op");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Measures writing a large motion to a file in each format.
+//
+// usage: bench_dump [keyframes] [dumps] [joints] [effectors]
+
+#include <flom/motion.hpp>
+
+#include "bench.hpp"
+#include "memory.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+constexpr auto path = "bench_dump.out";
+
+// Calls dump(stream) for each dump and prints time and peak heap per dump
+template <typename F>
+void measure(const std::string &name, std::size_t dumps, F &&dump) {
+  namespace bench = flom::bench;
+
+  bench::reset_allocation_stats();
+  auto const live = bench::allocation_stats().live_bytes;
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < dumps; i++) {
+    std::ofstream f{path, std::ios::binary | std::ios::trunc};
+    dump(f);
+  }
+  auto const end = std::chrono::steady_clock::now();
+  auto const stats = bench::allocation_stats();
+
+  std::ifstream f{path, std::ios::binary | std::ios::ate};
+  auto const mb = static_cast<double>(f.tellg()) / 1e6;
+  std::chrono::duration<double, std::nano> const elapsed = end - start;
+  auto const n = static_cast<double>(dumps);
+  bench::print_result(name, elapsed.count() / n / 1e6, "ms/dump");
+  bench::print_result(name + ": size", mb, "MB");
+  bench::print_result(name + ": throughput",
+                      mb * n / (elapsed.count() / 1e9), "MB/s");
+  bench::print_result(name + ": peak heap",
+                      static_cast<double>(stats.peak_bytes - live) / 1e6,
+                      "MB");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 20000);
+  auto const dumps = arg_or(argc, argv, 2, 5);
+  auto const joints = arg_or(argc, argv, 3, 30);
+  auto const effectors = arg_or(argc, argv, 4, 4);
+
+  std::cout << keyframes << " keyframes, " << joints << " joints, "
+            << effectors << " effectors" << std::endl;
+
+  auto const motion = bench::synthesize_motion(joints, effectors, keyframes);
+
+  measure("Motion::dump", dumps, [&](auto &f) { motion.dump(f); });
+  measure("Motion::dump_columnar", dumps,
+          [&](auto &f) { motion.dump_columnar(f); });
+  measure("Motion::dump_json", dumps, [&](auto &f) { motion.dump_json(f); });
+  flom::JSONFormat name_table;
+  name_table.name_table = true;
+  measure("Motion::dump_json (name table)", dumps,
+          [&](auto &f) { motion.dump_json(f, name_table); });
+  measure("Motion::dump_json_string", dumps,
+          [&](auto &f) { f << motion.dump_json_string(); });
+
+  std::remove(path);
+
+  return EXIT_SUCCESS;
+}
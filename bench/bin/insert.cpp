@@ -0,0 +1,111 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares validation and insertion of frames laid out by the motion
+// with frames in another (equivalent) layout, and bulk insertion.
+//
+// usage: bench_insert [keyframes] [joints] [effectors]
+
+#include <flom/frame.hpp>
+#include <flom/frame_schema.hpp>
+#include <flom/motion.hpp>
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 10000);
+  auto const joints = arg_or(argc, argv, 2, 30);
+  auto const effectors = arg_or(argc, argv, 3, 4);
+
+  std::cout << keyframes << " keyframes, " << joints << " joints, "
+            << effectors << " effectors" << std::endl;
+
+  auto const source = bench::synthesize_motion(joints, effectors, 1);
+  auto const own = source.frame_at(0);
+  // Same names in another schema object, as a frame from other code would be
+  auto const &schema = *own.schema();
+  auto const foreign = own.rebind(std::make_shared<const flom::FrameSchema>(
+      flom::NameTable{{std::cbegin(schema.joints().names()),
+                       std::cend(schema.joints().names())}},
+      flom::NameTable{{std::cbegin(schema.effectors().names()),
+                       std::cend(schema.effectors().names())}}));
+
+  bench::print_result("is_valid_frame (own)",
+                      bench::ns_per_op(keyframes,
+                                       [&](auto) {
+                                         bench::do_not_optimize(
+                                             source.is_valid_frame(own));
+                                       }),
+                      "ns/op");
+  bench::print_result("is_valid_frame (foreign)",
+                      bench::ns_per_op(keyframes,
+                                       [&](auto) {
+                                         bench::do_not_optimize(
+                                             source.is_valid_frame(foreign));
+                                       }),
+                      "ns/op");
+
+  for (auto const *frame : {&own, &foreign}) {
+    auto motion = source;
+    bench::print_result(frame == &own ? "insert_keyframe (own)"
+                                      : "insert_keyframe (foreign)",
+                        bench::ns_per_op(keyframes,
+                                         [&](auto i) {
+                                           motion.insert_keyframe(
+                                               static_cast<double>(i + 1),
+                                               *frame);
+                                         }),
+                        "ns/op");
+  }
+
+  {
+    auto motion = source;
+    std::vector<std::pair<double, flom::Frame>> frames;
+    frames.reserve(keyframes);
+    for (std::size_t i = 0; i < keyframes; i++) {
+      frames.emplace_back(static_cast<double>(i + 1), own);
+    }
+    auto const ns = bench::ns_per_op(
+        1, [&](auto) { motion.insert_keyframes(std::move(frames)); });
+    bench::print_result("insert_keyframes (own)",
+                        ns / static_cast<double>(keyframes), "ns/op");
+  }
+
+  return EXIT_SUCCESS;
+}
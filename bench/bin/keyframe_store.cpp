@@ -0,0 +1,229 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares the columnar keyframe storage of flom::Motion
+// with a std::map<double, flom::Frame> holding the same keyframes.
+//
+// Copying a single frame out costs about the same in both, so lookups
+// exactly at keyframes are only faster with sample, which writes rows
+// without materializing frames.
+//
+// usage: bench_keyframe_store [keyframes] [joints] [effectors]
+
+#include <flom/frame.hpp>
+#include <flom/interpolation.hpp>
+#include <flom/motion.hpp>
+#include <flom/range.hpp>
+#include <flom/sample_buffer.hpp>
+
+#include "bench.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using FrameMap = std::map<double, flom::Frame>;
+
+constexpr std::size_t sample_batch = 1000;
+
+flom::Frame map_frame_at(const FrameMap &frames, double t) {
+  auto const u = frames.upper_bound(t);
+  auto const l = std::prev(u);
+  if (l->first == t || u == std::end(frames)) {
+    return l->second;
+  }
+  return flom::interpolate((t - l->first) / (u->first - l->first), l->second,
+                           u->second);
+}
+
+// Reuses the storage of out when copying a keyframe
+void map_frame_at_into(const FrameMap &frames, double t, flom::Frame &out) {
+  auto const u = frames.upper_bound(t);
+  auto const l = std::prev(u);
+  if (l->first == t || u == std::end(frames)) {
+    out = l->second;
+  } else {
+    out = flom::interpolate((t - l->first) / (u->first - l->first),
+                            l->second, u->second);
+  }
+}
+
+// Compares ways to evaluate frames at times, in ns per time.
+// frame_at returns a new frame, which allocates in both,
+// while frame_at_into and sample write into storage allocated before.
+void lookup(const flom::Motion &motion, const FrameMap &frames,
+            const std::vector<double> &times, const std::string &suffix) {
+  namespace bench = flom::bench;
+  auto const n = times.size();
+
+  bench::print_result("motion: frame_at" + suffix,
+                      bench::ns_per_op(n,
+                                       [&](auto i) {
+                                         bench::do_not_optimize(
+                                             motion.frame_at(times[i]));
+                                       }),
+                      "ns/op");
+  bench::print_result("map: frame_at" + suffix,
+                      bench::ns_per_op(n,
+                                       [&](auto i) {
+                                         bench::do_not_optimize(
+                                             map_frame_at(frames, times[i]));
+                                       }),
+                      "ns/op");
+
+  auto frame = motion.new_keyframe();
+  bench::reset_allocation_stats();
+  auto const into_ns = bench::ns_per_op(n, [&](auto i) {
+    motion.frame_at_into(times[i], frame);
+    bench::do_not_optimize(frame);
+  });
+  auto const into_allocations = bench::allocation_stats().count;
+  bench::print_result("motion: frame_at_into" + suffix, into_ns, "ns/op");
+  bench::print_result("motion: frame_at_into allocations" + suffix,
+                      static_cast<double>(into_allocations), "");
+  bench::print_result("map: frame_at_into" + suffix,
+                      bench::ns_per_op(n,
+                                       [&](auto i) {
+                                         map_frame_at_into(frames, times[i],
+                                                           frame);
+                                         bench::do_not_optimize(frame);
+                                       }),
+                      "ns/op");
+
+  // In batches, as a player evaluating ahead would
+  auto const batch = std::min(n, sample_batch);
+  flom::SampleBuffer buffer;
+  motion.sample({times.data(), batch}, buffer);
+  std::vector<flom::Frame> out(batch, motion.new_keyframe());
+  auto const batches = n / batch;
+  bench::print_result("motion: sample" + suffix,
+                      bench::ns_per_op(batches,
+                                       [&](auto b) {
+                                         motion.sample(
+                                             {times.data() + b * batch, batch},
+                                             buffer);
+                                         bench::do_not_optimize(buffer);
+                                       }) /
+                          static_cast<double>(batch),
+                      "ns/op");
+  bench::print_result("map: sample" + suffix,
+                      bench::ns_per_op(batches,
+                                       [&](auto b) {
+                                         for (std::size_t i = 0; i < batch;
+                                              i++) {
+                                           map_frame_at_into(
+                                               frames, times[b * batch + i],
+                                               out[i]);
+                                         }
+                                         bench::do_not_optimize(out);
+                                       }) /
+                          static_cast<double>(batch),
+                      "ns/op");
+}
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 10000);
+  auto const joints = arg_or(argc, argv, 2, 30);
+  auto const effectors = arg_or(argc, argv, 3, 4);
+  auto const lookups = std::size_t{100000};
+
+  std::cout << keyframes << " keyframes, " << joints << " joints, "
+            << effectors << " effectors" << std::endl;
+
+  auto const source = bench::synthesize_motion(joints, effectors, keyframes);
+
+  // Memory footprint of keyframes
+  auto const kib = [](std::size_t after, std::size_t before) {
+    return (static_cast<double>(after) - static_cast<double>(before)) / 1024;
+  };
+
+  // Copies share keyframes until modified, so a keyframe is rewritten
+  // with its own value to measure a copy of the whole store
+  auto const first_keyframe = source.frame_at(0);
+  auto const live_before_motion = bench::allocation_stats().live_bytes;
+  auto const rss_before_motion = bench::resident_set_size();
+  bench::reset_allocation_stats();
+  auto motion = source;
+  motion.insert_keyframe(0, first_keyframe);
+  auto const motion_stats = bench::allocation_stats();
+  auto const rss_after_motion = bench::resident_set_size();
+
+  auto const live_before_map = motion_stats.live_bytes;
+  bench::reset_allocation_stats();
+  FrameMap frames;
+  for (auto const &[t, f] : source.const_keyframes()) {
+    frames.emplace_hint(std::end(frames), t, f);
+  }
+  auto const map_stats = bench::allocation_stats();
+  auto const rss_after_map = bench::resident_set_size();
+
+  bench::print_result("motion: heap",
+                      kib(motion_stats.live_bytes, live_before_motion), "KiB");
+  bench::print_result("motion: allocations",
+                      static_cast<double>(motion_stats.count), "");
+  bench::print_result("motion: rss", kib(rss_after_motion, rss_before_motion),
+                      "KiB");
+  bench::print_result("map: heap", kib(map_stats.live_bytes, live_before_map),
+                      "KiB");
+  bench::print_result("map: allocations", static_cast<double>(map_stats.count),
+                      "");
+  bench::print_result("map: rss", kib(rss_after_map, rss_after_motion), "KiB");
+
+  // Lookup at random times, mostly between keyframes
+  std::mt19937 engine{0};
+  std::uniform_real_distribution<double> dist{0, motion.length()};
+  std::vector<double> times(lookups);
+  for (auto &t : times) {
+    t = dist(engine);
+  }
+  lookup(motion, frames, times, "");
+
+  // Lookup exactly at keyframes
+  auto const range = source.const_keyframes();
+  std::vector<double> exact_times;
+  for (auto it = std::cbegin(range); it != std::cend(range); ++it) {
+    exact_times.push_back(it.time());
+  }
+  std::vector<double> keyframe_times(lookups);
+  for (std::size_t i = 0; i < lookups; i++) {
+    keyframe_times[i] = exact_times[i % exact_times.size()];
+  }
+  lookup(motion, frames, keyframe_times, " (keyframe)");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares lerp_n with per-element interpolation of joint positions.
+//
+// usage: bench_lerp [iterations]
+
+#include <flom/interpolation.hpp>
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const iterations = arg_or(argc, argv, 1, 1000000);
+
+  for (auto const n :
+       {std::size_t{30}, std::size_t{100}, std::size_t{200}}) {
+    std::vector<double> a(n), b(n), out(n);
+    std::unordered_map<std::string, double> ma, mb, mout;
+    for (std::size_t i = 0; i < n; i++) {
+      a[i] = static_cast<double>(i);
+      b[i] = static_cast<double>(n - i);
+      auto const name = "joint" + std::to_string(i);
+      ma[name] = a[i];
+      mb[name] = b[i];
+      mout[name] = 0;
+    }
+
+    auto const ratio = [iterations](std::size_t i) {
+      return static_cast<double>(i) / static_cast<double>(iterations);
+    };
+
+    auto const prefix = std::to_string(n) + " joints: ";
+    bench::print_result(prefix + "unordered_map",
+                        bench::ns_per_op(iterations,
+                                         [&](auto i) {
+                                           auto const t = ratio(i);
+                                           for (auto const &[name, v] : ma) {
+                                             mout[name] =
+                                                 flom::lerp(t, v, mb.at(name));
+                                           }
+                                           bench::do_not_optimize(mout);
+                                         }),
+                        "ns/op");
+    bench::print_result(prefix + "element-wise",
+                        bench::ns_per_op(iterations,
+                                         [&](auto i) {
+                                           auto const t = ratio(i);
+                                           for (std::size_t j = 0; j < n; j++) {
+                                             out[j] = flom::lerp(t, a[j], b[j]);
+                                           }
+                                           bench::do_not_optimize(out);
+                                         }),
+                        "ns/op");
+    bench::print_result(prefix + "lerp_n",
+                        bench::ns_per_op(iterations,
+                                         [&](auto i) {
+                                           flom::lerp_n(ratio(i), a.data(),
+                                                        b.data(), out.data(),
+                                                        n);
+                                           bench::do_not_optimize(out);
+                                         }),
+                        "ns/op");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Measures loading a large motion repeatedly, as a server loading
+// a library of motions would.
+//
+// usage: bench_load [keyframes] [loads] [joints] [effectors] [threads]
+
+#include <flom/lazy_motion.hpp>
+#include <flom/motion.hpp>
+#include <flom/motion_loader.hpp>
+#include <flom/thread_pool.hpp>
+
+#include "bench.hpp"
+#include "memory.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+// Calls load() for each load and prints time and allocations per load
+template <typename F>
+void measure(const std::string &name, std::size_t bytes, std::size_t loads,
+             F &&load) {
+  namespace bench = flom::bench;
+
+  bench::reset_allocation_stats();
+  auto const live = bench::allocation_stats().live_bytes;
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < loads; i++) {
+    bench::do_not_optimize(load());
+  }
+  auto const end = std::chrono::steady_clock::now();
+  auto const stats = bench::allocation_stats();
+
+  std::chrono::duration<double, std::nano> const elapsed = end - start;
+  auto const n = static_cast<double>(loads);
+  auto const mb = static_cast<double>(bytes) / 1e6;
+  bench::print_result(name, elapsed.count() / n / 1e6, "ms/load");
+  bench::print_result(name + ": throughput",
+                      mb * n / (elapsed.count() / 1e9), "MB/s");
+  bench::print_result(name + ": allocations",
+                      static_cast<double>(stats.count) / n, "/load");
+  bench::print_result(name + ": peak heap",
+                      static_cast<double>(stats.peak_bytes - live) / 1e6,
+                      "MB");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 20000);
+  auto const loads = arg_or(argc, argv, 2, 5);
+  auto const joints = arg_or(argc, argv, 3, 30);
+  auto const effectors = arg_or(argc, argv, 4, 4);
+  auto const pool_threads = arg_or(argc, argv, 5, 8);
+
+  auto const source = bench::synthesize_motion(joints, effectors, keyframes);
+  std::ostringstream os;
+  source.dump(os);
+  auto const data = os.str();
+
+  std::cout << keyframes << " keyframes, " << joints << " joints, "
+            << effectors << " effectors ("
+            << static_cast<double>(data.size()) / 1e6 << " MB)" << std::endl;
+
+  auto const path = "bench_load.fom";
+  std::ofstream{path, std::ios::binary} << data;
+
+  // The file is in the page cache after the first load
+  measure("Motion::load (ifstream)", data.size(), loads, [&] {
+    std::ifstream f{path, std::ios::binary};
+    return flom::Motion::load(f);
+  });
+  measure("Motion::load_streaming", data.size(), loads, [&] {
+    std::ifstream f{path, std::ios::binary};
+    return flom::Motion::load_streaming(f);
+  });
+  measure("Motion::load_file", data.size(), loads,
+          [&] { return flom::Motion::load_file(path); });
+  measure("Motion::load_file (populate)", data.size(), loads,
+          [&] { return flom::Motion::load_file(path, true); });
+  measure("LazyMotion: open", data.size(), loads,
+          [&] { return flom::LazyMotion{path}; });
+  // A preview reads a few frames of a motion
+  measure("LazyMotion: open + 10 frames", data.size(), loads, [&] {
+    flom::LazyMotion lazy{path};
+    for (int i = 0; i < 10; i++) {
+      bench::do_not_optimize(lazy.frame_at(lazy.length() * i / 10));
+    }
+    return lazy.length();
+  });
+
+  std::ostringstream columnar_os;
+  source.dump_columnar(columnar_os);
+  auto const columnar = columnar_os.str();
+  auto const columnar_path = "bench_load.fomc";
+  std::ofstream{columnar_path, std::ios::binary} << columnar;
+  std::cout << "columnar: " << static_cast<double>(columnar.size()) / 1e6
+            << " MB" << std::endl;
+  measure("Motion::load_file (columnar)", columnar.size(), loads,
+          [&] { return flom::Motion::load_file(columnar_path); });
+
+  std::ostringstream quantized_os;
+  source.dump_columnar(quantized_os, flom::Quantization{});
+  auto const quantized = quantized_os.str();
+  std::ofstream{columnar_path, std::ios::binary} << quantized;
+  std::cout << "quantized: " << static_cast<double>(quantized.size()) / 1e6
+            << " MB" << std::endl;
+  measure("Motion::load_file (quantized)", quantized.size(), loads,
+          [&] { return flom::Motion::load_file(columnar_path); });
+  std::remove(columnar_path);
+
+  std::ostringstream json_os;
+  source.dump_json(json_os);
+  auto const json = json_os.str();
+  auto const json_path = "bench_load.json";
+  std::ofstream{json_path, std::ios::binary} << json;
+  std::cout << "json: " << static_cast<double>(json.size()) / 1e6 << " MB"
+            << std::endl;
+  measure("Motion::load_json", json.size(), loads, [&] {
+    std::ifstream f{json_path, std::ios::binary};
+    return flom::Motion::load_json(f);
+  });
+  std::remove(json_path);
+
+  flom::MotionLoader loader;
+  measure("MotionLoader: first", data.size(), 1,
+          [&] { return loader.load_file(path); });
+  measure("MotionLoader: reused", data.size(), loads,
+          [&] { return loader.load_file(path); });
+
+  // Frames are decoded in parallel from the wire format
+  for (std::size_t threads = 1; threads <= pool_threads; threads *= 2) {
+    flom::ThreadPool pool{threads};
+    flom::MotionLoader pooled{pool};
+    measure("MotionLoader: " + std::to_string(threads) + " threads",
+            data.size(), loads, [&] { return pooled.load_file(path); });
+  }
+
+  std::remove(path);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares sampling a looping motion in its first and later episodes.
+//
+// usage: bench_loop [iterations] [joints] [effectors]
+
+#include <flom/motion.hpp>
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const iterations = arg_or(argc, argv, 1, 100000);
+  auto const joints = arg_or(argc, argv, 2, 30);
+  auto const effectors = arg_or(argc, argv, 3, 4);
+
+  auto const motion =
+      bench::synthesize_motion(joints, effectors, 100, flom::LoopType::Wrap);
+  auto const length = motion.length();
+  auto frame = motion.new_keyframe();
+
+  for (double const episode : {0.0, 1e3, 1e6}) {
+    bench::print_result(
+        "episode " + std::to_string(static_cast<long>(episode)),
+        bench::ns_per_op(iterations,
+                         [&](auto i) {
+                           auto const t =
+                               length * (episode + 0.5 +
+                                         static_cast<double>(i % 100) / 1000);
+                           motion.frame_at_into(t, frame);
+                           bench::do_not_optimize(frame);
+                         }),
+        "ns/op");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares Motion::sample with sampling frame by frame.
+//
+// usage: bench_sample [keyframes] [samples] [joints] [effectors]
+
+#include <flom/motion.hpp>
+#include <flom/motion_cursor.hpp>
+#include <flom/range.hpp>
+#include <flom/sample_buffer.hpp>
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const keyframes = arg_or(argc, argv, 1, 10000);
+  auto const samples = arg_or(argc, argv, 2, 100000);
+  auto const joints = arg_or(argc, argv, 3, 30);
+  auto const effectors = arg_or(argc, argv, 4, 4);
+
+  std::cout << keyframes << " keyframes, " << samples << " samples, "
+            << joints << " joints, " << effectors << " effectors"
+            << std::endl;
+
+  auto const motion = bench::synthesize_motion(joints, effectors, keyframes);
+  auto const step = motion.length() / static_cast<double>(samples);
+
+  std::vector<double> sorted(samples);
+  for (std::size_t i = 0; i < samples; i++) {
+    sorted[i] = step * static_cast<double>(i);
+  }
+  auto shuffled = sorted;
+  std::shuffle(std::begin(shuffled), std::end(shuffled), std::mt19937{0});
+
+  bench::print_result("frame_at loop", bench::ns_per_op(1, [&](auto) {
+                        for (auto const t : sorted) {
+                          bench::do_not_optimize(motion.frame_at(t));
+                        }
+                      }) / static_cast<double>(samples),
+                      "ns/sample");
+
+  bench::print_result("MotionCursor", bench::ns_per_op(1, [&](auto) {
+                        flom::MotionCursor cursor{motion};
+                        flom::Frame f;
+                        for (auto const t : sorted) {
+                          cursor.frame_at_into(t, f);
+                          bench::do_not_optimize(f);
+                        }
+                      }) / static_cast<double>(samples),
+                      "ns/sample");
+
+  bench::print_result("frames(step)", bench::ns_per_op(1, [&](auto) {
+                        for (auto const &[t, f] : motion.frames(step)) {
+                          bench::do_not_optimize(f);
+                        }
+                      }) / static_cast<double>(samples),
+                      "ns/sample");
+
+  flom::SampleBuffer buffer;
+  motion.sample(sorted, buffer);
+  bench::print_result("sample (sorted)", bench::ns_per_op(1, [&](auto) {
+                        motion.sample(sorted, buffer);
+                        bench::do_not_optimize(buffer);
+                      }) / static_cast<double>(samples),
+                      "ns/sample");
+  bench::print_result("sample (shuffled)", bench::ns_per_op(1, [&](auto) {
+                        motion.sample(shuffled, buffer);
+                        bench::do_not_optimize(buffer);
+                      }) / static_cast<double>(samples),
+                      "ns/sample");
+
+  return EXIT_SUCCESS;
+}
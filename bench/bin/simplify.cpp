@@ -0,0 +1,149 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Measures Motion::simplify on a smooth motion sampled at 120 fps,
+// and sampling and file size before and after it.
+//
+// usage: bench_simplify [seconds] [joints] [effectors] [error]
+
+#include <flom/motion.hpp>
+#include <flom/range.hpp>
+#include <flom/sample_buffer.hpp>
+
+#include "bench.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+// Joints move as sine waves of various frequencies, half of them holding
+// still or moving at a constant speed for a while, as captured motions do.
+flom::Motion smooth_motion(std::size_t seconds, std::size_t joints,
+                           std::size_t effectors) {
+  std::unordered_set<std::string> joint_names;
+  for (std::size_t i = 0; i < joints; i++) {
+    joint_names.insert("joint" + std::to_string(i));
+  }
+  std::unordered_map<std::string, flom::EffectorType> effector_types;
+  auto const world = flom::CoordinateSystem::World;
+  for (std::size_t i = 0; i < effectors; i++) {
+    effector_types.emplace("effector" + std::to_string(i),
+                           flom::EffectorType{world, world});
+  }
+  flom::Motion motion{joint_names, effector_types};
+
+  std::vector<std::pair<double, flom::Frame>> frames;
+  for (std::size_t k = 1; k <= seconds * 120; k++) {
+    auto const t = static_cast<double>(k) / 120;
+    auto frame = motion.new_keyframe();
+    for (std::size_t i = 0; i < joints; i++) {
+      auto const phase = static_cast<double>(i);
+      auto const frequency = 0.2 + 0.1 * static_cast<double>(i % 7);
+      auto const wave = std::sin(frequency * t + phase);
+      auto const linear = (i % 2 == 0) && std::fmod(t + phase, 4) < 2;
+      frame.set_position("joint" + std::to_string(i),
+                         linear ? 0.5 * std::fmod(t + phase, 4) : wave);
+    }
+    for (std::size_t i = 0; i < effectors; i++) {
+      auto const s = static_cast<double>(i);
+      auto const angle = 0.3 * std::sin(0.5 * t + s);
+      frame.set_effector(
+          "effector" + std::to_string(i),
+          flom::Effector{
+              flom::Location{std::sin(t + s), std::cos(0.7 * t), 0.1 * t},
+              flom::Rotation{std::cos(angle), 0, std::sin(angle), 0}});
+    }
+    frames.emplace_back(t, std::move(frame));
+  }
+  motion.insert_keyframes(std::move(frames));
+  return motion;
+}
+
+std::size_t dump_size(const flom::Motion &motion) {
+  std::ostringstream s;
+  motion.dump(s);
+  return s.str().size();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const seconds = arg_or(argc, argv, 1, 600);
+  auto const joints = arg_or(argc, argv, 2, 30);
+  auto const effectors = arg_or(argc, argv, 3, 4);
+  auto const error = argc > 4 ? std::stod(argv[4]) : 1e-3;
+
+  std::cout << seconds << " seconds at 120 fps, " << joints << " joints, "
+            << effectors << " effectors, error " << error << std::endl;
+
+  auto const motion = smooth_motion(seconds, joints, effectors);
+  auto simplified = motion;
+  bench::print_result("simplify", bench::ns_per_op(1, [&](auto) {
+                        simplified = motion;
+                        simplified.simplify(error, error);
+                        bench::do_not_optimize(simplified);
+                      }) / 1e6,
+                      "ms");
+
+  bench::print_result(
+      "keyframes before", static_cast<double>(motion.const_keyframes().size()),
+      "");
+  bench::print_result(
+      "keyframes after",
+      static_cast<double>(simplified.const_keyframes().size()), "");
+  bench::print_result("size before",
+                      static_cast<double>(dump_size(motion)) / 1e6, "MB");
+  bench::print_result("size after",
+                      static_cast<double>(dump_size(simplified)) / 1e6, "MB");
+
+  // Sampling at 60 fps, between the original keyframes
+  std::vector<double> times(seconds * 60);
+  for (std::size_t i = 0; i < times.size(); i++) {
+    times[i] = (static_cast<double>(i) + 0.25) / 60;
+  }
+  flom::SampleBuffer buffer;
+  const flom::Motion &after = simplified;
+  for (auto const *m : {&motion, &after}) {
+    bench::print_result(m == &motion ? "sample before" : "sample after",
+                        bench::ns_per_op(1, [&](auto) {
+                          m->sample(times, buffer);
+                          bench::do_not_optimize(buffer);
+                        }) / static_cast<double>(times.size()),
+                        "ns/sample");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares slerp_n with per-effector interpolation of rotations.
+//
+// usage: bench_slerp [iterations]
+
+#include <flom/effector.hpp>
+#include <flom/interpolation.hpp>
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+std::size_t arg_or(int argc, char *argv[], int i, std::size_t value) {
+  if (argc > i) {
+    return std::stoul(argv[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  namespace bench = flom::bench;
+
+  auto const iterations = arg_or(argc, argv, 1, 100000);
+
+  for (auto const n :
+       {std::size_t{4}, std::size_t{16}, std::size_t{64}}) {
+    std::vector<flom::Rotation> a, b, out(n);
+    std::vector<double> pa(n * 4), pb(n * 4), pout(n * 4);
+    auto const qa = flom::planar_quaternions(pa.data(), n);
+    auto const qb = flom::planar_quaternions(pb.data(), n);
+    for (std::size_t i = 0; i < n; i++) {
+      a.emplace_back(flom::Rotation::value_type::UnitRandom());
+      b.emplace_back(flom::Rotation::value_type::UnitRandom());
+      std::tie(qa.w[i], qa.x[i], qa.y[i], qa.z[i]) = a[i].wxyz();
+      std::tie(qb.w[i], qb.x[i], qb.y[i], qb.z[i]) = b[i].wxyz();
+    }
+
+    auto const ratio = [iterations](std::size_t i) {
+      return static_cast<double>(i) / static_cast<double>(iterations);
+    };
+
+    auto const prefix = std::to_string(n) + " effectors: ";
+    bench::print_result(prefix + "per-effector",
+                        bench::ns_per_op(iterations,
+                                         [&](auto i) {
+                                           auto const t = ratio(i);
+                                           for (std::size_t j = 0; j < n; j++) {
+                                             out[j] = flom::interpolate(
+                                                 t, a[j], b[j]);
+                                           }
+                                           bench::do_not_optimize(out);
+                                         }),
+                        "ns/op");
+    bench::print_result(
+        prefix + "slerp_n",
+        bench::ns_per_op(iterations,
+                         [&](auto i) {
+                           flom::slerp_n(ratio(i),
+                                         flom::planar_quaternions<const double>(
+                                             pa.data(), n),
+                                         flom::planar_quaternions<const double>(
+                                             pb.data(), n),
+                                         flom::planar_quaternions(pout.data(), n),
+                                         n);
+                           bench::do_not_optimize(pout);
+                         }),
+        "ns/op");
+  }
+
+  return EXIT_SUCCESS;
+}
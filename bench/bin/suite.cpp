@@ -0,0 +1,364 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Runs the benchmarks of the hot paths over combinations of motion shapes,
+// writing results in a machine-readable format to track regressions.
+//
+// usage: flom_bench [--format text|csv|json] [--joints N,...]
+//                   [--effectors N,...] [--keyframes N,...]
+//                   [--loop none,wrap] [--filter NAME] [--min-time SECONDS]
+//
+// Benchmarks run for every combination of the lists. With --filter, only
+// the ones whose names contain NAME run. Times are in nanoseconds.
+
+#include <flom/frame.hpp>
+#include <flom/interpolation.hpp>
+#include <flom/motion.hpp>
+#include <flom/range.hpp>
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef FLOM_VERSION
+#define FLOM_VERSION "unknown"
+#endif
+
+namespace {
+
+namespace bench = flom::bench;
+
+struct Options {
+  std::string format = "text";
+  std::vector<std::size_t> joints = {10, 50};
+  std::vector<std::size_t> effectors = {2, 8};
+  std::vector<std::size_t> keyframes = {100, 10000};
+  std::vector<flom::LoopType> loops = {flom::LoopType::None,
+                                       flom::LoopType::Wrap};
+  std::string filter;
+  double min_time = 0.1;
+};
+
+struct Result {
+  std::string name;
+  std::size_t joints;
+  std::size_t effectors;
+  std::size_t keyframes;
+  flom::LoopType loop;
+  double value;
+  std::string unit;
+};
+
+const char *loop_name(flom::LoopType loop) {
+  return loop == flom::LoopType::Wrap ? "wrap" : "none";
+}
+
+template <typename F>
+std::vector<typename std::invoke_result_t<F, const std::string &>>
+split(const std::string &list, F &&parse) {
+  std::vector<typename std::invoke_result_t<F, const std::string &>> values;
+  std::istringstream is{list};
+  for (std::string item; std::getline(is, item, ',');) {
+    values.push_back(parse(item));
+  }
+  return values;
+}
+
+std::vector<std::size_t> sizes(const std::string &list) {
+  return split(list, [](const std::string &s) { return std::stoul(s); });
+}
+
+std::vector<flom::LoopType> loops(const std::string &list) {
+  return split(list, [](const std::string &s) {
+    if (s == "wrap") {
+      return flom::LoopType::Wrap;
+    }
+    if (s != "none") {
+      throw std::invalid_argument{"unknown loop type: " + s};
+    }
+    return flom::LoopType::None;
+  });
+}
+
+// Calls f(i) in growing batches until it takes min_time seconds,
+// and returns nanoseconds per call
+template <typename F> double adaptive_ns_per_op(double min_time, F &&f) {
+  std::size_t iterations = 1;
+  for (;;) {
+    auto const ns = bench::ns_per_op(iterations, f);
+    if (ns * static_cast<double>(iterations) >= min_time * 1e9 ||
+        iterations >= (std::size_t{1} << 30)) {
+      return ns;
+    }
+    iterations *= 2;
+  }
+}
+
+class Suite {
+private:
+  const Options &options;
+  std::vector<Result> results;
+
+  std::size_t joints = 0;
+  std::size_t effectors = 0;
+  std::size_t keyframes = 0;
+  flom::LoopType loop = flom::LoopType::None;
+
+  bool enabled(const std::string &name) const {
+    return name.find(this->options.filter) != std::string::npos;
+  }
+
+  void add(const std::string &name, double value, const std::string &unit) {
+    this->results.push_back({name, this->joints, this->effectors,
+                             this->keyframes, this->loop, value, unit});
+    if (this->options.format == "text") {
+      bench::print_result(name, value, unit);
+    }
+  }
+
+  template <typename F> void time(const std::string &name, F &&f) {
+    if (this->enabled(name)) {
+      this->add(name, adaptive_ns_per_op(this->options.min_time, f), "ns/op");
+    }
+  }
+
+public:
+  explicit Suite(const Options &options_) : options(options_) {}
+
+  void run(std::size_t joints_, std::size_t effectors_,
+           std::size_t keyframes_, flom::LoopType loop_) {
+    this->joints = joints_;
+    this->effectors = effectors_;
+    this->keyframes = keyframes_;
+    this->loop = loop_;
+    if (this->options.format == "text") {
+      std::cout << "# " << joints_ << " joints, " << effectors_
+                << " effectors, " << keyframes_ << " keyframes, loop "
+                << loop_name(loop_) << std::endl;
+    }
+
+    auto const motion =
+        bench::synthesize_motion(joints_, effectors_, keyframes_, loop_);
+    auto const length = motion.length();
+
+    // With Wrap, times run over the length to sample across loops
+    constexpr std::size_t samples = 1024;
+    std::vector<double> times(samples);
+    std::mt19937 engine{0};
+    std::uniform_real_distribution<double> dist{
+        0, loop_ == flom::LoopType::Wrap ? length * 3 : length};
+    for (auto &t : times) {
+      t = dist(engine);
+    }
+
+    this->time("frame_at", [&](std::size_t i) {
+      bench::do_not_optimize(motion.frame_at(times[i % samples]));
+    });
+
+    auto frame = motion.new_keyframe();
+    this->time("frame_at_into", [&](std::size_t i) {
+      motion.frame_at_into(times[i % samples], frame);
+      bench::do_not_optimize(frame);
+    });
+
+    if (this->enabled("frames")) {
+      std::size_t count = 0;
+      auto const ns = adaptive_ns_per_op(this->options.min_time, [&](auto) {
+        count = 0;
+        for (auto const &[t, f] : motion.frames(60)) {
+          bench::do_not_optimize(f);
+          count++;
+          if (count == 1000) {
+            // Looping motions have infinite ranges
+            break;
+          }
+        }
+      });
+      this->add("frames", ns / static_cast<double>(count), "ns/frame");
+    }
+
+    auto const a = motion.frame_at(0);
+    auto const b = motion.frame_at(length / 2);
+    this->time("interpolate", [&](std::size_t i) {
+      bench::do_not_optimize(flom::interpolate(
+          static_cast<double>(i % 100) / 100, a, b));
+    });
+
+    if (this->enabled("insert_keyframe")) {
+      // Inserting between keyframes, into a copy of the motion,
+      // at distinct times spread over the motion in random order
+      auto const inserts = std::min<std::size_t>(keyframes_, 1000);
+      std::vector<double> insert_times(inserts);
+      for (std::size_t k = 0; k < inserts; k++) {
+        auto const slot = k * keyframes_ / inserts;
+        insert_times[k] = (static_cast<double>(slot) + 0.5) * 0.1;
+      }
+      std::shuffle(std::begin(insert_times), std::end(insert_times),
+                   std::mt19937{0});
+      double total = 0;
+      std::size_t count = 0;
+      while (total < this->options.min_time * 1e9) {
+        auto copy = motion;
+        // Copies share keyframes until modified; detached here by
+        // rewriting the first keyframe, not to time the copy
+        copy.insert_keyframe(0, a);
+        auto const start = std::chrono::steady_clock::now();
+        for (auto const t : insert_times) {
+          copy.insert_keyframe(t, a);
+        }
+        std::chrono::duration<double, std::nano> const elapsed =
+            std::chrono::steady_clock::now() - start;
+        total += elapsed.count();
+        count += inserts;
+      }
+      this->add("insert_keyframe", total / static_cast<double>(count),
+                "ns/op");
+    }
+
+    std::ostringstream binary_os;
+    motion.dump(binary_os);
+    auto const binary = binary_os.str();
+    std::ostringstream json_os;
+    motion.dump_json(json_os);
+    auto const json = json_os.str();
+
+    this->time("dump", [&](auto) {
+      std::ostringstream os;
+      motion.dump(os);
+      bench::do_not_optimize(os);
+    });
+    this->time("load", [&](auto) {
+      std::istringstream is{binary};
+      bench::do_not_optimize(flom::Motion::load(is));
+    });
+    this->time("dump_json", [&](auto) {
+      std::ostringstream os;
+      motion.dump_json(os);
+      bench::do_not_optimize(os);
+    });
+    this->time("load_json", [&](auto) {
+      std::istringstream is{json};
+      bench::do_not_optimize(flom::Motion::load_json(is));
+    });
+    this->time("json_round_trip", [&](auto) {
+      auto const s = motion.dump_json_string();
+      bench::do_not_optimize(flom::Motion::load_json_string(s));
+    });
+  }
+
+  void write_csv(std::ostream &os) const {
+    os << "benchmark,joints,effectors,keyframes,loop,value,unit\n";
+    for (auto const &r : this->results) {
+      os << r.name << ',' << r.joints << ',' << r.effectors << ','
+         << r.keyframes << ',' << loop_name(r.loop) << ',' << r.value << ','
+         << r.unit << '\n';
+    }
+  }
+
+  void write_json(std::ostream &os) const {
+    os << "{\"version\":\"" << FLOM_VERSION << "\",\"results\":[";
+    for (std::size_t i = 0; i < this->results.size(); i++) {
+      auto const &r = this->results[i];
+      os << (i == 0 ? "" : ",") << "\n  {\"benchmark\":\"" << r.name
+         << "\",\"joints\":" << r.joints << ",\"effectors\":" << r.effectors
+         << ",\"keyframes\":" << r.keyframes << ",\"loop\":\""
+         << loop_name(r.loop) << "\",\"value\":" << r.value
+         << ",\"unit\":\"" << r.unit << "\"}";
+    }
+    os << "\n]}\n";
+  }
+};
+
+Options parse_options(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    auto const has_value = i + 1 < argc;
+    std::string const arg = argv[i];
+    if (arg == "--format" && has_value) {
+      options.format = argv[++i];
+    } else if (arg == "--joints" && has_value) {
+      options.joints = sizes(argv[++i]);
+    } else if (arg == "--effectors" && has_value) {
+      options.effectors = sizes(argv[++i]);
+    } else if (arg == "--keyframes" && has_value) {
+      options.keyframes = sizes(argv[++i]);
+    } else if (arg == "--loop" && has_value) {
+      options.loops = loops(argv[++i]);
+    } else if (arg == "--filter" && has_value) {
+      options.filter = argv[++i];
+    } else if (arg == "--min-time" && has_value) {
+      options.min_time = std::stod(argv[++i]);
+    } else {
+      throw std::invalid_argument{"unknown option: " + arg};
+    }
+  }
+  if (std::find(std::cbegin(options.keyframes), std::cend(options.keyframes),
+                0) != std::cend(options.keyframes)) {
+    throw std::invalid_argument{"keyframes must be positive"};
+  }
+  if (options.format != "text" && options.format != "csv" &&
+      options.format != "json") {
+    throw std::invalid_argument{"unknown format: " + options.format};
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "Usage: " << argv[0]
+              << " [--format text|csv|json] [--joints N,...]"
+                 " [--effectors N,...] [--keyframes N,...]"
+                 " [--loop none,wrap] [--filter NAME] [--min-time SECONDS]"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Suite suite{options};
+  for (auto const joints : options.joints) {
+    for (auto const effectors : options.effectors) {
+      for (auto const keyframes : options.keyframes) {
+        for (auto const loop : options.loops) {
+          suite.run(joints, effectors, keyframes, loop);
+        }
+      }
+    }
+  }
+
+  if (options.format == "csv") {
+    suite.write_csv(std::cout);
+  } else if (options.format == "json") {
+    suite.write_json(std::cout);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_BENCH_BENCH_HPP
+#define FLOM_BENCH_BENCH_HPP
+
+#include <flom/motion.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace flom::bench {
+
+// Prevents the compiler from optimizing away the computation of value
+template <typename T> void do_not_optimize(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Calls f(i) for i in [0, iterations) and returns nanoseconds per call
+template <typename F> double ns_per_op(std::size_t iterations, F &&f) {
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    f(i);
+  }
+  auto const end = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::nano> const elapsed = end - start;
+  return elapsed.count() / static_cast<double>(iterations);
+}
+
+// Deterministic motion with keyframes at t = 0, 0.1, 0.2, ...
+// Every effector has both location and rotation.
+Motion synthesize_motion(std::size_t joints, std::size_t effectors,
+                         std::size_t keyframes,
+                         LoopType loop = LoopType::None,
+                         std::uint_fast32_t seed = 0);
+
+void print_result(const std::string &name, double value,
+                  const std::string &unit);
+
+} // namespace flom::bench
+
+#endif
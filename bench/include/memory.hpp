@@ -0,0 +1,45 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_BENCH_MEMORY_HPP
+#define FLOM_BENCH_MEMORY_HPP
+
+#include <cstddef>
+
+namespace flom::bench {
+
+// Counters of the replaced global operator new/delete
+struct AllocationStats {
+  std::size_t count;
+  std::size_t bytes;
+  std::size_t live_bytes;
+  std::size_t peak_bytes;
+};
+
+AllocationStats allocation_stats() noexcept;
+
+// Resets count, bytes and peak_bytes. live_bytes is kept.
+void reset_allocation_stats() noexcept;
+
+// Resident set size of this process in bytes, or 0 if unavailable
+std::size_t resident_set_size();
+
+} // namespace flom::bench
+
+#endif
@@ -0,0 +1,78 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "bench.hpp"
+
+#include <flom/effector.hpp>
+#include <flom/effector_type.hpp>
+#include <flom/frame.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace flom::bench {
+
+Motion synthesize_motion(std::size_t joints, std::size_t effectors,
+                         std::size_t keyframes, LoopType loop,
+                         std::uint_fast32_t seed) {
+  std::unordered_set<std::string> joint_names;
+  for (std::size_t i = 0; i < joints; i++) {
+    joint_names.insert("joint" + std::to_string(i));
+  }
+  std::unordered_map<std::string, EffectorType> effector_types;
+  for (std::size_t i = 0; i < effectors; i++) {
+    effector_types.emplace("effector" + std::to_string(i),
+                           EffectorType{CoordinateSystem::World,
+                                        CoordinateSystem::Local});
+  }
+
+  Motion m{joint_names, effector_types, "synthesized"};
+  m.set_loop(loop);
+
+  std::mt19937 engine{seed};
+  std::uniform_real_distribution<double> dist{-1, 1};
+  auto frame = m.new_keyframe();
+  for (std::size_t k = 0; k < keyframes; k++) {
+    for (auto const &name : joint_names) {
+      frame.set_position(name, dist(engine));
+    }
+    for (auto const &[name, type] : effector_types) {
+      Rotation::value_type q{dist(engine), dist(engine), dist(engine),
+                             dist(engine)};
+      q.normalize();
+      frame.set_effector(
+          name, Effector{Location{dist(engine), dist(engine), dist(engine)},
+                         Rotation{q}});
+    }
+    m.insert_keyframe(static_cast<double>(k) * 0.1, frame);
+  }
+  return m;
+}
+
+void print_result(const std::string &name, double value,
+                  const std::string &unit) {
+  std::cout << std::left << std::setw(40) << name << std::right
+            << std::setw(16) << std::fixed << std::setprecision(2) << value
+            << " " << unit << std::endl;
+}
+
+} // namespace flom::bench
@@ -0,0 +1,100 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "memory.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#include <unistd.h>
+
+namespace {
+
+std::atomic<std::size_t> allocation_count{0};
+std::atomic<std::size_t> allocated_bytes{0};
+std::atomic<std::size_t> live_bytes{0};
+std::atomic<std::size_t> peak_bytes{0};
+
+// Allocated size is stored in front of the returned block,
+// keeping the default alignment of operator new
+constexpr std::size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void *allocate(std::size_t size) {
+  auto *const p = static_cast<char *>(std::malloc(size + header_size));
+  if (!p) {
+    throw std::bad_alloc{};
+  }
+  *reinterpret_cast<std::size_t *>(p) = size;
+
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  auto const live =
+      live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  auto peak = peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak &&
+         !peak_bytes.compare_exchange_weak(peak, live,
+                                           std::memory_order_relaxed)) {
+  }
+  return p + header_size;
+}
+
+void deallocate(void *ptr) noexcept {
+  if (!ptr) {
+    return;
+  }
+  auto *const p = static_cast<char *>(ptr) - header_size;
+  live_bytes.fetch_sub(*reinterpret_cast<std::size_t *>(p),
+                       std::memory_order_relaxed);
+  std::free(p);
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void *p) noexcept { deallocate(p); }
+void operator delete[](void *p) noexcept { deallocate(p); }
+void operator delete(void *p, std::size_t) noexcept { deallocate(p); }
+void operator delete[](void *p, std::size_t) noexcept { deallocate(p); }
+
+namespace flom::bench {
+
+AllocationStats allocation_stats() noexcept {
+  return {allocation_count.load(), allocated_bytes.load(), live_bytes.load(),
+          peak_bytes.load()};
+}
+
+void reset_allocation_stats() noexcept {
+  allocation_count = 0;
+  allocated_bytes = 0;
+  peak_bytes = live_bytes.load();
+}
+
+std::size_t resident_set_size() {
+  std::ifstream statm{"/proc/self/statm"};
+  std::size_t size = 0, resident = 0;
+  if (!(statm >> size >> resident)) {
+    return 0;
+  }
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+} // namespace flom::bench
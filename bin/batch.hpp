@@ -0,0 +1,230 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_BIN_BATCH_HPP
+#define FLOM_BIN_BATCH_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <glob.h>
+#include <sys/stat.h>
+
+#include "flom/errors.hpp"
+#include "flom/thread_pool.hpp"
+
+// Batch mode shared by the converters: many files are converted in one
+// process, on a pool of threads
+namespace flom::batch {
+
+inline bool is_directory(const std::string &path) {
+  struct stat st {};
+  return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+inline std::size_t file_size(const std::string &path) {
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(st.st_size);
+}
+
+inline std::vector<std::string> glob_paths(const std::string &pattern) {
+  glob_t g{};
+  std::vector<std::string> paths;
+  if (::glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+    paths.assign(g.gl_pathv, g.gl_pathv + g.gl_pathc);
+  }
+  ::globfree(&g);
+  return paths;
+}
+
+// Inputs given by SOURCE, which is one of
+//   DIR       files in the directory with the extension
+//   PATTERN   paths matching the glob pattern
+//   @FILE     manifest listing a path per line
+inline std::vector<std::string> expand_inputs(const std::string &source,
+                                              const std::string &extension) {
+  if (!source.empty() && source.front() == '@') {
+    std::ifstream f{source.substr(1)};
+    if (!f) {
+      throw errors::FileError{source.substr(1), errno};
+    }
+    std::vector<std::string> paths;
+    for (std::string line; std::getline(f, line);) {
+      if (!line.empty()) {
+        paths.push_back(line);
+      }
+    }
+    return paths;
+  }
+  if (is_directory(source)) {
+    return glob_paths(source + "/*" + extension);
+  }
+  return glob_paths(source);
+}
+
+inline std::ofstream open_output(const std::string &path) {
+  std::ofstream o{path, std::ios::trunc | std::ios::binary};
+  if (!o) {
+    throw std::system_error{errno, std::generic_category(), path};
+  }
+  return o;
+}
+
+// Parses the argument of --jobs, which must be a positive integer
+inline bool parse_jobs(const char *arg, std::size_t &jobs) {
+  std::size_t v = 0;
+  for (auto p = arg; *p != '\0'; p++) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    auto const digit = static_cast<std::size_t>(*p - '0');
+    if (v > (std::numeric_limits<std::size_t>::max() - digit) / 10) {
+      return false;
+    }
+    v = v * 10 + digit;
+  }
+  if (v == 0) {
+    return false;
+  }
+  jobs = v;
+  return true;
+}
+
+inline void print_usage(const char *program, const char *options) {
+  std::cerr << "       " << program << options
+            << " --batch [--jobs N] SOURCE OUTPUT_DIR" << std::endl;
+}
+
+inline void print_options() {
+  std::cerr << "  --batch       convert files of SOURCE into OUTPUT_DIR, where "
+               "SOURCE is"
+            << std::endl;
+  std::cerr << "                a directory, a glob pattern or @FILE listing "
+               "a path per line"
+            << std::endl;
+  std::cerr << "  --jobs N      threads converting files (default: all cores)"
+            << std::endl;
+}
+
+// Path in the directory, with the extension of the input replaced
+inline std::string output_path(const std::string &dir,
+                               const std::string &input,
+                               const std::string &extension) {
+  auto const slash = input.find_last_of('/');
+  auto name = slash == std::string::npos ? input : input.substr(slash + 1);
+  auto const dot = name.find_last_of('.');
+  if (dot != std::string::npos && dot != 0) {
+    name.erase(dot);
+  }
+  return dir + "/" + name + extension;
+}
+
+// Converts inputs into the directory with convert(input, output),
+// printing the time of each file and the throughput in the end.
+// Inputs mapped to the same output are not converted and count as failed.
+// Returns the number of failed files, or 1 if there are no inputs.
+template <typename F>
+std::size_t run(const std::vector<std::string> &inputs,
+                const std::string &dir, const std::string &extension,
+                std::size_t jobs, F &&convert) {
+  using clock = std::chrono::steady_clock;
+  using ms = std::chrono::duration<double, std::milli>;
+
+  if (inputs.empty()) {
+    std::cerr << "no input files" << std::endl;
+    return 1;
+  }
+
+  // Outputs are named after inputs only, and written concurrently
+  std::vector<std::string> outputs;
+  std::unordered_map<std::string, std::size_t> writers;
+  for (auto const &input : inputs) {
+    outputs.push_back(output_path(dir, input, extension));
+    writers[outputs.back()]++;
+  }
+  std::size_t failed = 0;
+  std::vector<std::size_t> pending;
+  for (std::size_t i = 0; i < inputs.size(); i++) {
+    if (writers[outputs[i]] > 1) {
+      failed++;
+      std::cerr << inputs[i] << ": " << outputs[i]
+                << " is also the output of another input" << std::endl;
+    } else {
+      pending.push_back(i);
+    }
+  }
+
+  std::mutex mutex;
+  std::size_t bytes = 0;
+  ThreadPool pool{jobs};
+  auto const start = clock::now();
+  pool.run(pending.size(), [&](std::size_t j) {
+    auto const i = pending[j];
+    auto const &input = inputs[i];
+    auto const file_start = clock::now();
+    std::string error;
+    try {
+      convert(input, outputs[i]);
+    } catch (const errors::FileError &e) {
+      error = e.path() + ": " + std::strerror(e.error_code());
+    } catch (const std::exception &e) {
+      error = input + ": " + e.what();
+    }
+    ms const elapsed = clock::now() - file_start;
+    auto const size = file_size(input);
+
+    std::lock_guard<std::mutex> lock{mutex};
+    if (!error.empty()) {
+      failed++;
+      std::cerr << error << std::endl;
+      return;
+    }
+    bytes += size;
+    std::cout << input << '\t' << size << " bytes\t" << elapsed.count()
+              << " ms" << std::endl;
+  });
+  std::chrono::duration<double> const elapsed = clock::now() - start;
+
+  // Throughput of converted files only
+  auto const seconds = elapsed.count();
+  auto const converted = inputs.size() - failed;
+  std::cout << converted << " files converted, " << failed << " failed in "
+            << seconds << " s (" << static_cast<double>(converted) / seconds
+            << " files/s, " << static_cast<double>(bytes) / 1e6 / seconds
+            << " MB/s, " << pool.size() << " threads)" << std::endl;
+  return failed;
+}
+
+} // namespace flom::batch
+
+#endif
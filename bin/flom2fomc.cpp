@@ -0,0 +1,59 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "flom/flom.hpp"
+
+int main(int argc, char *argv[]) {
+  flom::Quantization q;
+  bool quantize = false;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (std::strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      q.position = q.location = q.rotation = std::stod(argv[++i]);
+      quantize = true;
+    } else if (std::strcmp(argv[i], "--verify") == 0) {
+      q.verify = true;
+    } else {
+      break;
+    }
+  }
+  if (argc - i != 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " [-e MAX_ERROR [--verify]] INPUT OUTPUT" << std::endl;
+    std::cerr << "  -e MAX_ERROR  quantize values within the error"
+              << std::endl;
+    std::cerr << "  --verify      check the errors before writing"
+              << std::endl;
+    return -1;
+  }
+
+  auto const motion = flom::Motion::load_file(argv[i]);
+  std::ofstream o(argv[i + 1], std::ios::trunc | std::ios::binary);
+  if (quantize) {
+    motion.dump_columnar(o, q);
+  } else {
+    motion.dump_columnar(o);
+  }
+  return 0;
+}
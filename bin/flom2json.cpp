@@ -17,21 +17,60 @@
 // along with Flom.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <string>
 
 #include "flom/flom.hpp"
 
+#include "batch.hpp"
+
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " INPUT OUTPUT" << std::endl;
+  flom::JSONFormat format;
+  bool batch = false;
+  std::size_t jobs = 0;
+  bool valid = true;
+  int i = 1;
+  for (; i < argc; i++) {
+    if (std::strcmp(argv[i], "--name-table") == 0) {
+      format.name_table = true;
+    } else if (std::strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      if (!flom::batch::parse_jobs(argv[++i], jobs)) {
+        valid = false;
+        break;
+      }
+    } else {
+      break;
+    }
+  }
+  if (!valid || argc - i != 2) {
+    std::cerr << "Usage: " << argv[0] << " [--name-table] INPUT OUTPUT"
+              << std::endl;
+    flom::batch::print_usage(argv[0], " [--name-table]");
+    std::cerr << "  --name-table  write names once, and values in arrays"
+              << std::endl;
+    flom::batch::print_options();
     return -1;
   }
 
-  std::ifstream f(argv[1], std::ios::binary);
-  auto const motion = flom::Motion::load(f);
-  std::ofstream o(argv[2]);
-  motion.dump_json(o);
+  if (batch) {
+    auto const inputs = flom::batch::expand_inputs(argv[i], ".fom");
+    auto const failed = flom::batch::run(
+        inputs, argv[i + 1], ".json", jobs,
+        [&format](const std::string &input, const std::string &output) {
+          auto const motion = flom::Motion::load_file(input);
+          auto o = flom::batch::open_output(output);
+          motion.dump_json(o, format);
+        });
+    return failed == 0 ? 0 : 1;
+  }
+
+  auto const motion = flom::Motion::load_file(argv[i]);
+  std::ofstream o(argv[i + 1], std::ios::trunc | std::ios::binary);
+  motion.dump_json(o, format);
   return 0;
 }
@@ -0,0 +1,65 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "flom/flom.hpp"
+
+namespace {
+
+bool ends_with(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " INPUT OUTPUT [POSITION_ERROR [ROTATION_ERROR]]"
+              << std::endl;
+    std::cerr << "  POSITION_ERROR  max error of positions and locations "
+                 "(default: 1e-3)"
+              << std::endl;
+    std::cerr << "  ROTATION_ERROR  max error of rotations in radians "
+                 "(default: 1e-3)"
+              << std::endl;
+    return -1;
+  }
+  auto const position_error = argc > 3 ? std::stod(argv[3]) : 1e-3;
+  auto const rotation_error = argc > 4 ? std::stod(argv[4]) : 1e-3;
+
+  auto motion = flom::Motion::load_file(argv[1]);
+  auto const before = motion.const_keyframes().size();
+  motion.simplify(position_error, rotation_error);
+  auto const after = motion.const_keyframes().size();
+  std::cerr << "keyframes: " << before << " -> " << after << std::endl;
+
+  std::string const output = argv[2];
+  std::ofstream o(output, std::ios::trunc | std::ios::binary);
+  if (ends_with(output, ".fomc")) {
+    motion.dump_columnar(o);
+  } else {
+    motion.dump(o);
+  }
+  return 0;
+}
@@ -17,21 +17,60 @@
 // along with Flom.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <string>
 
 #include "flom/flom.hpp"
 
+#include "batch.hpp"
+
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
+  bool batch = false;
+  std::size_t jobs = 0;
+  bool valid = true;
+  int i = 1;
+  for (; i < argc; i++) {
+    if (std::strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      if (!flom::batch::parse_jobs(argv[++i], jobs)) {
+        valid = false;
+        break;
+      }
+    } else {
+      break;
+    }
+  }
+  if (!valid || argc - i != 2) {
     std::cerr << "Usage: " << argv[0] << " INPUT OUTPUT" << std::endl;
+    flom::batch::print_usage(argv[0], "");
+    flom::batch::print_options();
     return -1;
   }
 
-  std::ifstream f(argv[1]);
+  if (batch) {
+    auto const inputs = flom::batch::expand_inputs(argv[i], ".json");
+    auto const failed = flom::batch::run(
+        inputs, argv[i + 1], ".fom", jobs,
+        [](const std::string &input, const std::string &output) {
+          std::ifstream f(input, std::ios::binary);
+          if (!f) {
+            throw flom::errors::FileError{input, errno};
+          }
+          auto const motion = flom::Motion::load_json(f);
+          auto o = flom::batch::open_output(output);
+          motion.dump(o);
+        });
+    return failed == 0 ? 0 : 1;
+  }
+
+  std::ifstream f(argv[i]);
   auto const motion = flom::Motion::load_json(f);
-  std::ofstream o(argv[2], std::ios::trunc | std::ios::binary);
+  std::ofstream o(argv[i + 1], std::ios::trunc | std::ios::binary);
   motion.dump(o);
   return 0;
 }
@@ -21,5 +21,5 @@ function(flom_add_lib target name)
   flom_set_compile_options(${target})
   set_target_properties(${target} PROPERTIES OUTPUT_NAME "${name}")
   set_target_properties(${target} PROPERTIES POSITION_INDEPENDENT_CODE ${USE_PIC})
-  target_link_libraries(${target} PRIVATE flom_proto ${PROTOBUF_LIBRARIES})
+  target_link_libraries(${target} PRIVATE flom_proto ${PROTOBUF_LIBRARIES} ${CMAKE_THREAD_LIBS_INIT})
 endfunction()
@@ -0,0 +1,119 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_COMPAT_CHARCONV_HPP
+#define FLOM_COMPAT_CHARCONV_HPP
+
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+
+// Floating-point std::from_chars and std::to_chars are missing in libc++
+// and libstdc++ < 11
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define FLOM_COMPAT_FLOAT_CHARCONV 1
+#else
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#endif
+
+namespace flom::compat {
+
+#ifdef FLOM_COMPAT_FLOAT_CHARCONV
+
+using std::from_chars;
+using std::from_chars_result;
+using std::to_chars;
+using std::to_chars_result;
+
+#else
+
+struct from_chars_result {
+  const char *ptr;
+  std::errc ec;
+};
+
+// Substitute with strtod, which only accepts the whole of [first, last)
+// and reads '.' as the decimal point regardless of the current locale
+inline from_chars_result from_chars(const char *first, const char *last,
+                                    double &value) {
+  auto const point = *std::localeconv()->decimal_point;
+  std::string s;
+  s.reserve(static_cast<std::size_t>(last - first));
+  for (auto p = first; p != last; p++) {
+    auto const c = *p;
+    // Leading '+', spaces, hex, inf and nan are read by strtod only
+    if (!((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+          ((c == '-' || c == '+') && p != first) ||
+          (c == '-' && p == first))) {
+      return {first, std::errc::invalid_argument};
+    }
+    s.push_back(c == '.' ? point : c);
+  }
+
+  char *end;
+  errno = 0;
+  auto const v = std::strtod(s.c_str(), &end);
+  if (end != s.c_str() + s.size() || s.empty()) {
+    return {first, std::errc::invalid_argument};
+  }
+  if (errno == ERANGE && std::isinf(v)) {
+    return {last, std::errc::result_out_of_range};
+  }
+  value = v;
+  return {last, std::errc{}};
+}
+
+struct to_chars_result {
+  char *ptr;
+  std::errc ec;
+};
+
+// Substitute with snprintf, trying precisions up to 17 digits for the
+// shortest output that reads back exactly. Only for finite values.
+inline to_chars_result to_chars(char *first, char *last, double value) {
+  auto const point = *std::localeconv()->decimal_point;
+  char s[32];
+  int n = 0;
+  for (int precision = 1; precision <= 17; precision++) {
+    n = std::snprintf(s, sizeof(s), "%.*g", precision, value);
+    // Read back in the same locale as written
+    if (std::strtod(s, nullptr) == value) {
+      break;
+    }
+  }
+  if (n < 0 || last - first < n) {
+    return {last, std::errc::value_too_large};
+  }
+  for (int i = 0; i < n; i++) {
+    first[i] = s[i] == point ? '.' : s[i];
+  }
+  return {first + n, std::errc{}};
+}
+
+#endif
+
+} // namespace flom::compat
+
+#endif
@@ -0,0 +1,79 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_COMPAT_SPAN_HPP
+#define FLOM_COMPAT_SPAN_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace flom::compat {
+
+// Minimal substitute of std::span (C++20) with dynamic extent
+template <typename T> class span {
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using size_type = std::size_t;
+  using pointer = T *;
+  using reference = T &;
+  using iterator = T *;
+
+private:
+  T *data_;
+  std::size_t size_;
+
+public:
+  constexpr span() noexcept : data_(), size_() {}
+  constexpr span(T *data, std::size_t size) noexcept
+      : data_(data), size_(size) {}
+  template <std::size_t N>
+  constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible<
+                decltype(std::declval<Container &>().data()), T *>::value>>
+  constexpr span(Container &c) noexcept : data_(c.data()), size_(c.size()) {}
+  // Spans of const elements also view const and temporary containers
+  template <typename Container, typename U = T,
+            typename = std::enable_if_t<
+                std::is_const<U>::value &&
+                std::is_convertible<
+                    decltype(std::declval<const Container &>().data()),
+                    T *>::value>>
+  constexpr span(const Container &c) noexcept
+      : data_(c.data()), size_(c.size()) {}
+
+  constexpr T *data() const noexcept { return this->data_; }
+  constexpr std::size_t size() const noexcept { return this->size_; }
+  constexpr bool empty() const noexcept { return this->size_ == 0; }
+
+  constexpr iterator begin() const noexcept { return this->data_; }
+  constexpr iterator end() const noexcept { return this->data_ + this->size_; }
+
+  constexpr T &operator[](std::size_t i) const { return this->data_[i]; }
+
+  constexpr span subspan(std::size_t offset, std::size_t count) const {
+    return {this->data_ + offset, count};
+  }
+};
+
+} // namespace flom::compat
+
+#endif
@@ -65,6 +65,20 @@ public:
   virtual const char *what() const noexcept;
 };
 
+class FileError : public std::exception {
+public:
+  // error is the errno value of the failed system call
+  FileError(const std::string &path, int error);
+  virtual const char *what() const noexcept;
+
+  std::string path() const noexcept;
+  int error_code() const noexcept;
+
+private:
+  std::string path_;
+  int error_;
+};
+
 class SerializationError : public std::exception {
 public:
   // TODO: include additional information
@@ -25,7 +25,13 @@
 #include "flom/errors.hpp"
 #include "flom/frame.hpp"
 #include "flom/interpolation.hpp"
+#include "flom/lazy_motion.hpp"
 #include "flom/motion.hpp"
+#include "flom/motion_cursor.hpp"
+#include "flom/motion_loader.hpp"
+#include "flom/motion_reader.hpp"
 #include "flom/range.hpp"
+#include "flom/sample_buffer.hpp"
+#include "flom/thread_pool.hpp"
 
 #endif
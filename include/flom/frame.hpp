@@ -21,9 +21,13 @@
 #define FLOM_FRAME_HPP
 
 #include "flom/effector.hpp"
+#include "flom/frame_schema.hpp"
+#include "flom/named_range.hpp"
 
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/operators.hpp>
 #include <boost/range/any_range.hpp>
@@ -45,8 +49,9 @@ class FrameDifference
                          boost::multipliable<FrameDifference, std::size_t>>> {
 
 private:
-  std::unordered_map<std::string, double> positions_;
-  std::unordered_map<std::string, EffectorDifference> effectors_;
+  std::shared_ptr<const FrameSchema> schema_;
+  std::vector<double> positions_;
+  std::vector<EffectorDifference> effectors_;
 
 public:
   FrameDifference(const Frame &, const Frame &);
@@ -59,11 +64,12 @@ public:
   FrameDifference &operator=(const FrameDifference &) = default;
   FrameDifference &operator=(FrameDifference &&) = default;
 
-  const std::unordered_map<std::string, double> &positions() const &;
+  const std::shared_ptr<const FrameSchema> &schema() const noexcept;
+
+  NamedRange<double> positions() const &;
   std::unordered_map<std::string, double> positions() &&;
 
-  const std::unordered_map<std::string, EffectorDifference> &
-  effectors() const &;
+  NamedRange<EffectorDifference> effectors() const &;
   std::unordered_map<std::string, EffectorDifference> effectors() &&;
 
   FrameDifference &operator*=(std::size_t);
@@ -79,25 +85,54 @@ private:
   using PositionsMap = std::unordered_map<std::string, double>;
   using EffectorsMap = std::unordered_map<std::string, Effector>;
 
-  PositionsMap positions_;
-  EffectorsMap effectors_;
+  // Values are stored in the order of names in the schema
+  std::shared_ptr<const FrameSchema> schema_;
+  std::vector<double> positions_;
+  std::vector<Effector> effectors_;
+  // Whether schema_ was created by this frame, as a non-const object
+  bool owns_schema_ = false;
+
+  void set_schema(NameTable joints, NameTable effectors);
+  // Schema to add names to, which is modified in place
+  // unless another frame or motion shares it
+  FrameSchema &mutable_schema();
 
 public:
   Frame();
   Frame(const PositionsMap &, const EffectorsMap &);
+  // Moves names and values out of the maps
+  Frame(PositionsMap &&, EffectorsMap &&);
+
+  // Creates a frame with zero positions and empty effectors
+  explicit Frame(std::shared_ptr<const FrameSchema>);
 
-  const PositionsMap &positions() const &;
+  const std::shared_ptr<const FrameSchema> &schema() const noexcept;
+
+  // Returns a copy of this frame laid out in the supplied schema.
+  // The schema must contain all names in this frame.
+  Frame rebind(const std::shared_ptr<const FrameSchema> &) const;
+
+  NamedRange<double> positions() const &;
   PositionsMap positions() &&;
 
+  // Values are written in place if names are the same as this frame's
   void set_positions(const PositionsMap &);
+  void set_positions(PositionsMap &&);
   void set_position(const std::string &, double);
 
-  const EffectorsMap &effectors() const &;
+  NamedRange<Effector> effectors() const &;
   EffectorsMap effectors() &&;
 
   void set_effectors(const EffectorsMap &);
+  void set_effectors(EffectorsMap &&);
   void set_effector(const std::string &, const Effector &);
 
+  // Index-addressed access, following the order of names in schema()
+  const double *position_data() const noexcept;
+  double *position_data() noexcept;
+  const Effector *effector_data() const noexcept;
+  Effector *effector_data() noexcept;
+
   KeyRange<std::string> joint_names() const;
   KeyRange<std::string> effector_names() const;
 
@@ -0,0 +1,101 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_FRAME_SCHEMA_HPP
+#define FLOM_FRAME_SCHEMA_HPP
+
+#include "flom/compat/optional.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flom {
+
+// Immutable mapping between names and dense indices
+class NameTable {
+private:
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, std::size_t> indices_;
+
+public:
+  NameTable();
+  explicit NameTable(std::vector<std::string> names);
+
+  std::size_t size() const noexcept;
+  bool empty() const noexcept;
+
+  const std::vector<std::string> &names() const noexcept;
+  const std::string &name(std::size_t) const;
+
+  compat::optional<std::size_t> find(const std::string &) const;
+  // throws std::out_of_range if the name is not in the table
+  std::size_t index(const std::string &) const;
+
+  NameTable with(const std::string &) const;
+  // Appends a name not in the table
+  void add(const std::string &);
+};
+
+// true if both have the same names in the same order
+bool operator==(const NameTable &, const NameTable &);
+bool operator!=(const NameTable &, const NameTable &);
+
+// Joint and effector layout shared between frames.
+// Frames with the same schema store their values at the same indices.
+class FrameSchema {
+private:
+  NameTable joints_;
+  NameTable effectors_;
+
+public:
+  FrameSchema(NameTable joints, NameTable effectors);
+
+  const NameTable &joints() const noexcept;
+  const NameTable &effectors() const noexcept;
+  // Only for schemas no other frame refers to
+  NameTable &mutable_joints() noexcept;
+  NameTable &mutable_effectors() noexcept;
+
+  static const std::shared_ptr<const FrameSchema> &empty();
+};
+
+bool operator==(const FrameSchema &, const FrameSchema &);
+bool operator!=(const FrameSchema &, const FrameSchema &);
+
+// Calls f(i, j) for each name, where i is the index in `a` and j is the index
+// of the same name in `b`. `b` must contain all names of `a`.
+template <typename F>
+void for_each_matched(const NameTable &a, const NameTable &b, F &&f) {
+  if (&a == &b || a == b) {
+    for (std::size_t i = 0; i < a.size(); i++) {
+      f(i, i);
+    }
+  } else {
+    for (std::size_t i = 0; i < a.size(); i++) {
+      f(i, b.index(a.name(i)));
+    }
+  }
+}
+
+} // namespace flom
+
+#endif
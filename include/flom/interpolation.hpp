@@ -23,6 +23,9 @@
 #include "flom/effector.hpp"
 #include "flom/frame.hpp"
 
+#include <array>
+#include <cstddef>
+
 namespace flom {
 
 template <typename T, typename U,
@@ -37,6 +40,48 @@ Effector interpolate(double t, Effector const &a, Effector const &b);
 Frame interpolate(double t, Frame const &a, Frame const &b);
 double interpolate(double t, double a, double b);
 
+// Computes out[i] = lerp(t, a[i], b[i]) for i in [0, n),
+// using SIMD instructions the running CPU supports.
+// out may be the same as a or b, but must not partially overlap them.
+void lerp_n(double t, const double *a, const double *b, double *out,
+            std::size_t n);
+
+// Pointers to w, x, y and z components of quaternions
+// stored as structure of arrays
+template <typename T> struct QuaternionArrays {
+  T *w;
+  T *x;
+  T *y;
+  T *z;
+
+  QuaternionArrays operator+(std::size_t i) const noexcept {
+    return {this->w + i, this->x + i, this->y + i, this->z + i};
+  }
+};
+
+// Quaternions laid out as [w..., x..., y..., z...]
+template <typename T>
+QuaternionArrays<T> planar_quaternions(T *p, std::size_t n) noexcept {
+  return {p, p + n, p + 2 * n, p + 3 * n};
+}
+
+// Slerps n pairs of unit quaternions into normalized out[i],
+// same as interpolate(double, Rotation const&, Rotation const&).
+// Components agree with it within 1e-12 for t in [0, 1].
+// The second overload takes a ratio for each quaternion.
+// out may be the same as a or b, but must not partially overlap them.
+void slerp_n(double t, QuaternionArrays<const double> a,
+             QuaternionArrays<const double> b, QuaternionArrays<double> out,
+             std::size_t n);
+void slerp_n(const double *t, QuaternionArrays<const double> a,
+             QuaternionArrays<const double> b, QuaternionArrays<double> out,
+             std::size_t n);
+
+// Angle between rotations of unit quaternions in (w, x, y, z), in radians.
+// Accurate for small angles, unlike acos of the dot product.
+double rotation_angle(const std::array<double, 4> &a,
+                      const std::array<double, 4> &b) noexcept;
+
 } // namespace flom
 
 #endif
@@ -0,0 +1,159 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_KEYFRAME_STORE_HPP
+#define FLOM_KEYFRAME_STORE_HPP
+
+#include "flom/compat/optional.hpp"
+#include "flom/effector.hpp"
+#include "flom/effector_type.hpp"
+#include "flom/frame.hpp"
+#include "flom/frame_schema.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace flom {
+
+// Pointers to a dense row of sampled values
+//   positions: [joints]
+//   locations: [effectors x 3] (x, y, z)
+//   rotations: [effectors x 4] (w, x, y, z)
+struct FrameRow {
+  double *positions;
+  double *locations;
+  double *rotations;
+};
+
+// Columnar storage of keyframes sorted by time.
+//
+// Each keyframe is a row of the following row-major matrices:
+//   positions: [keyframes x joints]
+//   locations: [keyframes x effectors x 3] (x, y, z)
+//   rotations: [keyframes x 4 x effectors] (all w, then x, y and z)
+// Components an effector doesn't have (according to its EffectorType)
+// are kept as zero location and identity rotation.
+class KeyframeStore {
+  friend bool operator==(const KeyframeStore &, const KeyframeStore &);
+
+private:
+  std::shared_ptr<const FrameSchema> schema_;
+  std::vector<EffectorType> types_;
+  // Cached sizes of the schema, used in hot loops
+  std::size_t num_joints_;
+  std::size_t num_effectors_;
+
+  std::vector<double> times_;
+  std::vector<double> positions_;
+  std::vector<double> locations_;
+  std::vector<double> rotations_;
+
+  // (last keyframe - first keyframe), kept up to date for add_loop_offset
+  //   loop_positions_: [joints]
+  //   loop_locations_: [effectors x 3]
+  //   loop_rotations_: [effectors x 4] (angle, axis x, y, z)
+  // where a rotation difference is (cos angle, sin angle * axis),
+  // so that its n-th power is computed in constant time.
+  std::vector<double> loop_positions_;
+  std::vector<double> loop_locations_;
+  std::vector<double> loop_rotations_;
+
+  // Whether times start at 0 and are sorted, kept up to date on changes
+  bool valid_times_;
+
+  void update_loop_offset();
+  // Rescans times unless the change is known to keep them valid
+  void update_valid_times(bool kept);
+  // Appends a zero row, returning its index
+  std::size_t append_row(double t);
+
+public:
+  // types must be ordered as effectors in the schema
+  KeyframeStore(std::shared_ptr<const FrameSchema>, std::vector<EffectorType>);
+
+  const std::shared_ptr<const FrameSchema> &schema() const noexcept;
+  const std::vector<EffectorType> &types() const noexcept;
+
+  std::size_t size() const noexcept;
+  bool empty() const noexcept;
+  std::size_t num_joints() const noexcept;
+  std::size_t num_effectors() const noexcept;
+
+  const std::vector<double> &times() const noexcept;
+  double time(std::size_t) const noexcept;
+  // Same as checking times, in constant time
+  bool has_valid_times() const noexcept;
+
+  // Index of the first keyframe not earlier than t
+  std::size_t lower_bound(double t) const noexcept;
+  // Index of the first keyframe later than t
+  std::size_t upper_bound(double t) const noexcept;
+  compat::optional<std::size_t> find(double t) const noexcept;
+
+  // Pointers to rows of each matrix
+  const double *positions_at(std::size_t) const noexcept;
+  const double *locations_at(std::size_t) const noexcept;
+  const double *rotations_at(std::size_t) const noexcept;
+
+  Location location(std::size_t k, std::size_t effector) const;
+  Rotation rotation(std::size_t k, std::size_t effector) const;
+
+  Frame frame(std::size_t) const;
+
+  // Frames passed to or from these must be bound to schema()
+  void read(std::size_t, Frame &) const;
+  void write(std::size_t, const Frame &);
+  // Writes without updating loop offset, for rows that are only read
+  // or interpolated, not looped
+  void write_row(std::size_t, const Frame &);
+  // Interpolates keyframes k and k + 1 with ratio t
+  void interpolate(std::size_t k, double t, Frame &) const;
+  // Adds (last keyframe - first keyframe) * n, as a looping motion does.
+  // This takes constant time in n.
+  void add_loop_offset(std::size_t n, Frame &) const;
+
+  // Same as above, writing to dense rows
+  void read(std::size_t, FrameRow) const;
+  void interpolate(std::size_t k, double t, FrameRow) const;
+  void add_loop_offset(std::size_t n, FrameRow) const;
+
+  // Replaces the keyframe if one already exists at the time.
+  // Returns the index of inserted keyframe.
+  std::size_t insert(double t, const Frame &);
+  // Inserts keyframes sorted by time without duplicates, replacing ones
+  // at the same times. Keyframes are appended in place when all are later
+  // than the last one; otherwise storage is rebuilt once.
+  void merge(const std::vector<std::pair<double, Frame>> &);
+  // Replaces all keyframes with the rows of matrices in the layout above.
+  // times must be sorted without duplicates.
+  void assign(std::vector<double> times, std::vector<double> positions,
+              std::vector<double> locations, std::vector<double> rotations);
+  void erase(std::size_t);
+  void truncate(std::size_t);
+  void reserve(std::size_t);
+};
+
+bool operator==(const KeyframeStore &, const KeyframeStore &);
+bool operator!=(const KeyframeStore &, const KeyframeStore &);
+
+} // namespace flom
+
+#endif
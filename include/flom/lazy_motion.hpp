@@ -0,0 +1,79 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_LAZY_MOTION_HPP
+#define FLOM_LAZY_MOTION_HPP
+
+#include "flom/effector_type.hpp"
+#include "flom/effector_weight.hpp"
+#include "flom/frame.hpp"
+#include "flom/motion.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flom {
+
+// Motion in a file (see Motion::dump), decoded on demand.
+//
+// Opening the file scans it once to index the time and position of each
+// keyframe, decoding only the first one. Other keyframes are decoded when
+// frame_at() or keyframe() needs them, and a bounded number of them are
+// cached. Keyframes are validated as they are decoded, so
+// errors::InvalidFrameError may be thrown later than by Motion::load.
+class LazyMotion {
+private:
+  class Impl;
+  std::unique_ptr<Impl> impl;
+
+public:
+  // cache_size is the number of decoded keyframes kept at most
+  explicit LazyMotion(const std::string &path, std::size_t cache_size = 64);
+
+  LazyMotion(LazyMotion &&) noexcept;
+  LazyMotion &operator=(LazyMotion &&) noexcept;
+  ~LazyMotion();
+
+  std::string model_id() const;
+  LoopType loop() const;
+  double length() const;
+  bool is_in_range_at(double t) const;
+
+  KeyRange<std::string> joint_names() const;
+  KeyRange<std::string> effector_names() const;
+  EffectorType effector_type(const std::string &) const;
+  EffectorWeight effector_weight(const std::string &) const;
+
+  // Same as Motion::frame_at
+  Frame frame_at(double t);
+
+  // Times of keyframes in order, as in Motion::keyframes()
+  const std::vector<double> &keyframe_times() const noexcept;
+  // Keyframe at the index in keyframe_times()
+  Frame keyframe(std::size_t);
+
+  // Decodes all keyframes
+  Motion to_motion() const;
+};
+
+} // namespace flom
+
+#endif
@@ -0,0 +1,57 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_MAPPED_FILE_HPP
+#define FLOM_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace flom {
+
+// Read-only memory mapping of a whole file.
+// Files which can't be mapped, such as pipes, are read into memory instead.
+// Throws errors::FileError if the file can't be opened or mapped.
+class MappedFile {
+private:
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+  // Contents of a file read instead of mapped
+  std::vector<char> buffer_;
+
+  // Reads the rest of fd into buffer_, closing it
+  void read_all(int fd, const std::string &path);
+
+public:
+  // Pages are read ahead for sequential access.
+  // With populate, all pages are read in while mapping.
+  explicit MappedFile(const std::string &path, bool populate = false);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const noexcept;
+  std::size_t size() const noexcept;
+};
+
+} // namespace flom
+
+#endif
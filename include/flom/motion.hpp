@@ -20,6 +20,7 @@
 #ifndef FLOM_MOTION_HPP
 #define FLOM_MOTION_HPP
 
+#include "flom/compat/span.hpp"
 #include "flom/effector_type.hpp"
 #include "flom/effector_weight.hpp"
 #include "flom/frame.hpp"
@@ -29,21 +30,64 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace flom {
 
 enum class LoopType { None, Wrap };
 
+// Maximum errors of values in a quantized columnar file
+// (see Motion::dump_columnar). Values with an error of 0 are kept exact.
+struct Quantization {
+  // Joint positions
+  double position = 1e-4;
+  // Each component of effector locations
+  double location = 1e-4;
+  // Angle of effector rotations in radians
+  double rotation = 1e-4;
+  // Keyframe times in seconds
+  double time = 1e-6;
+  // Decodes the data before writing it to check the errors,
+  // throwing errors::SerializationError if any is exceeded
+  bool verify = false;
+};
+
+// Options of Motion::dump_json
+struct JSONFormat {
+  // Writes joint and effector names once as "jointNames" and
+  // "effectorNames", and values of each frame as arrays in that order.
+  // Motion::load_json reads both forms.
+  bool name_table = false;
+};
+
 class FrameRange;
 class KeyframeRange;
 class ConstKeyframeRange;
+class SampleBuffer;
 
 class Motion {
   friend bool operator==(const Motion &, const Motion &);
+  friend class MotionCursor;
+  friend class CheckedFrameRef;
+  friend class keyframe_iterator;
+  friend class KeyframeRange;
+  friend class MotionLoader;
 
 public:
+  // Loads a motion in either format written by dump or dump_columnar,
+  // detected by the leading bytes
   static Motion load(std::istream &);
+  // Parses directly from the memory mapped file.
+  // With populate, the whole file is read in at once, which is faster
+  // when it is likely to be in the page cache already.
+  static Motion load_file(const std::string &path, bool populate = false);
+  // Same as load, but decodes one keyframe at a time (see read_keyframes),
+  // so that memory is not held for the whole parsed message.
+  // Columnar files are read as a whole, as load does
+  static Motion load_streaming(std::istream &);
+  // Parses the JSON mapping of the protobuf message, such as written by
+  // dump_json, directly into keyframes
   static Motion load_json(std::istream &);
   static Motion load_json_string(std::string const &);
 
@@ -51,21 +95,51 @@ public:
          const std::unordered_map<std::string, EffectorType> &effector_types,
          const std::string &model = "");
 
+  // Copies share data until either of them is modified
   Motion(Motion const &);
+  Motion &operator=(Motion const &);
+  // A moved-from motion can only be assigned to or destroyed
+  Motion(Motion &&) noexcept;
+  Motion &operator=(Motion &&) noexcept;
   ~Motion();
 
   bool is_valid() const;
+  // Frames obtained from new_keyframe() or frame_at() are validated
+  // without comparing joint and effector names
   bool is_valid_frame(const Frame &) const;
 
   Frame frame_at(double t) const;
+  // Same as frame_at, but writes into the supplied frame.
+  // No allocation occurs once the frame is laid out for this motion
+  // (i.e. it has been passed here or obtained from new_keyframe()).
+  void frame_at_into(double t, Frame &) const;
+
+  // Evaluates frames at each time into a dense buffer.
+  // Sorted times are processed in one pass over keyframes (see MotionCursor).
+  // On error (same as frame_at), contents of the buffer are unspecified.
+  void sample(compat::span<const double> times, SampleBuffer &) const;
+  SampleBuffer sample(compat::span<const double> times) const;
 
   FrameRange frames(double fps) const;
 
   bool is_in_range_at(double t) const;
 
   void dump(std::ostream &) const;
+  // Writes the columnar format, where keyframes are stored as aligned
+  // matrices instead of named values. Loading it is a bulk copy.
+  void dump_columnar(std::ostream &) const;
+  // Same as above, but quantizes values within the errors: joint positions
+  // and locations as fixed-point values in the range of each channel,
+  // rotations in the smallest three form and times as delta-coded ticks.
+  // Fixed-point values are stored as residuals of a prediction by previous
+  // keyframes where that is smaller.
+  // Channels which can't be quantized within the error are kept exact.
+  void dump_columnar(std::ostream &, const Quantization &) const;
+  // JSON is written from keyframes as it goes, in chunks
   void dump_json(std::ostream &) const;
+  void dump_json(std::ostream &, const JSONFormat &) const;
   std::string dump_json_string() const;
+  std::string dump_json_string(const JSONFormat &) const;
 
   LoopType loop() const;
   void set_loop(LoopType);
@@ -75,11 +149,21 @@ public:
 
   Frame new_keyframe() const;
   void insert_keyframe(double t, const Frame &);
+  // Inserts many keyframes at once, as if by insert_keyframe in order.
+  // All frames are validated before any of them is inserted.
+  // Pass already sorted frames later than length() to append them
+  // without moving existing keyframes.
+  void insert_keyframes(std::vector<std::pair<double, Frame>>);
   void delete_keyframe(double t, bool loose = true);
   KeyframeRange keyframes();
   ConstKeyframeRange keyframes() const;
   ConstKeyframeRange const_keyframes() const;
   void clear_keyframes();
+  // Removes keyframes which the remaining ones interpolate within the errors
+  // at their times: max_position_error for joint positions and distances of
+  // effector locations, max_rotation_error for angles of effector rotations
+  // in radians. The first and the last keyframes are kept.
+  void simplify(double max_position_error, double max_rotation_error);
 
   EffectorType effector_type(const std::string &) const;
 
@@ -93,7 +177,10 @@ public:
 
 private:
   class Impl;
-  std::unique_ptr<Impl> impl;
+  std::shared_ptr<Impl> impl;
+
+  // Detaches impl from other copies
+  Impl &mutable_impl();
 };
 
 bool operator==(const Motion &, const Motion &);
@@ -21,56 +21,103 @@
 #define FLOM_MOTION_IMPL_HPP
 
 #include "flom/frame.hpp"
+#include "flom/frame_schema.hpp"
+#include "flom/keyframe_store.hpp"
 #include "flom/motion.hpp"
 
 #include "motion.pb.h"
 
+#include <google/protobuf/arena.h>
+
 #include <functional>
-#include <map>
+#include <memory>
 #include <numeric>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace flom {
 
-template <typename K> std::size_t names_hash(const std::unordered_set<K> &s) {
-  auto h{s.hash_function()};
-  return std::accumulate(std::cbegin(s), std::cend(s),
+class ThreadPool;
+
+inline std::size_t names_hash(const NameTable &names) {
+  std::hash<std::string> h;
+  return std::accumulate(std::cbegin(names.names()), std::cend(names.names()),
                          static_cast<std::size_t>(0),
-                         [&h](auto r, const auto &p) { return r ^ h(p); });
+                         [&h](auto r, const auto &name) { return r ^ h(name); });
+}
+
+inline std::shared_ptr<const FrameSchema> make_schema(
+    const std::unordered_set<std::string> &joints,
+    const std::unordered_map<std::string, EffectorType> &effectors) {
+  std::vector<std::string> effector_names;
+  effector_names.reserve(effectors.size());
+  for (auto const &[name, type] : effectors) {
+    effector_names.push_back(name);
+  }
+  return std::make_shared<const FrameSchema>(
+      NameTable{{std::cbegin(joints), std::cend(joints)}},
+      NameTable{std::move(effector_names)});
 }
 
-template <typename K, typename V>
-std::size_t names_hash(const std::unordered_map<K, V> &m) {
-  auto h{m.hash_function()};
-  return std::accumulate(
-      std::cbegin(m), std::cend(m), static_cast<std::size_t>(0),
-      [&h](auto r, const auto &p) { return r ^ h(p.first); });
+// Effector types in the order of effectors in the schema
+inline std::vector<EffectorType> types_in(
+    const FrameSchema &schema,
+    const std::unordered_map<std::string, EffectorType> &effectors) {
+  std::vector<EffectorType> types;
+  types.reserve(schema.effectors().size());
+  for (auto const &name : schema.effectors().names()) {
+    types.push_back(effectors.at(name));
+  }
+  return types;
 }
 
+// Order of columns in rows decoded in the order of names in a file:
+// joints[i] and effectors[i] are the indices in the schema of the i-th names,
+// and rotations are (w, x, y, z) for each effector instead of planar
+struct ColumnOrder {
+  std::vector<std::size_t> joints;
+  std::vector<std::size_t> effectors;
+};
+
+// Time in the first loop and the number of loops skipped to reach t,
+// in a motion of keyframes from 0 to motion_length.
+// Throws if the motion can't be evaluated at t.
+std::pair<double, std::size_t> loop_time(double t, double motion_length,
+                                         LoopType loop);
+
 class Motion::Impl {
 public:
   std::string model_id;
   LoopType loop;
-  std::map<double, Frame> raw_frames;
 
-  // keys of these two member must not be changed after construction
-  const std::unordered_set<std::string> joint_names;
+  // keys of effector_types must not be changed after construction
   const std::unordered_map<std::string, EffectorType> effector_types;
   std::unordered_map<std::string, EffectorWeight> effector_weights;
 
-  // Hash of joint_names
+  // Layout of joints and effectors shared by all keyframes
+  const std::shared_ptr<const FrameSchema> schema;
+
+  // Hash of joint names
   const std::size_t joints_hash;
   // Hash of keys of effector_types
   const std::size_t effectors_hash;
 
+  // Keyframes sorted by time, laid out in the schema.
+  // Shared between copies of a motion until one of them modifies it.
+  std::shared_ptr<KeyframeStore> shared_keyframes;
+
   Impl(const std::unordered_set<std::string> &joints,
        const std::unordered_map<std::string, EffectorType> &effectors,
        const std::string &model = "")
-      : model_id(model), loop(LoopType::None), raw_frames(),
-        joint_names(joints), effector_types(effectors),
-        joints_hash(names_hash(joints)), effectors_hash(names_hash(effectors)) {
+      : model_id(model), loop(LoopType::None), effector_types(effectors),
+        schema(make_schema(joints, effectors)),
+        joints_hash(names_hash(schema->joints())),
+        effectors_hash(names_hash(schema->effectors())),
+        shared_keyframes(std::make_shared<KeyframeStore>(
+            schema, types_in(*schema, effectors))) {
     this->effector_weights.reserve(effectors.size());
     for (const auto &[name, e] : effectors) {
       this->effector_weights.emplace(name, EffectorWeight{0.0, 0.0});
@@ -78,12 +125,51 @@ public:
     this->add_initial_frame();
   }
 
+  const KeyframeStore &keyframes() const noexcept {
+    return *this->shared_keyframes;
+  }
+  // Detaches keyframes from other copies
+  KeyframeStore &mutable_keyframes();
+
   void add_initial_frame();
   Frame new_keyframe() const noexcept;
 
+  // Replaces keyframes with rows in the layout of the store, or in order
+  // if given, in any order of time. The last one of rows at the same time
+  // is kept, and the initial keyframe is added unless a row replaces it.
+  void assign_keyframes(std::vector<double> times,
+                        std::vector<double> positions,
+                        std::vector<double> locations,
+                        std::vector<double> rotations,
+                        const ColumnOrder *order = nullptr);
+
   static Motion from_protobuf(proto::Motion const &);
+  // Parses a message allocated in the arena,
+  // or with parse_parallel if a pool is given
+  static Motion parse(std::istream &, google::protobuf::Arena &,
+                      ThreadPool *pool = nullptr);
+  static Motion parse(const char *data, std::size_t size,
+                      google::protobuf::Arena &, ThreadPool *pool = nullptr);
+  // Locates frames in the message, and decodes chunks of them on the pool.
+  // See motion_reader.cpp.
+  static Motion parse_parallel(const char *data, std::size_t size,
+                               ThreadPool &);
+  // Frames decoded by each task of parse_parallel
+  static constexpr std::size_t frames_per_chunk = 256;
+  // Options for arenas of intermediate messages while loading
+  static google::protobuf::ArenaOptions arena_options() noexcept;
   proto::Motion to_protobuf() const;
 
+  // See motion_columnar.cpp for the layout
+  static bool is_columnar(const char *data, std::size_t size) noexcept;
+  static bool is_columnar(std::istream &);
+  static Motion from_columnar(const char *data, std::size_t size);
+  static Motion from_columnar(std::istream &);
+  // See motion_json.cpp
+  static Motion from_json(const char *data, std::size_t size);
+  // Writes to the stream if given, otherwise returns the whole JSON
+  std::string to_json(std::ostream *, const JSONFormat &) const;
+
   bool is_valid() const;
   bool is_valid_frame(const Frame &) const;
 };
@@ -0,0 +1,63 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_MOTION_CURSOR_HPP
+#define FLOM_MOTION_CURSOR_HPP
+
+#include "flom/frame.hpp"
+#include "flom/keyframe_store.hpp"
+#include "flom/motion.hpp"
+
+#include <cstddef>
+
+namespace flom {
+
+// Evaluates frames of a motion, remembering the keyframe segment
+// used last time. Times close to the previous one (forward playback,
+// small backward seeks and wrapping around a looping motion) are located
+// in constant time; binary search is used only as a fallback.
+//
+// The motion must outlive the cursor. It may be modified in between;
+// the remembered segment is only a hint.
+class MotionCursor {
+private:
+  const Motion *motion;
+  std::size_t segment_ = 0;
+
+  // Index k such that time(k) <= t < time(k + 1), or the last keyframe
+  std::size_t locate(const KeyframeStore &, double t) noexcept;
+
+  template <typename Out> void evaluate(double t, Out &&);
+
+public:
+  explicit MotionCursor(const Motion &motion_) noexcept : motion(&motion_) {}
+
+  // Same as Motion::frame_at and Motion::frame_at_into
+  Frame frame_at(double t);
+  void frame_at_into(double t, Frame &);
+  // Same as above, writing to a dense row shaped for the motion
+  void frame_at_into(double t, FrameRow);
+
+  // Index of the keyframe starting the segment used last time
+  std::size_t segment() const noexcept { return this->segment_; }
+};
+
+} // namespace flom
+
+#endif
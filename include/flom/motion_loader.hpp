@@ -0,0 +1,63 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_MOTION_LOADER_HPP
+#define FLOM_MOTION_LOADER_HPP
+
+#include "flom/motion.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace flom {
+
+class ThreadPool;
+
+// Loads motions one after another, keeping the memory used for parsing.
+//
+// Intermediate data of a load is allocated in one block, which grows to
+// the largest size needed so far and is released at once after the load.
+// Loading files of similar size then doesn't allocate for parsing at all.
+class MotionLoader {
+private:
+  std::unique_ptr<char[]> block;
+  std::size_t block_size = 0;
+  ThreadPool *pool = nullptr;
+
+public:
+  MotionLoader() = default;
+  // Frames of protobuf motions are decoded in parallel on the pool,
+  // which must outlive the loader
+  explicit MotionLoader(ThreadPool &pool_) noexcept : pool(&pool_) {}
+
+  // Same as Motion::load and Motion::load_file
+  Motion load(std::istream &);
+  Motion load_file(const std::string &path, bool populate = false);
+
+  // Size of the memory kept for the next load, in bytes
+  std::size_t capacity() const noexcept { return this->block_size; }
+  // Releases the kept memory
+  void shrink_to_fit() noexcept;
+};
+
+} // namespace flom
+
+#endif
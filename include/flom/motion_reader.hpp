@@ -0,0 +1,56 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_MOTION_READER_HPP
+#define FLOM_MOTION_READER_HPP
+
+#include "flom/effector_type.hpp"
+#include "flom/effector_weight.hpp"
+#include "flom/frame.hpp"
+#include "flom/motion.hpp"
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+namespace flom {
+
+// Properties of a motion other than keyframes
+struct MotionHeader {
+  std::string model_id;
+  LoopType loop = LoopType::None;
+  std::unordered_map<std::string, EffectorType> effector_types;
+  std::unordered_map<std::string, EffectorWeight> effector_weights;
+};
+
+using KeyframeCallback = std::function<void(double t, const Frame &)>;
+
+// Reads a motion in the binary format (see Motion::dump) one keyframe at a
+// time, without holding the whole message in memory.
+//
+// f is called for each keyframe in the order in the input, with a frame
+// that is reused between calls. All frames have the same schema.
+// Effector types must precede frames in the input, as Motion::dump and
+// protobuf serializers write them; otherwise errors::ParseError is thrown.
+MotionHeader read_keyframes(std::istream &, const KeyframeCallback &f);
+
+} // namespace flom
+
+#endif
@@ -0,0 +1,201 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_MOTION_READER_IMPL_HPP
+#define FLOM_MOTION_READER_IMPL_HPP
+
+#include "flom/effector.hpp"
+#include "flom/effector_type.hpp"
+#include "flom/frame.hpp"
+#include "flom/frame_schema.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Decoding of the protobuf wire format of motions, one field at a time
+namespace flom::wire {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// Field numbers in motion.proto and frame.proto
+namespace fields {
+constexpr int model_id = 1;
+constexpr int loop = 2;
+constexpr int effector_types = 3;
+constexpr int frames = 4;
+constexpr int effector_weights = 5;
+
+constexpr int frame_t = 1;
+constexpr int frame_positions = 2;
+constexpr int frame_effectors = 3;
+
+constexpr int effector_location = 2;
+constexpr int effector_rotation = 3;
+
+constexpr int map_key = 1;
+constexpr int map_value = 2;
+} // namespace fields
+
+// Throws errors::ParseError
+[[noreturn]] void parse_error();
+
+bool is_length_delimited(std::uint32_t tag);
+bool is_double(std::uint32_t tag);
+
+double read_double(CodedInputStream &);
+void read_string(CodedInputStream &, std::string &);
+
+// Calls f(field number, tag) for each field until the end of input or the
+// current limit. f returns false to skip the field.
+template <typename F> void read_fields(CodedInputStream &in, F &&f) {
+  while (auto const tag = in.ReadTag()) {
+    if (!f(WireFormatLite::GetTagFieldNumber(tag), tag) &&
+        !WireFormatLite::SkipField(&in, tag)) {
+      parse_error();
+    }
+  }
+  if (!in.ConsumedEntireMessage()) {
+    parse_error();
+  }
+}
+
+// Same as read_fields, for a length-delimited message
+template <typename F> void read_message(CodedInputStream &in, F &&f) {
+  std::uint32_t length;
+  if (!in.ReadVarint32(&length) ||
+      length > static_cast<std::uint32_t>(std::numeric_limits<int>::max())) {
+    parse_error();
+  }
+  auto const limit = in.PushLimit(static_cast<int>(length));
+  read_fields(in, std::forward<F>(f));
+  in.PopLimit(limit);
+}
+
+// Reads a map entry, where f(tag) reads the value
+template <typename F>
+void read_map_entry(CodedInputStream &in, std::string &key, F &&f) {
+  key.clear();
+  read_message(in, [&](int field, std::uint32_t tag) {
+    if (field == fields::map_key && is_length_delimited(tag)) {
+      read_string(in, key);
+      return true;
+    }
+    if (field == fields::map_value) {
+      return f(tag);
+    }
+    return false;
+  });
+}
+
+// Reads an entry of a map of small messages through the generated class
+template <typename Message>
+void read_message_entry(CodedInputStream &in, std::string &key,
+                        std::string &buffer, Message &m) {
+  m.Clear();
+  read_map_entry(in, key, [&](std::uint32_t tag) {
+    if (!is_length_delimited(tag)) {
+      return false;
+    }
+    read_string(in, buffer);
+    if (!m.ParseFromString(buffer)) {
+      parse_error();
+    }
+    return true;
+  });
+}
+
+Effector read_effector(CodedInputStream &);
+
+// Reads a Frame message, calling position(name, value) and
+// effector(name, Effector) for each entry. Returns the time.
+template <typename P, typename E>
+double read_frame(CodedInputStream &in, std::string &key, P &&position,
+                  E &&effector) {
+  double t = 0;
+  read_message(in, [&](int field, std::uint32_t tag) {
+    if (field == fields::frame_t && is_double(tag)) {
+      t = read_double(in);
+      return true;
+    }
+    if (field == fields::frame_positions && is_length_delimited(tag)) {
+      double v = 0;
+      read_map_entry(in, key, [&](std::uint32_t value_tag) {
+        if (!is_double(value_tag)) {
+          return false;
+        }
+        v = read_double(in);
+        return true;
+      });
+      position(key, v);
+      return true;
+    }
+    if (field == fields::frame_effectors && is_length_delimited(tag)) {
+      Effector e;
+      read_map_entry(in, key, [&](std::uint32_t value_tag) {
+        if (!is_length_delimited(value_tag)) {
+          return false;
+        }
+        e = read_effector(in);
+        return true;
+      });
+      effector(key, e);
+      return true;
+    }
+    return false;
+  });
+  return t;
+}
+
+// Reads a Frame message in its own layout
+std::pair<double, Frame> read_frame(CodedInputStream &, std::string &key);
+
+// Reads Frame messages into frames laid out in a fixed schema
+class FrameDecoder {
+private:
+  std::shared_ptr<const FrameSchema> schema;
+  std::vector<EffectorType> types;
+  std::string key;
+  std::vector<char> seen_joints;
+  std::vector<char> seen_effectors;
+
+public:
+  // types must be ordered as effectors in the schema
+  FrameDecoder(std::shared_ptr<const FrameSchema>, std::vector<EffectorType>);
+
+  // Reads into a frame bound to the schema, returning the time.
+  // Throws errors::InvalidFrameError if the frame doesn't have the same
+  // names as the schema, or effectors don't match their types.
+  double read(CodedInputStream &, Frame &);
+
+  // Copies a frame with the same names as the schema into the layout,
+  // checking it the same way as read()
+  Frame bind(const Frame &) const;
+};
+
+} // namespace flom::wire
+
+#endif
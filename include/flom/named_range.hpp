@@ -0,0 +1,177 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_NAMED_RANGE_HPP
+#define FLOM_NAMED_RANGE_HPP
+
+#include "flom/frame_schema.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace flom {
+
+// using snake_case, following customs of iterator naming
+template <typename T> class named_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::pair<const std::string, T>;
+  using difference_type = std::ptrdiff_t;
+  // the value is copied so that it can be modified after decomposition
+  using reference = std::pair<const std::string &, T>;
+
+  class pointer {
+  private:
+    reference ref;
+
+  public:
+    explicit pointer(reference ref_) : ref(ref_) {}
+    const reference *operator->() const noexcept { return &this->ref; }
+  };
+
+private:
+  const std::string *name;
+  const T *value;
+
+public:
+  named_iterator() noexcept : name(), value() {}
+  named_iterator(const std::string *name_, const T *value_) noexcept
+      : name(name_), value(value_) {}
+
+  reference operator*() const { return {*this->name, *this->value}; }
+  pointer operator->() const { return pointer{**this}; }
+
+  named_iterator &operator++() noexcept {
+    this->name++;
+    this->value++;
+    return *this;
+  }
+  named_iterator operator++(int) noexcept {
+    auto const copy = *this;
+    ++(*this);
+    return copy;
+  }
+
+  bool operator==(const named_iterator &other) const noexcept {
+    return this->value == other.value;
+  }
+  bool operator!=(const named_iterator &other) const noexcept {
+    return !(*this == other);
+  }
+};
+
+// Read-only, map-like view of values addressed by a NameTable.
+// This keeps the name-based interface of Frame working on top of
+// index-addressed storage.
+template <typename T> class NamedRange {
+public:
+  using key_type = std::string;
+  using mapped_type = T;
+  using value_type = std::pair<const std::string, T>;
+  using size_type = std::size_t;
+  using iterator = named_iterator<T>;
+  using const_iterator = named_iterator<T>;
+
+private:
+  const NameTable *table_;
+  const T *values_;
+
+public:
+  NamedRange() = delete;
+  NamedRange(const NameTable &table, const T *values) noexcept
+      : table_(&table), values_(values) {}
+  NamedRange(const NamedRange &) = default;
+  NamedRange(NamedRange &&) = default;
+  NamedRange &operator=(const NamedRange &) = default;
+  NamedRange &operator=(NamedRange &&) = default;
+
+  iterator begin() const noexcept {
+    return {this->table_->names().data(), this->values_};
+  }
+  iterator end() const noexcept {
+    auto const n = this->size();
+    return {this->table_->names().data() + n, this->values_ + n};
+  }
+
+  const_iterator cbegin() const noexcept { return this->begin(); }
+  const_iterator cend() const noexcept { return this->end(); }
+
+  size_type size() const noexcept { return this->table_->size(); }
+  bool empty() const noexcept { return this->table_->empty(); }
+
+  const NameTable &names() const noexcept { return *this->table_; }
+  const T *data() const noexcept { return this->values_; }
+
+  const T &at(const std::string &name) const {
+    return this->values_[this->table_->index(name)];
+  }
+
+  size_type count(const std::string &name) const {
+    return this->table_->find(name) ? 1 : 0;
+  }
+
+  iterator find(const std::string &name) const {
+    if (auto const i = this->table_->find(name)) {
+      return {this->table_->names().data() + *i, this->values_ + *i};
+    }
+    return this->end();
+  }
+
+  std::unordered_map<std::string, T> to_map() const {
+    std::unordered_map<std::string, T> m;
+    m.reserve(this->size());
+    for (std::size_t i = 0; i < this->size(); i++) {
+      m.emplace(this->table_->name(i), this->values_[i]);
+    }
+    return m;
+  }
+
+  operator std::unordered_map<std::string, T>() const { return this->to_map(); }
+};
+
+// Compares as maps do; the order of names doesn't matter
+template <typename T>
+bool operator==(const NamedRange<T> &a, const NamedRange<T> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  if (&a.names() == &b.names() || a.names() == b.names()) {
+    return std::equal(a.data(), a.data() + a.size(), b.data());
+  }
+  for (auto const &[name, value] : a) {
+    auto const it = b.find(name);
+    if (it == b.end() || !(it->second == value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+bool operator!=(const NamedRange<T> &a, const NamedRange<T> &b) {
+  return !(a == b);
+}
+
+} // namespace flom
+
+#endif
@@ -22,10 +22,11 @@
 
 #include "flom/errors.hpp"
 #include "flom/frame.hpp"
+#include "flom/keyframe_store.hpp"
 #include "flom/motion.hpp"
 
+#include <cstddef>
 #include <iterator>
-#include <map>
 #include <memory>
 #include <utility>
 
@@ -103,35 +104,26 @@ public:
 
 class CheckedFrameRef {
 public:
-  using reference_type = Frame &;
+  CheckedFrameRef(Motion &motion_, std::size_t index_) noexcept
+      : motion(&motion_), index(index_) {}
 
-  CheckedFrameRef(reference_type value_, const Motion *motion_)
-      : value(value_), motion(motion_) {}
+  CheckedFrameRef &operator=(const Frame &frame) &;
 
-  CheckedFrameRef &operator=(const Frame &frame) & {
-    if (!this->motion->is_valid_frame(frame)) {
-      throw errors::InvalidFrameError{"in CheckedFrameWrapper"};
-    }
-    this->value = frame;
-    return *this;
-  }
-
-  operator reference_type() const noexcept { return this->value; }
+  // Keyframes are stored in columns; this materializes a Frame
+  operator Frame() const;
 
 private:
-  reference_type value;
-  const Motion *motion;
+  Motion *motion;
+  std::size_t index;
 };
 
 class keyframe_iterator {
 public:
-  using base_iterator = std::map<double, Frame>::iterator;
-
   using iterator_category = std::bidirectional_iterator_tag;
-  using value_type = std::iterator_traits<base_iterator>::value_type;
-  using difference_type = std::iterator_traits<base_iterator>::difference_type;
-  using pointer = std::iterator_traits<base_iterator>::pointer;
-  using reference = std::iterator_traits<base_iterator>::reference;
+  using value_type = std::pair<const double, Frame>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = value_type *;
+  using reference = value_type;
 
   using checked_value_type = std::pair<const double, CheckedFrameRef>;
 
@@ -139,23 +131,25 @@ private:
   friend bool operator==(const keyframe_iterator &,
                          const keyframe_iterator &) noexcept;
 
-  base_iterator it;
-  const Motion *motion;
+  // Keyframes are reached through the motion,
+  // which may detach them from its copies on modification
+  Motion *motion;
+  std::size_t index;
 
 public:
-  keyframe_iterator() noexcept : it(), motion() {}
-  explicit keyframe_iterator(base_iterator it_, const Motion &motion_) noexcept
-      : it(it_), motion(&motion_) {}
+  keyframe_iterator() noexcept : motion(), index() {}
+  keyframe_iterator(Motion &motion_, std::size_t index_) noexcept
+      : motion(&motion_), index(index_) {}
 
   keyframe_iterator(const keyframe_iterator &) = default;
   keyframe_iterator(keyframe_iterator &&) = default;
   keyframe_iterator &operator=(const keyframe_iterator &) = default;
   keyframe_iterator &operator=(keyframe_iterator &&) = default;
 
-  const value_type &operator*() const;
+  value_type operator*() const;
   checked_value_type operator*();
 
-  const value_type &operator->() const;
+  value_type operator->() const;
   checked_value_type operator->();
 
   keyframe_iterator &operator++() noexcept;
@@ -168,53 +162,128 @@ public:
 bool operator==(const keyframe_iterator &, const keyframe_iterator &) noexcept;
 bool operator!=(const keyframe_iterator &, const keyframe_iterator &) noexcept;
 
+// Frames are materialized on dereference,
+// so this is not a LegacyRandomAccessIterator strictly speaking
+class const_keyframe_iterator {
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::pair<const double, Frame>;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type;
+
+  class pointer {
+  private:
+    value_type value;
+
+  public:
+    explicit pointer(value_type value_) : value(std::move(value_)) {}
+    const value_type *operator->() const noexcept { return &this->value; }
+  };
+
+private:
+  friend bool operator==(const const_keyframe_iterator &,
+                         const const_keyframe_iterator &) noexcept;
+  friend bool operator<(const const_keyframe_iterator &,
+                        const const_keyframe_iterator &) noexcept;
+  friend difference_type operator-(const const_keyframe_iterator &,
+                                   const const_keyframe_iterator &) noexcept;
+
+  const KeyframeStore *store;
+  std::size_t index;
+
+public:
+  const_keyframe_iterator() noexcept : store(), index() {}
+  const_keyframe_iterator(const KeyframeStore &store_,
+                          std::size_t index_) noexcept
+      : store(&store_), index(index_) {}
+
+  reference operator*() const;
+  pointer operator->() const;
+  reference operator[](difference_type) const;
+
+  double time() const noexcept;
+
+  const_keyframe_iterator &operator++() noexcept;
+  const_keyframe_iterator operator++(int) noexcept;
+  const_keyframe_iterator &operator--() noexcept;
+  const_keyframe_iterator operator--(int) noexcept;
+
+  const_keyframe_iterator &operator+=(difference_type) noexcept;
+  const_keyframe_iterator &operator-=(difference_type) noexcept;
+};
+
+const_keyframe_iterator
+operator+(const_keyframe_iterator,
+          const_keyframe_iterator::difference_type) noexcept;
+const_keyframe_iterator operator+(const_keyframe_iterator::difference_type,
+                                  const_keyframe_iterator) noexcept;
+const_keyframe_iterator
+operator-(const_keyframe_iterator,
+          const_keyframe_iterator::difference_type) noexcept;
+const_keyframe_iterator::difference_type
+operator-(const const_keyframe_iterator &,
+          const const_keyframe_iterator &) noexcept;
+
+bool operator==(const const_keyframe_iterator &,
+                const const_keyframe_iterator &) noexcept;
+bool operator!=(const const_keyframe_iterator &,
+                const const_keyframe_iterator &) noexcept;
+bool operator<(const const_keyframe_iterator &,
+               const const_keyframe_iterator &) noexcept;
+bool operator>(const const_keyframe_iterator &,
+               const const_keyframe_iterator &) noexcept;
+bool operator<=(const const_keyframe_iterator &,
+                const const_keyframe_iterator &) noexcept;
+bool operator>=(const const_keyframe_iterator &,
+                const const_keyframe_iterator &) noexcept;
+
 class KeyframeRange {
 public:
   using value_type = Frame;
   using iterator = keyframe_iterator;
-  using base_iterator = typename std::map<double, Frame>::iterator;
 
 private:
-  base_iterator begin_it;
-  base_iterator end_it;
-  const Motion &motion;
+  Motion &motion;
 
 public:
   KeyframeRange() = delete;
-  KeyframeRange(base_iterator begin_, base_iterator end_, const Motion &motion_)
-      : begin_it(begin_), end_it(end_), motion(motion_) {}
+  explicit KeyframeRange(Motion &motion_) : motion(motion_) {}
   KeyframeRange(const KeyframeRange &) = default;
   KeyframeRange(KeyframeRange &&) = default;
   KeyframeRange &operator=(const KeyframeRange &) = default;
   KeyframeRange &operator=(KeyframeRange &&) = default;
 
-  iterator begin() noexcept { return iterator{this->begin_it, this->motion}; }
-  iterator end() noexcept { return iterator{this->end_it, this->motion}; }
+  iterator begin() noexcept { return {this->motion, 0}; }
+  iterator end() noexcept { return {this->motion, this->size()}; }
+
+  std::size_t size() const noexcept;
 };
 
 class ConstKeyframeRange {
 public:
   using value_type = Frame;
-  using const_iterator = typename std::map<double, Frame>::const_iterator;
+  using const_iterator = const_keyframe_iterator;
 
 private:
-  const_iterator begin_;
-  const_iterator end_;
+  const KeyframeStore &store;
 
 public:
   ConstKeyframeRange() = delete;
-  ConstKeyframeRange(const_iterator begin, const_iterator end)
-      : begin_(begin), end_(end) {}
+  explicit ConstKeyframeRange(const KeyframeStore &store_) : store(store_) {}
   ConstKeyframeRange(const ConstKeyframeRange &) = default;
   ConstKeyframeRange(ConstKeyframeRange &&) = default;
   ConstKeyframeRange &operator=(const ConstKeyframeRange &) = default;
   ConstKeyframeRange &operator=(ConstKeyframeRange &&) = default;
 
-  const_iterator begin() const noexcept { return this->begin_; }
-  const_iterator end() const noexcept { return this->end_; }
+  const_iterator begin() const noexcept { return {this->store, 0}; }
+  const_iterator end() const noexcept {
+    return {this->store, this->store.size()};
+  }
+
+  const_iterator cbegin() const noexcept { return this->begin(); }
+  const_iterator cend() const noexcept { return this->end(); }
 
-  const_iterator cbegin() const noexcept { return this->begin_; }
-  const_iterator cend() const noexcept { return this->end_; }
+  std::size_t size() const noexcept { return this->store.size(); }
 };
 } // namespace flom
 
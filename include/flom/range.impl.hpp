@@ -20,6 +20,8 @@
 #ifndef FLOM_RANGE_IMPL_HPP
 #define FLOM_RANGE_IMPL_HPP
 
+#include "flom/motion_cursor.hpp"
+
 namespace flom {
 
 class frame_iterator::Impl {
@@ -27,8 +29,11 @@ public:
   const Motion *motion;
   double fps;
   long t_index = 0;
+  // Dereferencing is const, but advances the cursor
+  mutable MotionCursor cursor;
 
-  Impl(const Motion &motion_, double fps_) : motion(&motion_), fps(fps_) {}
+  Impl(const Motion &motion_, double fps_)
+      : motion(&motion_), fps(fps_), cursor(motion_) {}
 
   double current_time() const noexcept;
   bool check_is_end() const noexcept;
@@ -0,0 +1,85 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_SAMPLE_BUFFER_HPP
+#define FLOM_SAMPLE_BUFFER_HPP
+
+#include "flom/compat/span.hpp"
+#include "flom/effector_type.hpp"
+#include "flom/frame.hpp"
+#include "flom/frame_schema.hpp"
+#include "flom/keyframe_store.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace flom {
+
+// Dense, row-major result of Motion::sample
+//   positions: [samples x joints]
+//   locations: [samples x effectors x 3] (x, y, z)
+//   rotations: [samples x effectors x 4] (w, x, y, z)
+// Joints and effectors are ordered as in schema().
+// Components an effector doesn't have are filled with zero location and
+// identity rotation.
+class SampleBuffer {
+private:
+  std::shared_ptr<const FrameSchema> schema_;
+  std::vector<EffectorType> types_;
+  std::size_t size_;
+  std::size_t num_joints_;
+  std::size_t num_effectors_;
+
+  std::vector<double> positions_;
+  std::vector<double> locations_;
+  std::vector<double> rotations_;
+
+public:
+  SampleBuffer();
+
+  // Lays out the buffer for n samples, reusing allocated storage
+  void reshape(const std::shared_ptr<const FrameSchema> &,
+               const std::vector<EffectorType> &, std::size_t n);
+
+  const std::shared_ptr<const FrameSchema> &schema() const noexcept;
+  const std::vector<EffectorType> &types() const noexcept;
+
+  std::size_t size() const noexcept;
+  bool empty() const noexcept;
+  std::size_t num_joints() const noexcept;
+  std::size_t num_effectors() const noexcept;
+
+  compat::span<const double> positions() const noexcept;
+  compat::span<const double> locations() const noexcept;
+  compat::span<const double> rotations() const noexcept;
+
+  // Pointers to rows of each matrix
+  const double *positions_at(std::size_t) const noexcept;
+  const double *locations_at(std::size_t) const noexcept;
+  const double *rotations_at(std::size_t) const noexcept;
+
+  FrameRow row(std::size_t) noexcept;
+
+  Frame frame(std::size_t) const;
+};
+
+} // namespace flom
+
+#endif
@@ -0,0 +1,56 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef FLOM_THREAD_POOL_HPP
+#define FLOM_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace flom {
+
+// Fixed set of threads running indexed jobs, such as chunks of frames.
+// The calling thread takes part in each job, so a pool of size 1
+// runs everything on the caller.
+class ThreadPool {
+private:
+  class Impl;
+  std::unique_ptr<Impl> impl;
+
+public:
+  // With 0, one thread for each hardware thread
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of threads including the caller
+  std::size_t size() const noexcept;
+
+  // Calls f(0), ..., f(n - 1) in parallel and waits for them.
+  // After an exception, remaining calls are skipped and the first one
+  // is rethrown. f must not call run on the same pool.
+  void run(std::size_t n, const std::function<void(std::size_t)> &f);
+};
+
+} // namespace flom
+
+#endif
@@ -117,15 +117,13 @@ Rotation &Rotation::operator-=(const Rotation &other) {
 }
 
 Rotation &Rotation::operator*=(std::size_t n) {
-  if (n == 0) {
-    this->set_quaternion(
-        Eigen::QuaternionBase<Rotation::value_type>::Identity());
-  } else {
-    auto const quat = this->quat_;
-    for (std::size_t i = 0; i < n - 1; i++) {
-      this->set_quaternion(this->quat_ * quat);
-    }
-  }
+  // q = (cos a, sin a * axis), so q^n = (cos na, sin na * axis)
+  auto const &q = this->quat_;
+  auto const norm = q.vec().norm();
+  auto const angle = std::atan2(norm, q.w()) * static_cast<double>(n);
+  auto const s = norm == 0 ? 0 : std::sin(angle) / norm;
+  this->set_quaternion(
+      Rotation::value_type{std::cos(angle), s * q.x(), s * q.y(), s * q.z()});
   return *this;
 }
 
@@ -55,6 +55,17 @@ const char *ParseError::what() const noexcept {
   return "Could not parse input";
 }
 
+FileError::FileError(const std::string &path, int error)
+    : path_(path), error_(error) {}
+
+const char *FileError::what() const noexcept {
+  return "Could not read file";
+}
+
+std::string FileError::path() const noexcept { return this->path_; }
+
+int FileError::error_code() const noexcept { return this->error_; }
+
 SerializationError::SerializationError() {}
 
 const char *SerializationError::what() const noexcept {
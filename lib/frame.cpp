@@ -20,53 +20,127 @@
 #include "flom/frame.hpp"
 #include "flom/interpolation.hpp"
 
-#include <boost/range/adaptors.hpp>
-
 #include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <utility>
 
 namespace flom {
 
+namespace {
+
+template <typename T>
+std::unordered_map<std::string, T> to_map(const NameTable &names,
+                                          const std::vector<T> &values) {
+  return NamedRange<T>{names, values.data()}.to_map();
+}
+
+template <typename T>
+std::vector<std::string> keys_of(const std::unordered_map<std::string, T> &m) {
+  std::vector<std::string> keys;
+  keys.reserve(m.size());
+  for (auto const &[k, v] : m) {
+    keys.push_back(k);
+  }
+  return keys;
+}
+
+// Splits a map into names and values in the same order, moving them out
+template <typename T>
+std::pair<std::vector<std::string>, std::vector<T>>
+split(std::unordered_map<std::string, T> &&m) {
+  std::vector<std::string> keys;
+  std::vector<T> values;
+  keys.reserve(m.size());
+  values.reserve(m.size());
+  while (!m.empty()) {
+    auto node = m.extract(std::begin(m));
+    keys.push_back(std::move(node.key()));
+    values.push_back(std::move(node.mapped()));
+  }
+  return {std::move(keys), std::move(values)};
+}
+
+template <typename T>
+bool has_same_names(const NameTable &names,
+                    const std::unordered_map<std::string, T> &m) {
+  return m.size() == names.size() &&
+         std::all_of(std::cbegin(m), std::cend(m), [&names](auto const &p) {
+           return static_cast<bool>(names.find(p.first));
+         });
+}
+
+// Writes values of a map with the same names as the table in place
+template <typename T>
+void assign_values(const NameTable &names,
+                   const std::unordered_map<std::string, T> &m,
+                   std::vector<T> &values) {
+  for (auto const &[name, v] : m) {
+    values[names.index(name)] = v;
+  }
+}
+
+template <typename T>
+std::vector<T> values_in(const NameTable &names,
+                         const std::unordered_map<std::string, T> &m) {
+  std::vector<T> values;
+  values.reserve(names.size());
+  for (auto const &name : names.names()) {
+    values.push_back(m.at(name));
+  }
+  return values;
+}
+
+} // namespace
+
 FrameDifference operator-(const Frame &f1, const Frame &f2) {
   return FrameDifference{f1, f2};
 }
 
-FrameDifference::FrameDifference(const Frame &f1, const Frame &f2) {
+FrameDifference::FrameDifference(const Frame &f1, const Frame &f2)
+    : schema_(f1.schema()) {
   // Not throwing exception in favor of better performance
   assert(f1.is_compatible(f2) &&
          "Cannot perform the operation on Incompatible frames");
 
-  for (auto const &[k, e] : f1.effectors()) {
-    auto const o = f2.effectors().at(k);
-    this->effectors_.emplace(k, e - o);
-  }
-  for (auto const &[k, p] : f1.positions()) {
-    auto const o = f2.positions().at(k);
-    this->positions_.emplace(k, p - o);
-  }
+  auto const &s1 = *f1.schema();
+  auto const &s2 = *f2.schema();
+
+  this->effectors_.reserve(s1.effectors().size());
+  for_each_matched(s1.effectors(), s2.effectors(), [&](auto i, auto j) {
+    this->effectors_.push_back(f1.effector_data()[i] - f2.effector_data()[j]);
+  });
+  this->positions_.resize(s1.joints().size());
+  for_each_matched(s1.joints(), s2.joints(), [&](auto i, auto j) {
+    this->positions_[i] = f1.position_data()[i] - f2.position_data()[j];
+  });
 }
 
-const std::unordered_map<std::string, double> &
-FrameDifference::positions() const & {
-  return this->positions_;
+const std::shared_ptr<const FrameSchema> &FrameDifference::schema() const
+    noexcept {
+  return this->schema_;
+}
+
+NamedRange<double> FrameDifference::positions() const & {
+  return {this->schema_->joints(), this->positions_.data()};
 }
 std::unordered_map<std::string, double> FrameDifference::positions() && {
-  return std::move(this->positions_);
+  return to_map(this->schema_->joints(), this->positions_);
 }
 
-const std::unordered_map<std::string, EffectorDifference> &
-FrameDifference::effectors() const & {
-  return this->effectors_;
+NamedRange<EffectorDifference> FrameDifference::effectors() const & {
+  return {this->schema_->effectors(), this->effectors_.data()};
 }
 std::unordered_map<std::string, EffectorDifference>
 FrameDifference::effectors() && {
-  return std::move(this->effectors_);
+  return to_map(this->schema_->effectors(), this->effectors_);
 }
 
 FrameDifference &FrameDifference::operator*=(std::size_t n) {
-  for (auto &&[k, p] : this->positions_) {
+  for (auto &&p : this->positions_) {
     p *= n;
   }
-  for (auto &&[k, e] : this->effectors_) {
+  for (auto &&e : this->effectors_) {
     e *= n;
   }
   return *this;
@@ -77,14 +151,14 @@ FrameDifference &FrameDifference::operator+=(const FrameDifference &other) {
   assert(this->is_compatible(other) &&
          "Cannot use an incompatible FrameDifference instance");
 
-  for (auto &&[k, p] : this->positions_) {
-    auto const o = other.positions_.at(k);
-    p += o;
-  }
-  for (auto &&[k, e] : this->effectors_) {
-    auto const o = other.effectors_.at(k);
-    e += o;
-  }
+  for_each_matched(this->schema_->joints(), other.schema_->joints(),
+                   [&](auto i, auto j) {
+                     this->positions_[i] += other.positions_[j];
+                   });
+  for_each_matched(this->schema_->effectors(), other.schema_->effectors(),
+                   [&](auto i, auto j) {
+                     this->effectors_[i] += other.effectors_[j];
+                   });
   return *this;
 }
 
@@ -93,14 +167,13 @@ Frame &Frame::operator+=(const FrameDifference &other) {
   assert(this->is_compatible(other) &&
          "Cannot use an incompatible FrameDifference instance");
 
-  for (auto &&[k, p] : this->positions_) {
-    auto const o = other.positions().at(k);
-    p += o;
-  }
-  for (auto &&[k, e] : this->effectors_) {
-    auto const o = other.effectors().at(k);
-    e += o;
-  }
+  auto const &o = *other.schema();
+  auto const op = other.positions().data();
+  auto const oe = other.effectors().data();
+  for_each_matched(this->schema_->joints(), o.joints(),
+                   [&](auto i, auto j) { this->positions_[i] += op[j]; });
+  for_each_matched(this->schema_->effectors(), o.effectors(),
+                   [&](auto i, auto j) { this->effectors_[i] += oe[j]; });
   return *this;
 }
 
@@ -109,59 +182,69 @@ Frame interpolate(double t, Frame const &a, Frame const &b) {
   assert(a.is_compatible(b) &&
          "Cannot perform the operation on Incompatible frames");
 
-  Frame f;
-  for (auto const &[k, v1] : a.positions()) {
-    auto const v2 = b.positions().at(k);
-    f.set_position(k, lerp(t, v1, v2));
-  }
-  for (auto const &[k, v1] : a.effectors()) {
-    auto const v2 = b.effectors().at(k);
-    f.set_effector(k, interpolate(t, v1, v2));
+  auto const &sa = *a.schema();
+  auto const &sb = *b.schema();
+
+  Frame f{a.schema()};
+  auto const pa = a.position_data();
+  auto const pb = b.position_data();
+  auto const pf = f.position_data();
+  if (a.schema() == b.schema()) {
+    lerp_n(t, pa, pb, pf, sa.joints().size());
+  } else {
+    for_each_matched(sa.joints(), sb.joints(), [&](auto i, auto j) {
+      pf[i] = lerp(t, pa[i], pb[j]);
+    });
   }
+  auto const ea = a.effector_data();
+  auto const eb = b.effector_data();
+  auto const ef = f.effector_data();
+  for_each_matched(sa.effectors(), sb.effectors(), [&](auto i, auto j) {
+    ef[i] = interpolate(t, ea[i], eb[j]);
+  });
   return f;
 }
 
 Frame Frame::new_compatible_frame() const {
-  Frame copy{*this};
-  for (auto &&[k, v] : copy.positions_) {
-    v = 0.0;
-  }
-  for (auto &&[k, v] : copy.effectors_) {
-    Effector e{v.new_compatible_effector()};
-    v = e;
+  Frame copy{this->schema_};
+  for (std::size_t i = 0; i < this->effectors_.size(); i++) {
+    copy.effectors_[i] = this->effectors_[i].new_compatible_effector();
   }
   return copy;
 }
 
 bool FrameDifference::is_compatible(const FrameDifference &other) const {
-  for (auto const &[k, v] : this->effectors()) {
-    auto const &o = other.effectors().at(k);
-    if (!v.is_compatible(o)) {
-      return false;
-    }
-  }
-
-  return true;
+  auto const &o = *other.schema();
+  auto const oe = other.effectors().data();
+  bool compatible = true;
+  for_each_matched(this->schema_->effectors(), o.effectors(),
+                   [&](auto i, auto j) {
+                     compatible = compatible &&
+                                  this->effectors_[i].is_compatible(oe[j]);
+                   });
+  return compatible;
 }
 bool Frame::is_compatible(const FrameDifference &other) const {
-  for (auto const &[k, v] : this->effectors()) {
-    auto const &o = other.effectors().at(k);
-    if (!v.is_compatible(o)) {
-      return false;
-    }
-  }
-
-  return true;
+  auto const &o = *other.schema();
+  auto const oe = other.effectors().data();
+  bool compatible = true;
+  for_each_matched(this->schema_->effectors(), o.effectors(),
+                   [&](auto i, auto j) {
+                     compatible = compatible &&
+                                  this->effectors_[i].is_compatible(oe[j]);
+                   });
+  return compatible;
 }
 bool Frame::is_compatible(const Frame &other) const {
-  for (auto const &[k, v] : this->effectors()) {
-    auto const &o = other.effectors().at(k);
-    if (!v.is_compatible(o)) {
-      return false;
-    }
-  }
-
-  return true;
+  auto const &o = *other.schema();
+  bool compatible = true;
+  for_each_matched(this->schema_->effectors(), o.effectors(),
+                   [&](auto i, auto j) {
+                     compatible =
+                         compatible &&
+                         this->effectors_[i].is_compatible(other.effectors_[j]);
+                   });
+  return compatible;
 }
 
 bool operator==(const FrameDifference &d1, const FrameDifference &d2) {
@@ -174,47 +257,165 @@ bool operator==(const Frame &f1, const Frame &f2) {
 
 bool operator!=(const Frame &f1, const Frame &f2) { return !(f1 == f2); }
 
-Frame::Frame() = default;
+Frame::Frame() : schema_(FrameSchema::empty()) {}
+
 Frame::Frame(const Frame::PositionsMap &positions,
-             const Frame::EffectorsMap &effectors)
-    : positions_(positions), effectors_(effectors) {}
+             const Frame::EffectorsMap &effectors) {
+  this->set_schema(NameTable{keys_of(positions)},
+                   NameTable{keys_of(effectors)});
+  this->positions_ = values_in(this->schema_->joints(), positions);
+  this->effectors_ = values_in(this->schema_->effectors(), effectors);
+}
 
-const Frame::PositionsMap &Frame::positions() const & {
-  return this->positions_;
+Frame::Frame(Frame::PositionsMap &&positions, Frame::EffectorsMap &&effectors)
+    : schema_(FrameSchema::empty()) {
+  auto [joint_names, positions_in] = split(std::move(positions));
+  auto [effector_names, effectors_in] = split(std::move(effectors));
+  this->set_schema(NameTable{std::move(joint_names)},
+                   NameTable{std::move(effector_names)});
+  this->positions_ = std::move(positions_in);
+  this->effectors_ = std::move(effectors_in);
+}
+
+Frame::Frame(std::shared_ptr<const FrameSchema> schema)
+    : schema_(std::move(schema)), positions_(this->schema_->joints().size()),
+      effectors_(this->schema_->effectors().size()) {}
+
+const std::shared_ptr<const FrameSchema> &Frame::schema() const noexcept {
+  return this->schema_;
+}
+
+void Frame::set_schema(NameTable joints, NameTable effectors) {
+  this->schema_ =
+      std::make_shared<FrameSchema>(std::move(joints), std::move(effectors));
+  this->owns_schema_ = true;
+}
+
+FrameSchema &Frame::mutable_schema() {
+  if (this->owns_schema_ && this->schema_.use_count() == 1) {
+    // Pairs with the release by the last other owner, if any,
+    // as use_count() is a relaxed load
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return const_cast<FrameSchema &>(*this->schema_);
+  }
+
+  auto schema = std::make_shared<FrameSchema>(*this->schema_);
+  auto &s = *schema;
+  this->schema_ = std::move(schema);
+  this->owns_schema_ = true;
+  return s;
+}
+
+Frame Frame::rebind(const std::shared_ptr<const FrameSchema> &schema) const {
+  if (schema == this->schema_) {
+    return *this;
+  }
+
+  Frame f{schema};
+  for_each_matched(this->schema_->joints(), schema->joints(),
+                   [&](auto i, auto j) { f.positions_[j] = this->positions_[i]; });
+  for_each_matched(this->schema_->effectors(), schema->effectors(),
+                   [&](auto i, auto j) { f.effectors_[j] = this->effectors_[i]; });
+  return f;
+}
+
+NamedRange<double> Frame::positions() const & {
+  return {this->schema_->joints(), this->positions_.data()};
 }
 Frame::PositionsMap Frame::positions() && {
-  return std::move(this->positions_);
+  return to_map(this->schema_->joints(), this->positions_);
 }
 
 void Frame::set_positions(const Frame::PositionsMap &positions) {
-  this->positions_ = positions;
+  auto const &joints = this->schema_->joints();
+  if (has_same_names(joints, positions)) {
+    assign_values(joints, positions, this->positions_);
+    return;
+  }
+
+  this->set_schema(NameTable{keys_of(positions)}, this->schema_->effectors());
+  this->positions_ = values_in(this->schema_->joints(), positions);
+}
+
+void Frame::set_positions(Frame::PositionsMap &&positions) {
+  auto const &joints = this->schema_->joints();
+  if (has_same_names(joints, positions)) {
+    assign_values(joints, positions, this->positions_);
+    return;
+  }
+
+  auto [names, values] = split(std::move(positions));
+  this->set_schema(NameTable{std::move(names)}, this->schema_->effectors());
+  this->positions_ = std::move(values);
 }
 
 void Frame::set_position(const std::string &name, double v) {
-  this->positions_[name] = v;
+  if (auto const i = this->schema_->joints().find(name)) {
+    this->positions_[*i] = v;
+    return;
+  }
+
+  this->mutable_schema().mutable_joints().add(name);
+  this->positions_.push_back(v);
 }
 
-const Frame::EffectorsMap &Frame::effectors() const & {
-  return this->effectors_;
+NamedRange<Effector> Frame::effectors() const & {
+  return {this->schema_->effectors(), this->effectors_.data()};
 }
 Frame::EffectorsMap Frame::effectors() && {
-  return std::move(this->effectors_);
+  return to_map(this->schema_->effectors(), this->effectors_);
 }
 
 void Frame::set_effectors(const Frame::EffectorsMap &effectors) {
-  this->effectors_ = effectors;
+  auto const &names = this->schema_->effectors();
+  if (has_same_names(names, effectors)) {
+    assign_values(names, effectors, this->effectors_);
+    return;
+  }
+
+  this->set_schema(this->schema_->joints(), NameTable{keys_of(effectors)});
+  this->effectors_ = values_in(this->schema_->effectors(), effectors);
+}
+
+void Frame::set_effectors(Frame::EffectorsMap &&effectors) {
+  auto const &names = this->schema_->effectors();
+  if (has_same_names(names, effectors)) {
+    assign_values(names, effectors, this->effectors_);
+    return;
+  }
+
+  auto [effector_names, values] = split(std::move(effectors));
+  this->set_schema(this->schema_->joints(),
+                   NameTable{std::move(effector_names)});
+  this->effectors_ = std::move(values);
 }
 
 void Frame::set_effector(const std::string &name, const Effector &v) {
-  this->effectors_[name] = v;
+  if (auto const i = this->schema_->effectors().find(name)) {
+    this->effectors_[*i] = v;
+    return;
+  }
+
+  this->mutable_schema().mutable_effectors().add(name);
+  this->effectors_.push_back(v);
+}
+
+const double *Frame::position_data() const noexcept {
+  return this->positions_.data();
+}
+double *Frame::position_data() noexcept { return this->positions_.data(); }
+
+const Effector *Frame::effector_data() const noexcept {
+  return this->effectors_.data();
 }
+Effector *Frame::effector_data() noexcept { return this->effectors_.data(); }
 
 KeyRange<std::string> Frame::joint_names() const {
-  return this->positions_ | boost::adaptors::map_keys;
+  return this->schema_->joints().names();
 }
 
 KeyRange<std::string> Frame::effector_names() const {
-  return this->effectors_ | boost::adaptors::map_keys;
+  return this->schema_->effectors().names();
 }
 
 } // namespace flom
@@ -34,7 +34,7 @@ frame_iterator::~frame_iterator() = default;
 
 frame_iterator::value_type frame_iterator::operator*() const {
   auto const t = this->current_time();
-  return std::make_pair(t, this->impl->motion->frame_at(t));
+  return std::make_pair(t, this->impl->cursor.frame_at(t));
 }
 
 frame_iterator &frame_iterator::operator++() noexcept {
@@ -0,0 +1,104 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/frame_schema.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+namespace flom {
+
+NameTable::NameTable() = default;
+
+NameTable::NameTable(std::vector<std::string> names)
+    : names_(std::move(names)) {
+  this->indices_.reserve(this->names_.size());
+  for (std::size_t i = 0; i < this->names_.size(); i++) {
+    this->indices_.emplace(this->names_[i], i);
+  }
+}
+
+std::size_t NameTable::size() const noexcept { return this->names_.size(); }
+bool NameTable::empty() const noexcept { return this->names_.empty(); }
+
+const std::vector<std::string> &NameTable::names() const noexcept {
+  return this->names_;
+}
+
+const std::string &NameTable::name(std::size_t i) const {
+  return this->names_.at(i);
+}
+
+compat::optional<std::size_t> NameTable::find(const std::string &name) const {
+  auto const it = this->indices_.find(name);
+  if (it == this->indices_.end()) {
+    return compat::nullopt;
+  }
+  return it->second;
+}
+
+std::size_t NameTable::index(const std::string &name) const {
+  return this->indices_.at(name);
+}
+
+NameTable NameTable::with(const std::string &name) const {
+  auto names = this->names_;
+  names.push_back(name);
+  return NameTable{std::move(names)};
+}
+
+void NameTable::add(const std::string &name) {
+  this->indices_.emplace(name, this->names_.size());
+  this->names_.push_back(name);
+}
+
+bool operator==(const NameTable &a, const NameTable &b) {
+  return a.names() == b.names();
+}
+
+bool operator!=(const NameTable &a, const NameTable &b) { return !(a == b); }
+
+FrameSchema::FrameSchema(NameTable joints, NameTable effectors)
+    : joints_(std::move(joints)), effectors_(std::move(effectors)) {}
+
+const NameTable &FrameSchema::joints() const noexcept { return this->joints_; }
+const NameTable &FrameSchema::effectors() const noexcept {
+  return this->effectors_;
+}
+
+NameTable &FrameSchema::mutable_joints() noexcept { return this->joints_; }
+NameTable &FrameSchema::mutable_effectors() noexcept {
+  return this->effectors_;
+}
+
+const std::shared_ptr<const FrameSchema> &FrameSchema::empty() {
+  static const auto schema =
+      std::make_shared<const FrameSchema>(NameTable{}, NameTable{});
+  return schema;
+}
+
+bool operator==(const FrameSchema &a, const FrameSchema &b) {
+  return a.joints() == b.joints() && a.effectors() == b.effectors();
+}
+
+bool operator!=(const FrameSchema &a, const FrameSchema &b) {
+  return !(a == b);
+}
+
+} // namespace flom
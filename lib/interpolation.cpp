@@ -0,0 +1,245 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/interpolation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define FLOM_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace flom {
+
+namespace {
+
+using lerp_n_function = void (*)(double, const double *, const double *,
+                                 double *, std::size_t);
+
+void lerp_n_scalar(double t, const double *a, const double *b, double *out,
+                   std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    out[i] = lerp(t, a[i], b[i]);
+  }
+}
+
+#ifdef FLOM_X86_DISPATCH
+// These compute a + t * (b - a) in the same order as lerp(),
+// so results are identical to the scalar version.
+
+__attribute__((target("sse2"))) void
+lerp_n_sse2(double t, const double *a, const double *b, double *out,
+            std::size_t n) {
+  auto const vt = _mm_set1_pd(t);
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    auto const va = _mm_loadu_pd(a + i);
+    auto const vb = _mm_loadu_pd(b + i);
+    _mm_storeu_pd(out + i, _mm_add_pd(va, _mm_mul_pd(vt, _mm_sub_pd(vb, va))));
+  }
+  lerp_n_scalar(t, a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+lerp_n_avx2(double t, const double *a, const double *b, double *out,
+            std::size_t n) {
+  auto const vt = _mm256_set1_pd(t);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto const va = _mm256_loadu_pd(a + i);
+    auto const vb = _mm256_loadu_pd(b + i);
+    _mm256_storeu_pd(out + i, _mm256_add_pd(
+                                  va, _mm256_mul_pd(vt, _mm256_sub_pd(vb, va))));
+  }
+  lerp_n_scalar(t, a + i, b + i, out + i, n - i);
+}
+#endif
+
+lerp_n_function select_lerp_n() {
+#ifdef FLOM_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return lerp_n_avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return lerp_n_sse2;
+  }
+#endif
+  return lerp_n_scalar;
+}
+
+} // namespace
+
+void lerp_n(double t, const double *a, const double *b, double *out,
+            std::size_t n) {
+  static const auto impl = select_lerp_n();
+  impl(t, a, b, out, n);
+}
+
+namespace {
+
+// sin(x) for x in [0, pi/2], by the Taylor series up to x^21.
+// Truncation error is below 2e-18 in the domain.
+// Unlike std::sin, this is a plain polynomial the compiler can vectorize.
+inline double sin_half_pi(double x) {
+  auto const x2 = x * x;
+  auto p = 1 / 51090942171709440000.0;
+  p = p * x2 - 1 / 121645100408832000.0;
+  p = p * x2 + 1 / 355687428096000.0;
+  p = p * x2 - 1 / 1307674368000.0;
+  p = p * x2 + 1 / 6227020800.0;
+  p = p * x2 - 1 / 39916800.0;
+  p = p * x2 + 1 / 362880.0;
+  p = p * x2 - 1 / 5040.0;
+  p = p * x2 + 1 / 120.0;
+  p = p * x2 - 1 / 6.0;
+  p = p * x2 + 1;
+  return x * p;
+}
+
+constexpr std::size_t slerp_chunk_size = 16;
+
+// Same steps as Eigen's QuaternionBase::slerp followed by normalization in
+// Rotation, split into loops over lanes. Only acos is evaluated lane by lane.
+template <typename Ratio>
+inline __attribute__((always_inline)) void
+slerp_n_body(Ratio ratio, QuaternionArrays<const double> a,
+             QuaternionArrays<const double> b, QuaternionArrays<double> out,
+             std::size_t n) {
+  constexpr double one = 1 - std::numeric_limits<double>::epsilon();
+
+  double d[slerp_chunk_size];
+  double theta[slerp_chunk_size];
+  for (std::size_t offset = 0; offset < n; offset += slerp_chunk_size) {
+    auto const m = std::min(slerp_chunk_size, n - offset);
+    auto const qa = a + offset;
+    auto const qb = b + offset;
+    auto const qo = out + offset;
+
+    for (std::size_t i = 0; i < m; i++) {
+      d[i] = qa.x[i] * qb.x[i] + qa.y[i] * qb.y[i] + qa.z[i] * qb.z[i] +
+             qa.w[i] * qb.w[i];
+    }
+    for (std::size_t i = 0; i < m; i++) {
+      auto const abs_d = std::abs(d[i]);
+      theta[i] = abs_d < one ? std::acos(abs_d) : 0;
+    }
+    for (std::size_t i = 0; i < m; i++) {
+      auto const t = ratio(offset + i);
+      // Nearly identical quaternions are blended linearly
+      auto const linear = std::abs(d[i]) >= one;
+      auto const sin_theta = sin_half_pi(theta[i]);
+      auto const scale0 =
+          linear ? 1 - t : sin_half_pi((1 - t) * theta[i]) / sin_theta;
+      auto scale1 = linear ? t : sin_half_pi(t * theta[i]) / sin_theta;
+      // Take the shorter arc
+      scale1 = d[i] < 0 ? -scale1 : scale1;
+
+      auto const w = scale0 * qa.w[i] + scale1 * qb.w[i];
+      auto const x = scale0 * qa.x[i] + scale1 * qb.x[i];
+      auto const y = scale0 * qa.y[i] + scale1 * qb.y[i];
+      auto const z = scale0 * qa.z[i] + scale1 * qb.z[i];
+      auto const inv_norm = 1 / std::sqrt(x * x + y * y + z * z + w * w);
+
+      // Keep a on NaN, as interpolate(double, Rotation, Rotation) does
+      auto const valid = w == w;
+      qo.w[i] = valid ? w * inv_norm : qa.w[i];
+      qo.x[i] = valid ? x * inv_norm : qa.x[i];
+      qo.y[i] = valid ? y * inv_norm : qa.y[i];
+      qo.z[i] = valid ? z * inv_norm : qa.z[i];
+    }
+  }
+}
+
+struct UniformRatio {
+  double t;
+  double operator()(std::size_t) const noexcept { return this->t; }
+};
+
+struct VaryingRatio {
+  const double *t;
+  double operator()(std::size_t i) const noexcept { return this->t[i]; }
+};
+
+template <typename Ratio>
+using slerp_n_function = void (*)(Ratio, QuaternionArrays<const double>,
+                                  QuaternionArrays<const double>,
+                                  QuaternionArrays<double>, std::size_t);
+
+template <typename Ratio>
+void slerp_n_default(Ratio ratio, QuaternionArrays<const double> a,
+                     QuaternionArrays<const double> b,
+                     QuaternionArrays<double> out, std::size_t n) {
+  slerp_n_body(ratio, a, b, out, n);
+}
+
+#ifdef FLOM_X86_DISPATCH
+template <typename Ratio>
+__attribute__((target("avx2"))) void
+slerp_n_avx2(Ratio ratio, QuaternionArrays<const double> a,
+             QuaternionArrays<const double> b, QuaternionArrays<double> out,
+             std::size_t n) {
+  slerp_n_body(ratio, a, b, out, n);
+}
+#endif
+
+template <typename Ratio> slerp_n_function<Ratio> select_slerp_n() {
+#ifdef FLOM_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return slerp_n_avx2<Ratio>;
+  }
+#endif
+  return slerp_n_default<Ratio>;
+}
+
+} // namespace
+
+void slerp_n(double t, QuaternionArrays<const double> a,
+             QuaternionArrays<const double> b, QuaternionArrays<double> out,
+             std::size_t n) {
+  static const auto impl = select_slerp_n<UniformRatio>();
+  impl(UniformRatio{t}, a, b, out, n);
+}
+
+void slerp_n(const double *t, QuaternionArrays<const double> a,
+             QuaternionArrays<const double> b, QuaternionArrays<double> out,
+             std::size_t n) {
+  static const auto impl = select_slerp_n<VaryingRatio>();
+  impl(VaryingRatio{t}, a, b, out, n);
+}
+
+double rotation_angle(const std::array<double, 4> &a,
+                      const std::array<double, 4> &b) noexcept {
+  // q and -q are the same rotation
+  auto const dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+  auto const sign = dot < 0 ? -1.0 : 1.0;
+  double chord = 0;
+  for (std::size_t i = 0; i < 4; i++) {
+    chord += (a[i] - sign * b[i]) * (a[i] - sign * b[i]);
+  }
+  // The chord is 2 sin(angle / 4), which keeps precision for small angles
+  return 4 * std::asin(std::min(std::sqrt(chord) / 2, 1.0));
+}
+
+} // namespace flom
@@ -1,26 +1,45 @@
 #include "flom/range.hpp"
+#include "flom/motion.impl.hpp"
 #include "flom/range.impl.hpp"
 
 namespace flom {
 
-const keyframe_iterator::value_type &keyframe_iterator::operator*() const {
-  return *this->it;
+CheckedFrameRef &CheckedFrameRef::operator=(const Frame &frame) & {
+  if (!this->motion->is_valid_frame(frame)) {
+    throw errors::InvalidFrameError{"in CheckedFrameWrapper"};
+  }
+  auto &keyframes = this->motion->mutable_impl().mutable_keyframes();
+  auto const &schema = keyframes.schema();
+  if (frame.schema() == schema) {
+    keyframes.write(this->index, frame);
+  } else {
+    keyframes.write(this->index, frame.rebind(schema));
+  }
+  return *this;
+}
+
+CheckedFrameRef::operator Frame() const {
+  return this->motion->impl->keyframes().frame(this->index);
+}
+
+keyframe_iterator::value_type keyframe_iterator::operator*() const {
+  auto const &keyframes = this->motion->impl->keyframes();
+  return {keyframes.time(this->index), keyframes.frame(this->index)};
 }
 keyframe_iterator::checked_value_type keyframe_iterator::operator*() {
-  return std::make_pair(this->it->first,
-                        CheckedFrameRef{this->it->second, this->motion});
+  return {this->motion->impl->keyframes().time(this->index),
+          CheckedFrameRef{*this->motion, this->index}};
 }
 
-const keyframe_iterator::value_type &keyframe_iterator::operator->() const {
-  return *this->it;
+keyframe_iterator::value_type keyframe_iterator::operator->() const {
+  return **this;
 }
 keyframe_iterator::checked_value_type keyframe_iterator::operator->() {
-  return std::make_pair(this->it->first,
-                        CheckedFrameRef{this->it->second, this->motion});
+  return **this;
 }
 
 keyframe_iterator &keyframe_iterator::operator++() noexcept {
-  this->it++;
+  this->index++;
   return *this;
 }
 keyframe_iterator keyframe_iterator::operator++(int) noexcept {
@@ -30,7 +49,7 @@ keyframe_iterator keyframe_iterator::operator++(int) noexcept {
 }
 
 keyframe_iterator &keyframe_iterator::operator--() noexcept {
-  this->it--;
+  this->index--;
   return *this;
 }
 keyframe_iterator keyframe_iterator::operator--(int) noexcept {
@@ -41,7 +60,7 @@ keyframe_iterator keyframe_iterator::operator--(int) noexcept {
 
 bool operator==(const keyframe_iterator &l,
                 const keyframe_iterator &r) noexcept {
-  return l.it == r.it;
+  return l.motion == r.motion && l.index == r.index;
 }
 
 bool operator!=(const keyframe_iterator &l,
@@ -49,4 +68,102 @@ bool operator!=(const keyframe_iterator &l,
   return !(l == r);
 }
 
+std::size_t KeyframeRange::size() const noexcept {
+  return this->motion.impl->keyframes().size();
+}
+
+const_keyframe_iterator::reference const_keyframe_iterator::operator*() const {
+  return {this->time(), this->store->frame(this->index)};
+}
+
+const_keyframe_iterator::pointer const_keyframe_iterator::operator->() const {
+  return pointer{**this};
+}
+
+const_keyframe_iterator::reference const_keyframe_iterator::
+operator[](difference_type n) const {
+  return *(*this + n);
+}
+
+double const_keyframe_iterator::time() const noexcept {
+  return this->store->time(this->index);
+}
+
+const_keyframe_iterator &const_keyframe_iterator::operator++() noexcept {
+  this->index++;
+  return *this;
+}
+const_keyframe_iterator const_keyframe_iterator::operator++(int) noexcept {
+  auto const copy = *this;
+  ++(*this);
+  return copy;
+}
+
+const_keyframe_iterator &const_keyframe_iterator::operator--() noexcept {
+  this->index--;
+  return *this;
+}
+const_keyframe_iterator const_keyframe_iterator::operator--(int) noexcept {
+  auto const copy = *this;
+  --(*this);
+  return copy;
+}
+
+const_keyframe_iterator &const_keyframe_iterator::
+operator+=(difference_type n) noexcept {
+  this->index = static_cast<std::size_t>(
+      static_cast<difference_type>(this->index) + n);
+  return *this;
+}
+const_keyframe_iterator &const_keyframe_iterator::
+operator-=(difference_type n) noexcept {
+  return *this += -n;
+}
+
+const_keyframe_iterator
+operator+(const_keyframe_iterator it,
+          const_keyframe_iterator::difference_type n) noexcept {
+  return it += n;
+}
+const_keyframe_iterator operator+(const_keyframe_iterator::difference_type n,
+                                  const_keyframe_iterator it) noexcept {
+  return it += n;
+}
+const_keyframe_iterator
+operator-(const_keyframe_iterator it,
+          const_keyframe_iterator::difference_type n) noexcept {
+  return it -= n;
+}
+const_keyframe_iterator::difference_type
+operator-(const const_keyframe_iterator &l,
+          const const_keyframe_iterator &r) noexcept {
+  return static_cast<const_keyframe_iterator::difference_type>(l.index) -
+         static_cast<const_keyframe_iterator::difference_type>(r.index);
+}
+
+bool operator==(const const_keyframe_iterator &l,
+                const const_keyframe_iterator &r) noexcept {
+  return l.store == r.store && l.index == r.index;
+}
+bool operator!=(const const_keyframe_iterator &l,
+                const const_keyframe_iterator &r) noexcept {
+  return !(l == r);
+}
+bool operator<(const const_keyframe_iterator &l,
+               const const_keyframe_iterator &r) noexcept {
+  return l.index < r.index;
+}
+bool operator>(const const_keyframe_iterator &l,
+               const const_keyframe_iterator &r) noexcept {
+  return r < l;
+}
+bool operator<=(const const_keyframe_iterator &l,
+                const const_keyframe_iterator &r) noexcept {
+  return !(r < l);
+}
+bool operator>=(const const_keyframe_iterator &l,
+                const const_keyframe_iterator &r) noexcept {
+  return !(l < r);
+}
+
 } // namespace flom
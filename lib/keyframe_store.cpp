@@ -0,0 +1,527 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/keyframe_store.hpp"
+#include "flom/interpolation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+namespace flom {
+
+namespace {
+
+template <typename T>
+auto row_begin(std::vector<T> &v, std::size_t k, std::size_t width) {
+  return std::next(std::begin(v), static_cast<std::ptrdiff_t>(k * width));
+}
+
+void write_rotation(const Rotation::value_type &q, double *r) {
+  r[0] = q.w();
+  r[1] = q.x();
+  r[2] = q.y();
+  r[3] = q.z();
+}
+
+// Slerps planar rotation rows r1 and r2 of n effectors,
+// passing each result to write(i, w, x, y, z)
+template <typename F>
+void slerp_rows(double t, const double *r1, const double *r2, std::size_t n,
+                F &&write) {
+  constexpr std::size_t chunk = 16;
+  double buf[chunk * 4];
+  auto const out = planar_quaternions(buf, chunk);
+  auto const a = planar_quaternions(r1, n);
+  auto const b = planar_quaternions(r2, n);
+  for (std::size_t offset = 0; offset < n; offset += chunk) {
+    auto const m = std::min(chunk, n - offset);
+    slerp_n(t, a + offset, b + offset, out, m);
+    for (std::size_t i = 0; i < m; i++) {
+      write(offset + i, out.w[i], out.x[i], out.y[i], out.z[i]);
+    }
+  }
+}
+
+// n-th power of a rotation difference cached as (angle, axis x, y, z)
+Rotation::value_type loop_rotation(const double *d, std::size_t n) {
+  auto const angle = d[0] * static_cast<double>(n);
+  auto const s = std::sin(angle);
+  return {std::cos(angle), s * d[1], s * d[2], s * d[3]};
+}
+
+} // namespace
+
+KeyframeStore::KeyframeStore(std::shared_ptr<const FrameSchema> schema,
+                             std::vector<EffectorType> types)
+    : schema_(std::move(schema)), types_(std::move(types)),
+      num_joints_(schema_->joints().size()),
+      num_effectors_(schema_->effectors().size()), valid_times_(false) {
+  assert(this->types_.size() == this->schema_->effectors().size() &&
+         "types must be supplied for each effector");
+  this->update_loop_offset();
+}
+
+const std::shared_ptr<const FrameSchema> &KeyframeStore::schema() const
+    noexcept {
+  return this->schema_;
+}
+
+const std::vector<EffectorType> &KeyframeStore::types() const noexcept {
+  return this->types_;
+}
+
+std::size_t KeyframeStore::size() const noexcept { return this->times_.size(); }
+bool KeyframeStore::empty() const noexcept { return this->times_.empty(); }
+
+std::size_t KeyframeStore::num_joints() const noexcept {
+  return this->num_joints_;
+}
+std::size_t KeyframeStore::num_effectors() const noexcept {
+  return this->num_effectors_;
+}
+
+const std::vector<double> &KeyframeStore::times() const noexcept {
+  return this->times_;
+}
+double KeyframeStore::time(std::size_t k) const noexcept {
+  return this->times_[k];
+}
+
+bool KeyframeStore::has_valid_times() const noexcept {
+  return this->valid_times_;
+}
+
+void KeyframeStore::update_valid_times(bool kept) {
+  this->valid_times_ =
+      kept || (!this->times_.empty() && this->times_.front() == 0 &&
+               std::is_sorted(std::cbegin(this->times_),
+                              std::cend(this->times_)));
+}
+
+std::size_t KeyframeStore::lower_bound(double t) const noexcept {
+  auto const it =
+      std::lower_bound(std::cbegin(this->times_), std::cend(this->times_), t);
+  return static_cast<std::size_t>(std::distance(std::cbegin(this->times_), it));
+}
+
+std::size_t KeyframeStore::upper_bound(double t) const noexcept {
+  auto const it =
+      std::upper_bound(std::cbegin(this->times_), std::cend(this->times_), t);
+  return static_cast<std::size_t>(std::distance(std::cbegin(this->times_), it));
+}
+
+compat::optional<std::size_t> KeyframeStore::find(double t) const noexcept {
+  auto const k = this->lower_bound(t);
+  if (k == this->size() || this->times_[k] != t) {
+    return compat::nullopt;
+  }
+  return k;
+}
+
+const double *KeyframeStore::positions_at(std::size_t k) const noexcept {
+  return this->positions_.data() + k * this->num_joints_;
+}
+const double *KeyframeStore::locations_at(std::size_t k) const noexcept {
+  return this->locations_.data() + k * this->num_effectors_ * 3;
+}
+const double *KeyframeStore::rotations_at(std::size_t k) const noexcept {
+  return this->rotations_.data() + k * this->num_effectors_ * 4;
+}
+
+Location KeyframeStore::location(std::size_t k, std::size_t i) const {
+  auto const l = this->locations_at(k) + i * 3;
+  return {l[0], l[1], l[2]};
+}
+
+Rotation KeyframeStore::rotation(std::size_t k, std::size_t i) const {
+  auto const n = this->num_effectors_;
+  auto const r = this->rotations_at(k) + i;
+  return {r[0], r[n], r[2 * n], r[3 * n]};
+}
+
+Frame KeyframeStore::frame(std::size_t k) const {
+  Frame f{this->schema_};
+  this->read(k, f);
+  return f;
+}
+
+void KeyframeStore::read(std::size_t k, Frame &f) const {
+  assert(f.schema() == this->schema_ && "frame must be bound to the schema");
+
+  auto const p = this->positions_at(k);
+  std::copy(p, p + this->num_joints_, f.position_data());
+
+  auto const effectors = f.effector_data();
+  for (std::size_t i = 0; i < this->num_effectors_; i++) {
+    auto &e = effectors[i];
+    if (this->types_[i].location()) {
+      e.set_location(this->location(k, i));
+    } else {
+      e.clear_location();
+    }
+    if (this->types_[i].rotation()) {
+      e.set_rotation(this->rotation(k, i));
+    } else {
+      e.clear_rotation();
+    }
+  }
+}
+
+void KeyframeStore::write(std::size_t k, const Frame &f) {
+  this->write_row(k, f);
+  if (k == 0 || k + 1 == this->size()) {
+    this->update_loop_offset();
+  }
+}
+
+void KeyframeStore::write_row(std::size_t k, const Frame &f) {
+  assert(f.schema() == this->schema_ && "frame must be bound to the schema");
+
+  auto const n = this->num_effectors_;
+  std::copy(f.position_data(), f.position_data() + this->num_joints_,
+            row_begin(this->positions_, k, this->num_joints_));
+
+  auto const l = this->locations_.data() + k * n * 3;
+  auto const r = this->rotations_.data() + k * n * 4;
+  auto const effectors = f.effector_data();
+  for (std::size_t i = 0; i < n; i++) {
+    auto const &e = effectors[i];
+    if (e.location()) {
+      auto const &v = e.location()->vector();
+      l[i * 3] = v.x();
+      l[i * 3 + 1] = v.y();
+      l[i * 3 + 2] = v.z();
+    } else {
+      std::fill_n(l + i * 3, 3, 0.0);
+    }
+    if (e.rotation()) {
+      auto const &q = e.rotation()->quaternion();
+      r[i] = q.w();
+      r[n + i] = q.x();
+      r[2 * n + i] = q.y();
+      r[3 * n + i] = q.z();
+    } else {
+      r[i] = 1;
+      r[n + i] = r[2 * n + i] = r[3 * n + i] = 0;
+    }
+  }
+}
+
+void KeyframeStore::interpolate(std::size_t k, double t, Frame &f) const {
+  assert(f.schema() == this->schema_ && "frame must be bound to the schema");
+  assert(k + 1 < this->size() && "no keyframe to interpolate with");
+
+  lerp_n(t, this->positions_at(k), this->positions_at(k + 1),
+         f.position_data(), this->num_joints_);
+
+  auto const effectors = f.effector_data();
+  for (std::size_t i = 0; i < this->num_effectors_; i++) {
+    auto &e = effectors[i];
+    if (this->types_[i].location()) {
+      e.set_location(flom::interpolate(t, this->location(k, i),
+                                       this->location(k + 1, i)));
+    } else {
+      e.clear_location();
+    }
+    if (!this->types_[i].rotation()) {
+      e.clear_rotation();
+    }
+  }
+  slerp_rows(t, this->rotations_at(k), this->rotations_at(k + 1),
+             this->num_effectors_,
+             [this, effectors](std::size_t i, double w, double x, double y,
+                               double z) {
+               if (this->types_[i].rotation()) {
+                 effectors[i].set_rotation(Rotation{w, x, y, z});
+               }
+             });
+}
+
+void KeyframeStore::add_loop_offset(std::size_t n, Frame &f) const {
+  assert(f.schema() == this->schema_ && "frame must be bound to the schema");
+
+  auto const scale = static_cast<double>(n);
+  auto const p = f.position_data();
+  for (std::size_t j = 0; j < this->num_joints_; j++) {
+    p[j] += this->loop_positions_[j] * scale;
+  }
+
+  auto const effectors = f.effector_data();
+  for (std::size_t i = 0; i < this->num_effectors_; i++) {
+    auto &e = effectors[i];
+    if (this->types_[i].location()) {
+      auto const d = this->loop_locations_.data() + i * 3;
+      e.set_location(*e.location() +
+                     Location{d[0] * scale, d[1] * scale, d[2] * scale});
+    }
+    if (this->types_[i].rotation()) {
+      auto const d = loop_rotation(this->loop_rotations_.data() + i * 4, n);
+      e.set_rotation(*e.rotation() + Rotation{d});
+    }
+  }
+}
+
+void KeyframeStore::read(std::size_t k, FrameRow row) const {
+  auto const p = this->positions_at(k);
+  std::copy(p, p + this->num_joints_, row.positions);
+
+  auto const l = this->locations_at(k);
+  std::copy(l, l + this->num_effectors_ * 3, row.locations);
+
+  for (std::size_t i = 0; i < this->num_effectors_; i++) {
+    auto const q = this->rotation(k, i).quaternion();
+    write_rotation(q, row.rotations + i * 4);
+  }
+}
+
+void KeyframeStore::interpolate(std::size_t k, double t, FrameRow row) const {
+  assert(k + 1 < this->size() && "no keyframe to interpolate with");
+
+  lerp_n(t, this->positions_at(k), this->positions_at(k + 1), row.positions,
+         this->num_joints_);
+  lerp_n(t, this->locations_at(k), this->locations_at(k + 1), row.locations,
+         this->num_effectors_ * 3);
+
+  // Effectors without rotation are kept as identity, which slerps to itself
+  slerp_rows(t, this->rotations_at(k), this->rotations_at(k + 1),
+             this->num_effectors_,
+             [&row](std::size_t i, double w, double x, double y, double z) {
+               auto *const r = row.rotations + i * 4;
+               r[0] = w;
+               r[1] = x;
+               r[2] = y;
+               r[3] = z;
+             });
+}
+
+void KeyframeStore::add_loop_offset(std::size_t n, FrameRow row) const {
+  auto const scale = static_cast<double>(n);
+  for (std::size_t j = 0; j < this->num_joints_; j++) {
+    row.positions[j] += this->loop_positions_[j] * scale;
+  }
+  for (std::size_t i = 0; i < this->num_effectors_ * 3; i++) {
+    row.locations[i] += this->loop_locations_[i] * scale;
+  }
+
+  for (std::size_t i = 0; i < this->num_effectors_; i++) {
+    if (!this->types_[i].rotation()) {
+      continue;
+    }
+    auto *const r = row.rotations + i * 4;
+    auto const d = loop_rotation(this->loop_rotations_.data() + i * 4, n);
+    auto const rot = Rotation{r[0], r[1], r[2], r[3]} + Rotation{d};
+    write_rotation(rot.quaternion(), r);
+  }
+}
+
+void KeyframeStore::update_loop_offset() {
+  auto const n = this->num_effectors_;
+  this->loop_positions_.assign(this->num_joints_, 0.0);
+  this->loop_locations_.assign(n * 3, 0.0);
+  this->loop_rotations_.assign(n * 4, 0.0);
+  if (this->empty()) {
+    return;
+  }
+
+  auto const last = this->size() - 1;
+  auto const p0 = this->positions_at(0);
+  auto const pn = this->positions_at(last);
+  for (std::size_t j = 0; j < this->num_joints_; j++) {
+    this->loop_positions_[j] = pn[j] - p0[j];
+  }
+
+  auto const l0 = this->locations_at(0);
+  auto const ln = this->locations_at(last);
+  for (std::size_t i = 0; i < n * 3; i++) {
+    this->loop_locations_[i] = ln[i] - l0[i];
+  }
+
+  for (std::size_t i = 0; i < n; i++) {
+    auto const d = (this->rotation(last, i) - this->rotation(0, i)).quaternion();
+    auto const norm = d.vec().norm();
+    auto *const c = this->loop_rotations_.data() + i * 4;
+    c[0] = std::atan2(norm, d.w());
+    if (norm != 0) {
+      c[1] = d.x() / norm;
+      c[2] = d.y() / norm;
+      c[3] = d.z() / norm;
+    }
+  }
+}
+
+std::size_t KeyframeStore::insert(double t, const Frame &f) {
+  auto const kept = this->valid_times_ && t >= 0;
+  auto const k = this->lower_bound(t);
+  if (k == this->size() || this->times_[k] != t) {
+    auto const n = this->num_effectors_;
+    this->times_.insert(row_begin(this->times_, k, 1), t);
+    this->positions_.insert(row_begin(this->positions_, k, this->num_joints_),
+                            this->num_joints_, 0.0);
+    this->locations_.insert(row_begin(this->locations_, k, n * 3), n * 3, 0.0);
+    this->rotations_.insert(row_begin(this->rotations_, k, n * 4), n * 4, 0.0);
+  }
+  this->write(k, f);
+  this->update_valid_times(kept);
+  return k;
+}
+
+std::size_t KeyframeStore::append_row(double t) {
+  auto const n = this->num_effectors_;
+  this->times_.push_back(t);
+  this->positions_.resize(this->positions_.size() + this->num_joints_);
+  this->locations_.resize(this->locations_.size() + n * 3);
+  this->rotations_.resize(this->rotations_.size() + n * 4);
+  return this->size() - 1;
+}
+
+void KeyframeStore::merge(
+    const std::vector<std::pair<double, Frame>> &frames) {
+  if (frames.empty()) {
+    return;
+  }
+  auto const kept = this->valid_times_ &&
+                    std::all_of(std::cbegin(frames), std::cend(frames),
+                                [](auto const &p) { return p.first >= 0; });
+
+  assert(std::adjacent_find(std::cbegin(frames), std::cend(frames),
+                            [](auto const &a, auto const &b) {
+                              return a.first >= b.first;
+                            }) == std::cend(frames) &&
+         "frames must be sorted by time without duplicates");
+
+  if (this->empty() || this->times_.back() < frames.front().first) {
+    this->reserve(this->size() + frames.size());
+    for (auto const &[t, f] : frames) {
+      this->write_row(this->append_row(t), f);
+    }
+    this->update_loop_offset();
+    this->update_valid_times(kept);
+    return;
+  }
+
+  KeyframeStore merged{this->schema_, this->types_};
+  merged.reserve(this->size() + frames.size());
+  auto const copy_row = [this, &merged](std::size_t k) {
+    auto const j = merged.append_row(this->time(k));
+    auto const nj = this->num_joints_;
+    auto const ne = this->num_effectors_;
+    std::copy_n(this->positions_at(k), nj, merged.positions_.data() + j * nj);
+    std::copy_n(this->locations_at(k), ne * 3,
+                merged.locations_.data() + j * ne * 3);
+    std::copy_n(this->rotations_at(k), ne * 4,
+                merged.rotations_.data() + j * ne * 4);
+  };
+
+  std::size_t k = 0;
+  for (auto const &[t, f] : frames) {
+    for (; k < this->size() && this->time(k) < t; k++) {
+      copy_row(k);
+    }
+    if (k < this->size() && this->time(k) == t) {
+      // replaced
+      k++;
+    }
+    merged.write_row(merged.append_row(t), f);
+  }
+  for (; k < this->size(); k++) {
+    copy_row(k);
+  }
+
+  merged.update_loop_offset();
+  *this = std::move(merged);
+  this->update_valid_times(kept);
+}
+
+void KeyframeStore::assign(std::vector<double> times,
+                           std::vector<double> positions,
+                           std::vector<double> locations,
+                           std::vector<double> rotations) {
+  auto const size = times.size();
+  assert(positions.size() == size * this->num_joints_ &&
+         locations.size() == size * this->num_effectors_ * 3 &&
+         rotations.size() == size * this->num_effectors_ * 4 &&
+         "columns must have rows for all keyframes");
+
+  this->times_ = std::move(times);
+  this->positions_ = std::move(positions);
+  this->locations_ = std::move(locations);
+  this->rotations_ = std::move(rotations);
+  this->update_loop_offset();
+  this->update_valid_times(false);
+}
+
+void KeyframeStore::erase(std::size_t k) {
+  auto const erase_row = [k](auto &v, std::size_t width) {
+    v.erase(row_begin(v, k, width), row_begin(v, k + 1, width));
+  };
+  erase_row(this->times_, 1);
+  erase_row(this->positions_, this->num_joints_);
+  erase_row(this->locations_, this->num_effectors_ * 3);
+  erase_row(this->rotations_, this->num_effectors_ * 4);
+
+  if (k == 0 || k == this->size()) {
+    this->update_loop_offset();
+  }
+  this->update_valid_times(this->valid_times_ && k != 0);
+}
+
+void KeyframeStore::truncate(std::size_t size) {
+  if (size >= this->size()) {
+    return;
+  }
+  this->times_.resize(size);
+  this->positions_.resize(size * this->num_joints_);
+  this->locations_.resize(size * this->num_effectors_ * 3);
+  this->rotations_.resize(size * this->num_effectors_ * 4);
+  this->update_loop_offset();
+  this->update_valid_times(this->valid_times_ && size != 0);
+}
+
+void KeyframeStore::reserve(std::size_t size) {
+  this->times_.reserve(size);
+  this->positions_.reserve(size * this->num_joints_);
+  this->locations_.reserve(size * this->num_effectors_ * 3);
+  this->rotations_.reserve(size * this->num_effectors_ * 4);
+}
+
+bool operator==(const KeyframeStore &a, const KeyframeStore &b) {
+  if (a.times_ != b.times_) {
+    return false;
+  }
+  if (*a.schema_ == *b.schema_ && a.types_ == b.types_) {
+    return a.positions_ == b.positions_ && a.locations_ == b.locations_ &&
+           a.rotations_ == b.rotations_;
+  }
+  // Different layouts; compare frame by frame, by names
+  for (std::size_t k = 0; k < a.size(); k++) {
+    if (a.frame(k) != b.frame(k)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool operator!=(const KeyframeStore &a, const KeyframeStore &b) {
+  return !(a == b);
+}
+
+} // namespace flom
@@ -0,0 +1,497 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/lazy_motion.hpp"
+#include "flom/compat/optional.hpp"
+#include "flom/errors.hpp"
+#include "flom/keyframe_store.hpp"
+#include "flom/mapped_file.hpp"
+#include "flom/motion.impl.hpp"
+#include "flom/motion_reader.hpp"
+#include "flom/motion_reader.impl.hpp"
+#include "flom/proto_util.hpp"
+
+#include "motion.pb.h"
+
+#include <boost/range/adaptors.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+
+namespace flom {
+
+namespace {
+
+using wire::CodedInputStream;
+using wire::WireFormatLite;
+namespace fields = wire::fields;
+
+// Location of a message in the file, including its length prefix
+struct Slice {
+  std::size_t offset;
+  std::size_t size;
+};
+
+// Scans the wire format with 64-bit offsets, as files may exceed the
+// 2 GiB limit of CodedInputStream. Only single fields are decoded with it.
+class Scanner {
+private:
+  const unsigned char *begin;
+  const unsigned char *p;
+  const unsigned char *end;
+
+public:
+  Scanner(const char *data, std::size_t size) noexcept
+      : begin(reinterpret_cast<const unsigned char *>(data)), p(begin),
+        end(begin + size) {}
+
+  bool at_end() const noexcept { return this->p == this->end; }
+  std::size_t offset() const noexcept {
+    return static_cast<std::size_t>(this->p - this->begin);
+  }
+
+  std::uint64_t varint() {
+    std::uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (this->p == this->end) {
+        wire::parse_error();
+      }
+      auto const b = *this->p++;
+      v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        return v;
+      }
+    }
+    wire::parse_error();
+  }
+
+  double fixed64() {
+    if (this->end - this->p < 8) {
+      wire::parse_error();
+    }
+    std::uint64_t bits = 0;
+    for (unsigned i = 0; i < 8; i++) {
+      bits |= static_cast<std::uint64_t>(this->p[i]) << (8 * i);
+    }
+    this->p += 8;
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+  }
+
+  // Skips the length-delimited value, returning its slice with the prefix
+  Slice message() {
+    auto const offset = this->offset();
+    auto const length = this->varint();
+    if (length > static_cast<std::uint64_t>(this->end - this->p)) {
+      wire::parse_error();
+    }
+    this->p += length;
+    return {offset, this->offset() - offset};
+  }
+
+  void skip(std::uint32_t tag) {
+    switch (WireFormatLite::GetTagWireType(tag)) {
+    case WireFormatLite::WIRETYPE_VARINT:
+      this->varint();
+      break;
+    case WireFormatLite::WIRETYPE_FIXED64:
+      this->fixed64();
+      break;
+    case WireFormatLite::WIRETYPE_LENGTH_DELIMITED:
+      this->message();
+      break;
+    case WireFormatLite::WIRETYPE_FIXED32:
+      if (this->end - this->p < 4) {
+        wire::parse_error();
+      }
+      this->p += 4;
+      break;
+    default:
+      // Groups are not used in motion files
+      wire::parse_error();
+    }
+  }
+
+  std::uint32_t tag() {
+    auto const tag = this->varint();
+    if (tag > std::numeric_limits<std::uint32_t>::max()) {
+      wire::parse_error();
+    }
+    return static_cast<std::uint32_t>(tag);
+  }
+};
+
+// Time of a Frame message, without decoding the rest
+double frame_time(const char *data, Slice s) {
+  Scanner frame{data + s.offset, s.size};
+  auto const length = frame.varint();
+  static_cast<void>(length);
+
+  double t = 0;
+  while (!frame.at_end()) {
+    auto const tag = frame.tag();
+    if (WireFormatLite::GetTagFieldNumber(tag) == fields::frame_t &&
+        wire::is_double(tag)) {
+      t = frame.fixed64();
+    } else {
+      frame.skip(tag);
+    }
+  }
+  return t;
+}
+
+CodedInputStream stream_of(const char *data, Slice s) {
+  if (s.size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    wire::parse_error();
+  }
+  return CodedInputStream{reinterpret_cast<const std::uint8_t *>(data) +
+                              s.offset,
+                          static_cast<int>(s.size)};
+}
+
+// Slice of the initial keyframe at 0 when the file has none
+constexpr Slice initial_keyframe{0, 0};
+
+} // namespace
+
+class LazyMotion::Impl {
+public:
+  MappedFile file;
+
+  MotionHeader header;
+  std::shared_ptr<const FrameSchema> schema;
+  std::vector<EffectorType> types;
+
+  std::vector<double> times;
+  std::vector<Slice> slices;
+
+  wire::FrameDecoder decoder;
+
+  // Least recently used keyframes are evicted first
+  struct CacheEntry {
+    std::size_t index;
+    std::uint64_t used;
+    Frame frame;
+  };
+  std::size_t cache_size;
+  std::vector<CacheEntry> cache;
+  std::uint64_t clock = 0;
+
+  // Two keyframes being interpolated
+  KeyframeStore segment;
+  // The first and the last keyframes, for loop offsets
+  compat::optional<KeyframeStore> ends;
+
+  Impl(const std::string &path, std::size_t cache_size_);
+
+  Frame new_keyframe() const;
+  void decode(std::size_t k, wire::FrameDecoder &, Frame &) const;
+  const Frame &cached(std::size_t k);
+  const KeyframeStore &loop_ends();
+};
+
+namespace {
+
+// Reads the header and indexes frames in the order of the file
+std::vector<std::pair<double, Slice>> scan(const MappedFile &file,
+                                           MotionHeader &header) {
+  std::vector<std::pair<double, Slice>> frames;
+  std::string key, buffer;
+  proto::EffectorType type_proto;
+  proto::EffectorWeight weight_proto;
+
+  Scanner s{file.data(), file.size()};
+  while (!s.at_end()) {
+    auto const tag = s.tag();
+    auto const field = WireFormatLite::GetTagFieldNumber(tag);
+    if (!wire::is_length_delimited(tag)) {
+      if (field == fields::loop && WireFormatLite::GetTagWireType(tag) ==
+                                       WireFormatLite::WIRETYPE_VARINT) {
+        auto const wrap = static_cast<std::uint64_t>(
+            proto::Motion::Loop::Motion_Loop_Wrap);
+        header.loop = s.varint() == wrap ? LoopType::Wrap : LoopType::None;
+      } else {
+        s.skip(tag);
+      }
+      continue;
+    }
+
+    auto const slice = s.message();
+    switch (field) {
+    case fields::frames: {
+      auto const t = frame_time(file.data(), slice);
+      // Negative times make the motion invalid, and NaN can't be sorted
+      if (!(t >= 0)) {
+        throw errors::InvalidFrameError{"while loading parsed motion data"};
+      }
+      frames.emplace_back(t, slice);
+      break;
+    }
+    case fields::model_id: {
+      auto in = stream_of(file.data(), slice);
+      wire::read_string(in, header.model_id);
+      break;
+    }
+    case fields::effector_types: {
+      auto in = stream_of(file.data(), slice);
+      wire::read_message_entry(in, key, buffer, type_proto);
+      header.effector_types.insert_or_assign(
+          key, proto_util::unpack_effector_type(type_proto));
+      break;
+    }
+    case fields::effector_weights: {
+      auto in = stream_of(file.data(), slice);
+      wire::read_message_entry(in, key, buffer, weight_proto);
+      header.effector_weights.insert_or_assign(
+          key, proto_util::unpack_effector_weight(weight_proto));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  if (frames.empty()) {
+    throw errors::InvalidFrameError{"while loading parsed motion data"};
+  }
+  return frames;
+}
+
+// Schema of a motion, taking joint names from the first frame in the file
+std::shared_ptr<const FrameSchema>
+schema_of(const MappedFile &file, Slice first, const MotionHeader &header) {
+  std::string key;
+  auto in = stream_of(file.data(), first);
+  auto const first_frame = wire::read_frame(in, key).second;
+  auto const names = first_frame.joint_names();
+  return make_schema({std::cbegin(names), std::cend(names)},
+                     header.effector_types);
+}
+
+} // namespace
+
+LazyMotion::Impl::Impl(const std::string &path, std::size_t cache_size_)
+    : file(path), decoder(FrameSchema::empty(), {}),
+      cache_size(std::max(cache_size_, static_cast<std::size_t>(1))),
+      segment(FrameSchema::empty(), {}) {
+  auto frames = scan(this->file, this->header);
+
+  this->schema = schema_of(this->file, frames.front().second, this->header);
+  this->types = types_in(*this->schema, this->header.effector_types);
+  this->decoder = wire::FrameDecoder{this->schema, this->types};
+
+  // Same as Motion: keyframes are sorted by time, and the last one
+  // of keyframes at the same time is kept
+  auto const by_time = [](auto const &a, auto const &b) {
+    return a.first < b.first;
+  };
+  std::stable_sort(std::begin(frames), std::end(frames), by_time);
+  auto const first = std::unique(std::rbegin(frames), std::rend(frames),
+                                 [](auto const &a, auto const &b) {
+                                   return a.first == b.first;
+                                 });
+  frames.erase(std::begin(frames), first.base());
+  if (frames.front().first != 0) {
+    this->times.push_back(0);
+    this->slices.push_back(initial_keyframe);
+  }
+  for (auto const &[t, slice] : frames) {
+    this->times.push_back(t);
+    this->slices.push_back(slice);
+  }
+
+  // Weights default to zero, as in Motion
+  auto weights = std::move(this->header.effector_weights);
+  this->header.effector_weights.clear();
+  for (auto const &[name, type] : this->header.effector_types) {
+    this->header.effector_weights.emplace(name, EffectorWeight{0.0, 0.0});
+  }
+  for (auto const &[name, weight] : weights) {
+    this->header.effector_weights.at(name) = weight;
+  }
+
+  this->segment = KeyframeStore{this->schema, this->types};
+  auto const f = this->new_keyframe();
+  this->segment.insert(0, f);
+  this->segment.insert(1, f);
+}
+
+Frame LazyMotion::Impl::new_keyframe() const {
+  Frame f{this->schema};
+  auto const e = f.effector_data();
+  for (std::size_t i = 0; i < this->types.size(); i++) {
+    e[i] = this->types[i].new_effector();
+  }
+  return f;
+}
+
+void LazyMotion::Impl::decode(std::size_t k, wire::FrameDecoder &d,
+                              Frame &f) const {
+  auto const slice = this->slices[k];
+  if (slice.size == 0) {
+    f = this->new_keyframe();
+    return;
+  }
+  auto in = stream_of(this->file.data(), slice);
+  d.read(in, f);
+}
+
+const Frame &LazyMotion::Impl::cached(std::size_t k) {
+  this->clock++;
+  auto const it =
+      std::find_if(std::begin(this->cache), std::end(this->cache),
+                   [k](auto const &entry) { return entry.index == k; });
+  if (it != std::end(this->cache)) {
+    it->used = this->clock;
+    return it->frame;
+  }
+
+  if (this->cache.size() < this->cache_size) {
+    // Added only once decoded, not to be found if decoding fails
+    Frame f{this->schema};
+    this->decode(k, this->decoder, f);
+    this->cache.push_back({k, this->clock, std::move(f)});
+    return this->cache.back().frame;
+  }
+
+  // Reuse the storage of the least recently used one
+  auto &entry = *std::min_element(
+      std::begin(this->cache), std::end(this->cache),
+      [](auto const &a, auto const &b) { return a.used < b.used; });
+  // Not to leave a stale entry behind if decoding fails
+  entry.index = this->slices.size();
+  this->decode(k, this->decoder, entry.frame);
+  entry.index = k;
+  entry.used = this->clock;
+  return entry.frame;
+}
+
+const KeyframeStore &LazyMotion::Impl::loop_ends() {
+  if (!this->ends) {
+    KeyframeStore ends_{this->schema, this->types};
+    ends_.insert(0, this->cached(0));
+    ends_.insert(1, this->cached(this->times.size() - 1));
+    this->ends = std::move(ends_);
+  }
+  return *this->ends;
+}
+
+LazyMotion::LazyMotion(const std::string &path, std::size_t cache_size)
+    : impl(std::make_unique<LazyMotion::Impl>(path, cache_size)) {}
+
+LazyMotion::LazyMotion(LazyMotion &&) noexcept = default;
+LazyMotion &LazyMotion::operator=(LazyMotion &&) noexcept = default;
+LazyMotion::~LazyMotion() {}
+
+std::string LazyMotion::model_id() const {
+  return this->impl->header.model_id;
+}
+
+LoopType LazyMotion::loop() const { return this->impl->header.loop; }
+
+double LazyMotion::length() const { return this->impl->times.back(); }
+
+bool LazyMotion::is_in_range_at(double t) const {
+  return this->loop() == LoopType::Wrap || t <= this->length();
+}
+
+KeyRange<std::string> LazyMotion::joint_names() const {
+  return this->impl->schema->joints().names();
+}
+
+KeyRange<std::string> LazyMotion::effector_names() const {
+  return this->impl->header.effector_types | boost::adaptors::map_keys;
+}
+
+EffectorType LazyMotion::effector_type(const std::string &name) const {
+  return this->impl->header.effector_types.at(name);
+}
+
+EffectorWeight LazyMotion::effector_weight(const std::string &name) const {
+  return this->impl->header.effector_weights.at(name);
+}
+
+Frame LazyMotion::frame_at(double t) {
+  auto &impl_ = *this->impl;
+  auto const &times = impl_.times;
+  std::size_t skip_episode;
+  std::tie(t, skip_episode) = loop_time(t, times.back(), impl_.header.loop);
+
+  auto const k = static_cast<std::size_t>(
+      std::upper_bound(std::cbegin(times), std::cend(times), t) -
+      std::cbegin(times) - 1);
+  Frame f{impl_.schema};
+  if (times[k] == t) {
+    f = impl_.cached(k);
+  } else {
+    // Rows are copied right away, as cached() may evict the other one
+    impl_.segment.write_row(0, impl_.cached(k));
+    impl_.segment.write_row(1, impl_.cached(k + 1));
+    impl_.segment.interpolate(0, (t - times[k]) / (times[k + 1] - times[k]),
+                              f);
+  }
+
+  if (skip_episode != 0) {
+    impl_.loop_ends().add_loop_offset(skip_episode, f);
+  }
+  return f;
+}
+
+const std::vector<double> &LazyMotion::keyframe_times() const noexcept {
+  return this->impl->times;
+}
+
+Frame LazyMotion::keyframe(std::size_t k) {
+  if (k >= this->impl->times.size()) {
+    throw std::out_of_range{"keyframe index out of range"};
+  }
+  return this->impl->cached(k);
+}
+
+Motion LazyMotion::to_motion() const {
+  auto const &impl_ = *this->impl;
+  auto const joints = this->joint_names();
+  Motion m{{std::cbegin(joints), std::cend(joints)},
+           impl_.header.effector_types,
+           impl_.header.model_id};
+  m.set_loop(impl_.header.loop);
+  for (auto const &[name, weight] : impl_.header.effector_weights) {
+    m.set_effector_weight(name, weight);
+  }
+
+  wire::FrameDecoder decoder{impl_.schema, impl_.types};
+  std::vector<std::pair<double, Frame>> frames;
+  frames.reserve(impl_.times.size());
+  for (std::size_t k = 0; k < impl_.times.size(); k++) {
+    Frame f{impl_.schema};
+    impl_.decode(k, decoder, f);
+    frames.emplace_back(impl_.times[k], std::move(f));
+  }
+  m.insert_keyframes(std::move(frames));
+  return m;
+}
+
+} // namespace flom
@@ -0,0 +1,124 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/mapped_file.hpp"
+#include "flom/errors.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flom {
+
+MappedFile::MappedFile(const std::string &path, bool populate) {
+  auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw errors::FileError{path, errno};
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    auto const error = errno;
+    ::close(fd);
+    throw errors::FileError{path, error};
+  }
+  if (!S_ISREG(st.st_mode)) {
+    // st_size is not the size of the contents
+    this->read_all(fd, path);
+    return;
+  }
+
+  this->size_ = static_cast<std::size_t>(st.st_size);
+  if (this->size_ == 0) {
+    // Empty mappings are not allowed
+    ::close(fd);
+    return;
+  }
+
+  auto flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if (populate) {
+    flags |= MAP_POPULATE;
+  }
+#endif
+  auto const data = ::mmap(nullptr, this->size_, PROT_READ, flags, fd, 0);
+  auto const error = errno;
+  // The mapping stays valid after closing
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw errors::FileError{path, error};
+  }
+  this->data_ = data;
+
+  // These are only hints; failures are ignored
+  ::madvise(this->data_, this->size_, MADV_SEQUENTIAL);
+#ifndef MAP_POPULATE
+  if (populate) {
+    ::madvise(this->data_, this->size_, MADV_WILLNEED);
+  }
+#endif
+}
+
+void MappedFile::read_all(int fd, const std::string &path) {
+  std::size_t size = 0;
+  while (true) {
+    if (size == this->buffer_.size()) {
+      this->buffer_.resize(std::max<std::size_t>(size * 2, 1 << 16));
+    }
+    auto const n =
+        ::read(fd, this->buffer_.data() + size, this->buffer_.size() - size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      auto const error = errno;
+      ::close(fd);
+      throw errors::FileError{path, error};
+    }
+    if (n == 0) {
+      break;
+    }
+    size += static_cast<std::size_t>(n);
+  }
+  ::close(fd);
+
+  this->buffer_.resize(size);
+  this->size_ = size;
+  if (size != 0) {
+    this->data_ = this->buffer_.data();
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (this->data_ && this->buffer_.empty()) {
+    ::munmap(this->data_, this->size_);
+  }
+}
+
+const char *MappedFile::data() const noexcept {
+  return static_cast<const char *>(this->data_);
+}
+
+std::size_t MappedFile::size() const noexcept { return this->size_; }
+
+} // namespace flom
@@ -22,12 +22,16 @@
 #include "flom/interpolation.hpp"
 #include "flom/loose_compare.hpp"
 #include "flom/motion.impl.hpp"
+#include "flom/motion_cursor.hpp"
 #include "flom/range.hpp"
+#include "flom/sample_buffer.hpp"
 
 #include "motion.pb.h"
 
 #include <boost/range/adaptors.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <string>
 
@@ -37,10 +41,12 @@ Motion::Motion(
     const std::unordered_set<std::string> &joint_names,
     const std::unordered_map<std::string, EffectorType> &effector_types,
     const std::string &model)
-    : impl(std::make_unique<Motion::Impl>(joint_names, effector_types, model)) {
+    : impl(std::make_shared<Motion::Impl>(joint_names, effector_types, model)) {
 }
-Motion::Motion(Motion const &m)
-    : impl(std::make_unique<Motion::Impl>(*m.impl)) {}
+Motion::Motion(Motion const &) = default;
+Motion &Motion::operator=(Motion const &) = default;
+Motion::Motion(Motion &&) noexcept = default;
+Motion &Motion::operator=(Motion &&) noexcept = default;
 
 Motion::~Motion() {}
 
@@ -50,38 +56,29 @@ bool Motion::is_valid_frame(const Frame &f) const {
 }
 
 Frame Motion::frame_at(double t) const {
-  if (std::isnan(t) || t < 0) {
-    throw errors::InvalidTimeError(t);
-  }
-  auto const [l, u] = this->impl->raw_frames.equal_range(t);
-  if (l->first == t) {
-    // found a frame with exactly same time
-    return l->second; // causes copy...
-  } else if (u == this->impl->raw_frames.end()) {
-    // Out of frames
-    if (this->impl->loop == LoopType::Wrap) {
-      auto const &last = std::next(l, -1);
-      auto const motion_length = last->first;
-      if (motion_length == 0) {
-        // only one frame with t == 0
-        return last->second;
-      }
+  Frame f{this->impl->schema};
+  this->frame_at_into(t, f);
+  return f;
+}
 
-      auto const skip_episode = static_cast<unsigned>(t / motion_length);
-      auto const trailing_t = t - skip_episode * motion_length;
-      auto const init_frame = this->impl->raw_frames.begin()->second;
-      auto const diff = last->second - init_frame;
-      return this->frame_at(trailing_t) + diff * skip_episode;
-    } else {
-      throw errors::OutOfFramesError(t);
-    }
-  } else {
-    // Between two frames -> interpolate
-    auto const t1 = std::next(l, -1)->first;
-    auto const t2 = u->first;
-    auto const &f1 = std::next(l, -1)->second;
-    auto const &f2 = u->second;
-    return interpolate((t - t1) / (t2 - t1), f1, f2);
+void Motion::frame_at_into(double t, Frame &f) const {
+  MotionCursor{*this}.frame_at_into(t, f);
+}
+
+SampleBuffer Motion::sample(compat::span<const double> times) const {
+  SampleBuffer buffer;
+  this->sample(times, buffer);
+  return buffer;
+}
+
+void Motion::sample(compat::span<const double> times,
+                    SampleBuffer &buffer) const {
+  auto const &keyframes = this->impl->keyframes();
+  buffer.reshape(keyframes.schema(), keyframes.types(), times.size());
+
+  MotionCursor cursor{*this};
+  for (std::size_t i = 0; i < times.size(); i++) {
+    cursor.frame_at_into(times[i], buffer.row(i));
   }
 }
 
@@ -91,8 +88,7 @@ bool Motion::is_in_range_at(double t) const {
   if (this->impl->loop == LoopType::Wrap) {
     return true;
   } else {
-    auto const last_t = std::next(this->impl->raw_frames.end(), -1)->first;
-    return t <= last_t;
+    return t <= this->length();
   }
 }
 
@@ -100,7 +96,39 @@ void Motion::insert_keyframe(double t, const Frame &frame) {
   if (!this->impl->is_valid_frame(frame)) {
     throw errors::InvalidFrameError{"during keyframe insertion"};
   }
-  this->impl->raw_frames[t] = frame;
+  auto const &schema = this->impl->schema;
+  if (frame.schema() == schema) {
+    this->mutable_impl().mutable_keyframes().insert(t, frame);
+  } else {
+    this->mutable_impl().mutable_keyframes().insert(t, frame.rebind(schema));
+  }
+}
+
+void Motion::insert_keyframes(std::vector<std::pair<double, Frame>> frames) {
+  auto const &schema = this->impl->schema;
+  for (auto &[t, frame] : frames) {
+    if (!this->impl->is_valid_frame(frame)) {
+      throw errors::InvalidFrameError{"during keyframe insertion"};
+    }
+    if (frame.schema() != schema) {
+      frame = frame.rebind(schema);
+    }
+  }
+
+  auto const by_time = [](auto const &a, auto const &b) {
+    return a.first < b.first;
+  };
+  if (!std::is_sorted(std::cbegin(frames), std::cend(frames), by_time)) {
+    std::stable_sort(std::begin(frames), std::end(frames), by_time);
+  }
+  // Keep the last one of the frames at the same time
+  auto const first = std::unique(std::rbegin(frames), std::rend(frames),
+                                 [](auto const &a, auto const &b) {
+                                   return a.first == b.first;
+                                 });
+  frames.erase(std::begin(frames), first.base());
+
+  this->mutable_impl().mutable_keyframes().merge(frames);
 }
 
 void Motion::delete_keyframe(double t, bool loose) {
@@ -108,7 +136,9 @@ void Motion::delete_keyframe(double t, bool loose) {
     throw errors::InitKeyframeError{};
   }
 
-  if (this->impl->raw_frames.erase(t) != 0) {
+  auto const &keyframes = this->impl->keyframes();
+  if (auto const k = keyframes.find(t)) {
+    this->mutable_impl().mutable_keyframes().erase(*k);
     return;
   }
   if (!loose) {
@@ -116,54 +146,42 @@ void Motion::delete_keyframe(double t, bool loose) {
   }
 
   // loose mode - find closest key
-  auto const lower = this->impl->raw_frames.lower_bound(t);
-  auto const begin = std::cbegin(this->impl->raw_frames);
-
-  std::remove_const_t<decltype(begin)> it;
-  if (lower != begin) {
-    auto const previous = std::prev(lower);
-    if ((t - previous->first) < (lower->first - t)) {
-      it = previous;
-    } else {
-      it = lower;
-    }
-  } else {
-    it = lower;
+  auto const lower = keyframes.lower_bound(t);
+
+  auto k = lower;
+  if (lower != 0 &&
+      (lower == keyframes.size() ||
+       (t - keyframes.time(lower - 1)) < (keyframes.time(lower) - t))) {
+    k = lower - 1;
   }
 
-  if (!loose_compare(t, it->first)) {
+  if (k == keyframes.size() || !loose_compare(t, keyframes.time(k))) {
     throw errors::KeyframeNotFoundError{t};
   }
 
-  this->impl->raw_frames.erase(it);
+  this->mutable_impl().mutable_keyframes().erase(k);
 }
 
-KeyframeRange Motion::keyframes() {
-  return {std::begin(this->impl->raw_frames), std::end(this->impl->raw_frames),
-          *this};
-}
+KeyframeRange Motion::keyframes() { return KeyframeRange{*this}; }
 
 ConstKeyframeRange Motion::keyframes() const { return this->const_keyframes(); }
 
 ConstKeyframeRange Motion::const_keyframes() const {
-  return {std::cbegin(this->impl->raw_frames),
-          std::cend(this->impl->raw_frames)};
+  return ConstKeyframeRange{this->impl->keyframes()};
 }
 
 void Motion::clear_keyframes() {
-  auto const first = std::cbegin(this->impl->raw_frames);
-  auto const end = std::cend(this->impl->raw_frames);
-  this->impl->raw_frames.erase(std::next(first, 1), end);
+  this->mutable_impl().mutable_keyframes().truncate(1);
 }
 
 LoopType Motion::loop() const { return this->impl->loop; }
 
-void Motion::set_loop(LoopType loop) { this->impl->loop = loop; }
+void Motion::set_loop(LoopType loop) { this->mutable_impl().loop = loop; }
 
 std::string Motion::model_id() const { return this->impl->model_id; }
 
 void Motion::set_model_id(std::string const &model_id) {
-  this->impl->model_id = model_id;
+  this->mutable_impl().model_id = model_id;
 }
 
 EffectorType Motion::effector_type(const std::string &name) const {
@@ -176,36 +194,55 @@ EffectorWeight Motion::effector_weight(const std::string &name) const {
 
 void Motion::set_effector_weight(const std::string &name,
                                  EffectorWeight weight) {
-  this->impl->effector_weights.at(name) = weight;
+  this->mutable_impl().effector_weights.at(name) = weight;
 }
 
 double Motion::length() const {
-  return std::next(this->impl->raw_frames.end(), -1)->first;
+  auto const &keyframes = this->impl->keyframes();
+  return keyframes.time(keyframes.size() - 1);
 }
 
 Frame Motion::new_keyframe() const { return this->impl->new_keyframe(); }
 
-Frame Motion::Impl::new_keyframe() const noexcept {
-  std::unordered_map<std::string, double> p;
-  std::unordered_map<std::string, Effector> e;
+Motion::Impl &Motion::mutable_impl() {
+  if (this->impl.use_count() > 1) {
+    // Keyframes are still shared here; see Impl::mutable_keyframes
+    this->impl = std::make_shared<Impl>(*this->impl);
+  } else {
+    // use_count() is a relaxed load: pairs with the release by a copy
+    // dropped on another thread, before writing in place
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return *this->impl;
+}
 
-  p.reserve(this->joint_names.size());
-  for (const auto &name : this->joint_names) {
-    p.emplace(name, 0.0);
+KeyframeStore &Motion::Impl::mutable_keyframes() {
+  if (this->shared_keyframes.use_count() > 1) {
+    this->shared_keyframes =
+        std::make_shared<KeyframeStore>(*this->shared_keyframes);
+  } else {
+    // Same as Motion::mutable_impl
+    std::atomic_thread_fence(std::memory_order_acquire);
   }
+  return *this->shared_keyframes;
+}
+
+Frame Motion::Impl::new_keyframe() const noexcept {
+  Frame f{this->schema};
 
-  e.reserve(this->effector_types.size());
-  for (const auto &[name, type] : this->effector_types) {
-    e.emplace(name, type.new_effector());
+  auto const &types = this->keyframes().types();
+  auto const e = f.effector_data();
+  for (std::size_t i = 0; i < types.size(); i++) {
+    e[i] = types[i].new_effector();
   }
 
-  return {p, e};
+  return f;
 }
 
 void Motion::Impl::add_initial_frame() {
-  assert(this->raw_frames.size() == 0 && "raw_frames already initialized");
+  assert(this->keyframes().empty() && "keyframes already initialized");
 
-  this->raw_frames.emplace(0.0, this->new_keyframe());
+  this->mutable_keyframes().insert(0.0, this->new_keyframe());
 }
 
 bool Motion::Impl::is_valid() const {
@@ -215,24 +252,31 @@ bool Motion::Impl::is_valid() const {
   // which is constructed only using public interface,
   // must not be marked as invalid by this method.
   //
-  if (this->raw_frames.size() == 0 || this->raw_frames.begin()->first != 0) {
-    return false;
-  }
+  // Frames are validated on insertion and stored in the schema,
+  // so only the keyframe times need checking here. The store keeps track
+  // of them, rescanning only after changes which may break them.
+  return this->keyframes().has_valid_times();
+}
 
-  for (auto const &[t, frame] : this->raw_frames) {
-    if (!this->is_valid_frame(frame)) {
-      return false;
+bool Motion::Impl::is_valid_frame(const Frame &frame) const {
+  if (frame.schema() == this->schema) {
+    // The schema works as an identity token: frames from new_keyframe()
+    // have the same names, so only effector types need checking
+    auto const &types = this->keyframes().types();
+    auto const e = frame.effector_data();
+    for (std::size_t i = 0; i < types.size(); i++) {
+      if (!types[i].is_compatible(e[i])) {
+        return false;
+      }
     }
+    return true;
   }
-  return true;
-}
 
-bool Motion::Impl::is_valid_frame(const Frame &frame) const {
-  auto const &p = frame.positions();
+  auto const &names = *frame.schema();
   auto const &e = frame.effectors();
 
-  if (names_hash(p) != this->joints_hash ||
-      names_hash(e) != this->effectors_hash) {
+  if (names_hash(names.joints()) != this->joints_hash ||
+      names_hash(names.effectors()) != this->effectors_hash) {
     return false;
   }
   for (auto const &[name, type] : this->effector_types) {
@@ -244,7 +288,7 @@ bool Motion::Impl::is_valid_frame(const Frame &frame) const {
 }
 
 KeyRange<std::string> Motion::joint_names() const {
-  return this->impl->joint_names;
+  return this->impl->schema->joints().names();
 }
 
 KeyRange<std::string> Motion::effector_names() const {
@@ -254,7 +298,7 @@ KeyRange<std::string> Motion::effector_names() const {
 bool operator==(const Motion &m1, const Motion &m2) {
   return m1.impl->model_id == m2.impl->model_id &&
          m1.impl->loop == m2.impl->loop &&
-         m1.impl->raw_frames == m2.impl->raw_frames &&
+         m1.impl->keyframes() == m2.impl->keyframes() &&
          m1.impl->effector_types == m2.impl->effector_types &&
          m1.impl->effector_weights == m2.impl->effector_weights;
 }
@@ -0,0 +1,1154 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/compat/optional.hpp"
+#include "flom/effector_type.hpp"
+#include "flom/effector_weight.hpp"
+#include "flom/errors.hpp"
+#include "flom/interpolation.hpp"
+#include "flom/motion.hpp"
+#include "flom/motion.impl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Columnar format, version 1. All values are little-endian.
+//
+//   offset  size  content
+//   0       8     magic "\x89FOMC\r\n\x1a"
+//   8       4     version
+//   12      4     flags (bit 0: loop is Wrap, bit 1: quantized)
+//   16      8     number of keyframes K
+//   24      8     number of joints J
+//   32      8     number of effectors E
+//   40      8     offset of the name table
+//   48      8     size of the name table
+//   56      8     offset of times        [K]
+//   64      8     offset of positions    [K x J]
+//   72      8     offset of locations    [K x E x 3]
+//   80      8     offset of rotations    [K x 4 x E]
+//   88      8     size of the file
+//
+// Columns are matrices of doubles in the layout of KeyframeStore,
+// each starting at a multiple of 64 bytes.
+//
+// The name table is a sequence of strings (u32 size followed by bytes):
+// the model id, J joint names and E effector names, where each effector
+// name is followed by
+//   u8 location type, u8 rotation type (0: none, 1: world, 2: local),
+//   f64 location weight, f64 rotation weight
+//
+// In a quantized file, each column extends to the next one and holds
+//   times:     f64 tick, then K - 1 varint deltas in ticks
+//              (or K doubles if tick is 0)
+//   positions: a channel for each joint
+//   locations: 3 channels (x, y, z) for each effector with location
+//   rotations: for each effector with rotation,
+//              f64 step, u8 bits, then K records of 2 bits index of the
+//              largest component and 1 bit its sign, followed by
+//              3 sequences of indices of the other components in order
+//              (or K x 4 doubles (w, x, y, z) if bits is 64)
+// where a channel is
+//   f64 min, f64 step, u8 bits, then a sequence of K indices
+//   (or K doubles if bits is 64), which is value = min + index * step.
+// A sequence of indices in bits each is
+//   u8 order (0, 1 or 2), u8 residual bits R, then
+//   K indices if order is 0, otherwise the first order indices,
+//   followed by zigzag-encoded residuals from the previous index (order 1)
+//   or the linear extrapolation of previous two (order 2), in R bits each.
+//   A residual of all ones in R bits is followed by the index itself.
+// Bits are packed from the least significant bit of each byte, and each
+// run of bits ends at a byte boundary.
+
+namespace flom {
+
+namespace {
+
+constexpr char magic[8] = {'\x89', 'F', 'O', 'M', 'C', '\r', '\n', '\x1a'};
+constexpr std::uint32_t version = 1;
+constexpr std::uint32_t loop_wrap = 1;
+constexpr std::uint32_t quantized = 2;
+constexpr std::size_t header_size = 96;
+constexpr std::uint64_t column_alignment = 64;
+// Channels are stored as doubles with this many bits
+constexpr unsigned raw_bits = 64;
+// Larger indices would lose precision when converted from doubles
+constexpr double max_levels = 4503599627370496.0; // 2^52
+
+bool is_little_endian() noexcept {
+  std::uint32_t const v = 1;
+  unsigned char c;
+  std::memcpy(&c, &v, 1);
+  return c == 1;
+}
+
+std::uint64_t align(std::uint64_t offset) noexcept {
+  return (offset + column_alignment - 1) / column_alignment *
+         column_alignment;
+}
+
+// Size in bytes of a column, throwing errors::ParseError on overflow
+std::uint64_t column_size(std::uint64_t rows, std::uint64_t width) {
+  auto const max = std::numeric_limits<std::uint64_t>::max();
+  if (width != 0 && rows > max / width / sizeof(double)) {
+    throw errors::ParseError{};
+  }
+  return rows * width * sizeof(double);
+}
+
+template <typename T> void put(std::string &out, T v) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &v, sizeof(T));
+  out.append(bytes, sizeof(T));
+}
+
+void put_string(std::string &out, const std::string &s) {
+  if (s.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw errors::SerializationError{};
+  }
+  put(out, static_cast<std::uint32_t>(s.size()));
+  out.append(s);
+}
+
+void put_varint(std::string &out, std::uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+std::uint8_t pack_coord(compat::optional<CoordinateSystem> c) noexcept {
+  if (!c) {
+    return 0;
+  }
+  return *c == CoordinateSystem::World ? 1 : 2;
+}
+
+compat::optional<CoordinateSystem> unpack_coord(std::uint8_t c) {
+  switch (c) {
+  case 0:
+    return compat::nullopt;
+  case 1:
+    return CoordinateSystem::World;
+  case 2:
+    return CoordinateSystem::Local;
+  default:
+    throw errors::ParseError{};
+  }
+}
+
+// Reads values in order, throwing errors::ParseError at the end of input
+class Cursor {
+private:
+  const char *p;
+  const char *end;
+
+public:
+  Cursor(const char *data, std::size_t size) noexcept
+      : p(data), end(data + size) {}
+
+  template <typename T> T get() {
+    if (static_cast<std::size_t>(this->end - this->p) < sizeof(T)) {
+      throw errors::ParseError{};
+    }
+    T v;
+    std::memcpy(&v, this->p, sizeof(T));
+    this->p += sizeof(T);
+    return v;
+  }
+
+  std::string get_string() {
+    auto const size = this->get<std::uint32_t>();
+    if (static_cast<std::size_t>(this->end - this->p) < size) {
+      throw errors::ParseError{};
+    }
+    std::string s{this->p, size};
+    this->p += size;
+    return s;
+  }
+
+  std::uint64_t get_varint() {
+    std::uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      auto const b = this->get<std::uint8_t>();
+      v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        return v;
+      }
+    }
+    throw errors::ParseError{};
+  }
+};
+
+std::uint64_t low_bits(std::uint64_t v, unsigned bits) noexcept {
+  return bits >= 64 ? v : v & ((std::uint64_t{1} << bits) - 1);
+}
+
+class BitWriter {
+private:
+  std::string &out;
+  std::uint64_t byte = 0;
+  unsigned used = 0;
+
+public:
+  explicit BitWriter(std::string &out_) noexcept : out(out_) {}
+
+  void put(std::uint64_t v, unsigned bits) {
+    for (unsigned i = 0; i < bits;) {
+      auto const n = std::min(8 - this->used, bits - i);
+      this->byte |= low_bits(v >> i, n) << this->used;
+      this->used += n;
+      i += n;
+      if (this->used == 8) {
+        this->flush();
+      }
+    }
+  }
+
+  // Pads the last byte with zeros
+  void flush() {
+    if (this->used != 0) {
+      this->out.push_back(static_cast<char>(this->byte));
+      this->byte = 0;
+      this->used = 0;
+    }
+  }
+};
+
+class BitReader {
+private:
+  Cursor &in;
+  std::uint64_t byte = 0;
+  unsigned left = 0;
+
+public:
+  explicit BitReader(Cursor &in_) noexcept : in(in_) {}
+
+  std::uint64_t get(unsigned bits) {
+    std::uint64_t v = 0;
+    for (unsigned i = 0; i < bits;) {
+      if (this->left == 0) {
+        this->byte = this->in.get<std::uint8_t>();
+        this->left = 8;
+      }
+      auto const n = std::min(this->left, bits - i);
+      v |= low_bits(this->byte, n) << i;
+      this->byte >>= n;
+      this->left -= n;
+      i += n;
+    }
+    return v;
+  }
+};
+
+// Number of bits to store indices up to max
+unsigned bits_for(std::uint64_t max) noexcept {
+  unsigned bits = 0;
+  for (; max != 0; max >>= 1) {
+    bits++;
+  }
+  return bits;
+}
+
+std::uint64_t zigzag(std::int64_t v) noexcept {
+  return (static_cast<std::uint64_t>(v) << 1) ^
+         static_cast<std::uint64_t>(v >> 63);
+}
+
+// Prediction of the k-th index by the previous ones (k >= order)
+std::uint64_t predict(const std::vector<std::uint64_t> &indices,
+                      std::size_t k, unsigned order) noexcept {
+  // Wraps around with broken data, which is harmless
+  return order == 1 ? indices[k - 1] : 2 * indices[k - 1] - indices[k - 2];
+}
+
+// Writes indices in bits each, or as residuals from a prediction by
+// previous indices when that is smaller; values of smooth channels
+// change little between keyframes.
+void put_indices(std::string &out, const std::vector<std::uint64_t> &indices,
+                 unsigned bits) {
+  auto const size = indices.size();
+  unsigned best_order = 0, best_residual_bits = 0;
+  auto best_cost = static_cast<std::uint64_t>(size) * bits;
+  for (unsigned order = 1; order <= 2; order++) {
+    if (size <= order) {
+      break;
+    }
+    // Number of residuals which need n bits (and not to be an escape)
+    std::array<std::uint64_t, raw_bits + 1> histogram{};
+    for (std::size_t k = order; k < size; k++) {
+      auto const residual =
+          static_cast<std::int64_t>(indices[k] - predict(indices, k, order));
+      histogram[bits_for(zigzag(residual) + 1)]++;
+    }
+    for (unsigned residual_bits = 1; residual_bits <= raw_bits;
+         residual_bits++) {
+      std::uint64_t cost = order * bits;
+      for (unsigned n = 0; n <= raw_bits; n++) {
+        cost += histogram[n] *
+                (n <= residual_bits ? residual_bits : residual_bits + bits);
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_order = order;
+        best_residual_bits = residual_bits;
+      }
+    }
+  }
+
+  put(out, static_cast<std::uint8_t>(best_order));
+  put(out, static_cast<std::uint8_t>(best_residual_bits));
+  BitWriter writer{out};
+  auto const escape = low_bits(~std::uint64_t{0}, best_residual_bits);
+  for (std::size_t k = 0; k < size; k++) {
+    if (k < best_order || best_order == 0) {
+      writer.put(indices[k], bits);
+      continue;
+    }
+    auto const residual = zigzag(static_cast<std::int64_t>(
+        indices[k] - predict(indices, k, best_order)));
+    if (residual < escape) {
+      writer.put(residual, best_residual_bits);
+    } else {
+      writer.put(escape, best_residual_bits);
+      writer.put(indices[k], bits);
+    }
+  }
+  writer.flush();
+}
+
+std::vector<std::uint64_t> get_indices(Cursor &in, std::size_t size,
+                                       unsigned bits) {
+  auto const order = in.get<std::uint8_t>();
+  auto const residual_bits = in.get<std::uint8_t>();
+  if (order > 2 || residual_bits > raw_bits) {
+    throw errors::ParseError{};
+  }
+
+  std::vector<std::uint64_t> indices(size);
+  BitReader reader{in};
+  auto const escape = low_bits(~std::uint64_t{0}, residual_bits);
+  for (std::size_t k = 0; k < size; k++) {
+    if (k < order || order == 0) {
+      indices[k] = reader.get(bits);
+      continue;
+    }
+    auto const residual = reader.get(residual_bits);
+    if (residual == escape) {
+      indices[k] = reader.get(bits);
+    } else {
+      // Inverse of zigzag
+      indices[k] = predict(indices, k, order) + ((residual >> 1) ^
+                                                 (~(residual & 1) + 1));
+    }
+  }
+  return indices;
+}
+
+// Strided view of a column, one value for each keyframe
+struct Channel {
+  const double *data;
+  std::size_t size;
+  std::size_t stride;
+
+  double operator[](std::size_t k) const noexcept {
+    return this->data[k * this->stride];
+  }
+};
+
+void put_raw_channel(std::string &out, Channel c) {
+  put(out, 0.0);
+  put(out, 0.0);
+  put(out, static_cast<std::uint8_t>(raw_bits));
+  for (std::size_t k = 0; k < c.size; k++) {
+    put(out, c[k]);
+  }
+}
+
+void put_channel(std::string &out, Channel c, double max_error) {
+  if (!(max_error > 0) || c.size == 0) {
+    put_raw_channel(out, c);
+    return;
+  }
+
+  auto min = c[0], max = c[0];
+  for (std::size_t k = 0; k < c.size; k++) {
+    min = std::min(min, c[k]);
+    max = std::max(max, c[k]);
+  }
+  auto const step = max_error * 2;
+  auto const levels = std::round((max - min) / step) + 1;
+  if (!std::isfinite(min) || !std::isfinite(max) || !(levels < max_levels)) {
+    put_raw_channel(out, c);
+    return;
+  }
+
+  auto const max_index = static_cast<std::uint64_t>(levels) - 1;
+  std::vector<std::uint64_t> indices(c.size);
+  for (std::size_t k = 0; k < c.size; k++) {
+    auto const index = std::min(
+        static_cast<std::uint64_t>(std::llround((c[k] - min) / step)),
+        max_index);
+    // Rounding in the arithmetic above may exceed the error slightly
+    if (std::abs(min + static_cast<double>(index) * step - c[k]) >
+        max_error) {
+      put_raw_channel(out, c);
+      return;
+    }
+    indices[k] = index;
+  }
+
+  auto const bits = bits_for(max_index);
+  put(out, min);
+  put(out, step);
+  put(out, static_cast<std::uint8_t>(bits));
+  put_indices(out, indices, bits);
+}
+
+// Writes each value to values[k * stride]
+void get_channel(Cursor &in, double *values, std::size_t size,
+                 std::size_t stride) {
+  auto const min = in.get<double>();
+  auto const step = in.get<double>();
+  auto const bits = in.get<std::uint8_t>();
+  if (bits == raw_bits) {
+    for (std::size_t k = 0; k < size; k++) {
+      values[k * stride] = in.get<double>();
+    }
+    return;
+  }
+  if (bits > raw_bits) {
+    throw errors::ParseError{};
+  }
+
+  auto const indices = get_indices(in, size, bits);
+  for (std::size_t k = 0; k < size; k++) {
+    values[k * stride] = min + static_cast<double>(indices[k]) * step;
+  }
+}
+
+// Range of the smaller three components of a unit quaternion
+constexpr double smallest_three_max = 0.70710678118654752440; // 1 / sqrt(2)
+
+struct SmallestThree {
+  unsigned largest;
+  bool negative;
+  std::array<std::uint64_t, 3> indices;
+};
+
+SmallestThree encode_rotation(const std::array<double, 4> &q, double step,
+                              std::uint64_t max_index) noexcept {
+  unsigned largest = 0;
+  for (unsigned i = 1; i < 4; i++) {
+    if (std::abs(q[i]) > std::abs(q[largest])) {
+      largest = i;
+    }
+  }
+  SmallestThree r{largest, q[largest] < 0, {}};
+  for (unsigned i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      auto const v = std::clamp(q[i], -smallest_three_max, smallest_three_max);
+      r.indices[j++] = std::min(static_cast<std::uint64_t>(std::llround(
+                                    (v + smallest_three_max) / step)),
+                                max_index);
+    }
+  }
+  return r;
+}
+
+std::array<double, 4> decode_rotation(const SmallestThree &r, double step) {
+  std::array<double, 4> q;
+  double sum = 0;
+  for (unsigned i = 0, j = 0; i < 4; i++) {
+    if (i != r.largest) {
+      q[i] = static_cast<double>(r.indices[j++]) * step - smallest_three_max;
+      sum += q[i] * q[i];
+    }
+  }
+  q[r.largest] = std::sqrt(std::max(1 - sum, 0.0));
+  if (r.negative) {
+    q[r.largest] = -q[r.largest];
+  }
+  auto const norm = std::sqrt(sum + q[r.largest] * q[r.largest]);
+  for (auto &v : q) {
+    v /= norm;
+  }
+  return q;
+}
+
+// Rotations of the i-th of n effectors, in a column of K x 4 x n
+struct RotationChannel {
+  const double *data;
+  std::size_t size;
+  std::size_t n;
+  std::size_t i;
+
+  std::array<double, 4> operator[](std::size_t k) const noexcept {
+    auto const r = this->data + k * this->n * 4 + this->i;
+    return {r[0], r[this->n], r[2 * this->n], r[3 * this->n]};
+  }
+};
+
+void put_raw_rotations(std::string &out, RotationChannel c) {
+  put(out, 0.0);
+  put(out, static_cast<std::uint8_t>(raw_bits));
+  for (std::size_t k = 0; k < c.size; k++) {
+    for (auto const v : c[k]) {
+      put(out, v);
+    }
+  }
+}
+
+void put_rotations(std::string &out, RotationChannel c, double max_error) {
+  if (!(max_error > 0)) {
+    put_raw_rotations(out, c);
+    return;
+  }
+
+  // With components off by step / 2 at most, the angle is off by
+  // 2 * sqrt(3) * step at most (including the largest one)
+  auto const step = max_error / (2 * std::sqrt(3.0));
+  auto const levels = std::round(2 * smallest_three_max / step) + 1;
+  if (!(levels < max_levels)) {
+    put_raw_rotations(out, c);
+    return;
+  }
+
+  auto const max_index = static_cast<std::uint64_t>(levels) - 1;
+  std::vector<SmallestThree> encoded;
+  encoded.reserve(c.size);
+  for (std::size_t k = 0; k < c.size; k++) {
+    auto q = c[k];
+    auto const norm =
+        std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (!std::isfinite(norm) || norm == 0) {
+      put_raw_rotations(out, c);
+      return;
+    }
+    for (auto &v : q) {
+      v /= norm;
+    }
+    auto const r = encode_rotation(q, step, max_index);
+    if (!(rotation_angle(q, decode_rotation(r, step)) <= max_error)) {
+      put_raw_rotations(out, c);
+      return;
+    }
+    encoded.push_back(r);
+  }
+
+  auto const bits = bits_for(max_index);
+  put(out, step);
+  put(out, static_cast<std::uint8_t>(bits));
+  BitWriter writer{out};
+  for (auto const &r : encoded) {
+    writer.put(r.largest, 2);
+    writer.put(r.negative ? 1 : 0, 1);
+  }
+  writer.flush();
+  std::vector<std::uint64_t> indices(encoded.size());
+  for (std::size_t j = 0; j < 3; j++) {
+    for (std::size_t k = 0; k < encoded.size(); k++) {
+      indices[k] = encoded[k].indices[j];
+    }
+    put_indices(out, indices, bits);
+  }
+}
+
+// Writes rotations of the i-th of n effectors in a column of K x 4 x n
+void get_rotations(Cursor &in, double *rotations, std::size_t size,
+                   std::size_t n, std::size_t i) {
+  auto const step = in.get<double>();
+  auto const bits = in.get<std::uint8_t>();
+  auto const write = [&](std::size_t k, const std::array<double, 4> &q) {
+    auto const r = rotations + k * n * 4 + i;
+    r[0] = q[0];
+    r[n] = q[1];
+    r[2 * n] = q[2];
+    r[3 * n] = q[3];
+  };
+  if (bits == raw_bits) {
+    for (std::size_t k = 0; k < size; k++) {
+      std::array<double, 4> q;
+      for (auto &v : q) {
+        v = in.get<double>();
+      }
+      write(k, q);
+    }
+    return;
+  }
+  if (bits > raw_bits) {
+    throw errors::ParseError{};
+  }
+
+  std::vector<SmallestThree> encoded(size);
+  BitReader reader{in};
+  for (auto &r : encoded) {
+    r.largest = static_cast<unsigned>(reader.get(2));
+    r.negative = reader.get(1) != 0;
+  }
+  for (std::size_t j = 0; j < 3; j++) {
+    auto const indices = get_indices(in, size, bits);
+    for (std::size_t k = 0; k < size; k++) {
+      encoded[k].indices[j] = indices[k];
+    }
+  }
+  for (std::size_t k = 0; k < size; k++) {
+    write(k, decode_rotation(encoded[k], step));
+  }
+}
+
+void put_times(std::string &out, const std::vector<double> &times,
+               double max_error) {
+  auto const tick = max_error * 2;
+  std::vector<std::uint64_t> ticks;
+  ticks.reserve(times.size());
+  bool exact = !(max_error > 0);
+  for (auto const t : times) {
+    if (exact || !(t / tick < max_levels)) {
+      exact = true;
+      break;
+    }
+    auto const n = static_cast<std::uint64_t>(std::llround(t / tick));
+    // Keyframes must stay in order, at distinct times
+    if ((!ticks.empty() && n <= ticks.back()) ||
+        std::abs(static_cast<double>(n) * tick - t) > max_error) {
+      exact = true;
+      break;
+    }
+    ticks.push_back(n);
+  }
+
+  if (exact) {
+    put(out, 0.0);
+    for (auto const t : times) {
+      put(out, t);
+    }
+    return;
+  }
+  put(out, tick);
+  for (std::size_t k = 1; k < ticks.size(); k++) {
+    put_varint(out, ticks[k] - ticks[k - 1]);
+  }
+}
+
+std::vector<double> get_times(Cursor &in, std::size_t size) {
+  std::vector<double> times;
+  times.reserve(size);
+  auto const tick = in.get<double>();
+  if (tick == 0) {
+    for (std::size_t k = 0; k < size; k++) {
+      times.push_back(in.get<double>());
+    }
+    return times;
+  }
+
+  std::uint64_t n = 0;
+  times.push_back(0);
+  for (std::size_t k = 1; k < size; k++) {
+    n += in.get_varint();
+    times.push_back(static_cast<double>(n) * tick);
+  }
+  return times;
+}
+
+// Copies a column with rows of groups of n blocks, where the i-th block
+// of each group in the file goes to index[i] in the motion
+std::vector<double> read_column(const char *data, std::size_t rows,
+                                std::size_t groups,
+                                const std::vector<std::size_t> &index,
+                                std::size_t block) {
+  auto const n = index.size();
+  auto const width = groups * n * block;
+  std::vector<double> column(rows * width);
+
+  bool identity = true;
+  for (std::size_t i = 0; i < n; i++) {
+    identity = identity && index[i] == i;
+  }
+  if (identity) {
+    std::memcpy(column.data(), data, column.size() * sizeof(double));
+    return column;
+  }
+
+  for (std::size_t r = 0; r < rows; r++) {
+    for (std::size_t g = 0; g < groups; g++) {
+      auto const begin = r * width + g * n * block;
+      for (std::size_t i = 0; i < n; i++) {
+        std::memcpy(column.data() + begin + index[i] * block,
+                    data + (begin + i * block) * sizeof(double),
+                    block * sizeof(double));
+      }
+    }
+  }
+  return column;
+}
+
+const char *bytes_of(const std::vector<double> &v) noexcept {
+  return reinterpret_cast<const char *>(v.data());
+}
+
+// Bytes of a section to write
+struct Section {
+  const char *data;
+  std::uint64_t size;
+};
+
+// Writes the header and sections, each at a multiple of column_alignment
+void write_file(std::ostream &os, std::uint32_t flags,
+                const KeyframeStore &keyframes, const std::string &names,
+                const std::array<Section, 4> &columns) {
+  std::uint64_t const names_offset = header_size;
+  std::array<std::uint64_t, 4> offsets;
+  auto end = names_offset + names.size();
+  for (std::size_t i = 0; i < columns.size(); i++) {
+    offsets[i] = align(end);
+    end = offsets[i] + columns[i].size;
+  }
+
+  std::string header{magic, sizeof(magic)};
+  put(header, version);
+  put(header, flags);
+  put(header, static_cast<std::uint64_t>(keyframes.size()));
+  put(header, static_cast<std::uint64_t>(keyframes.num_joints()));
+  put(header, static_cast<std::uint64_t>(keyframes.num_effectors()));
+  put(header, names_offset);
+  put(header, static_cast<std::uint64_t>(names.size()));
+  for (auto const offset : offsets) {
+    put(header, offset);
+  }
+  put(header, end);
+
+  static char const padding[column_alignment] = {};
+  os.write(header.data(), static_cast<std::streamsize>(header.size()));
+  os.write(names.data(), static_cast<std::streamsize>(names.size()));
+  auto written = names_offset + names.size();
+  for (std::size_t i = 0; i < columns.size(); i++) {
+    os.write(padding, static_cast<std::streamsize>(offsets[i] - written));
+    os.write(columns[i].data, static_cast<std::streamsize>(columns[i].size));
+    written = offsets[i] + columns[i].size;
+  }
+  if (!os) {
+    throw errors::SerializationError{};
+  }
+}
+
+} // namespace
+
+bool Motion::Impl::is_columnar(const char *data, std::size_t size) noexcept {
+  return size >= sizeof(magic) &&
+         std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+bool Motion::Impl::is_columnar(std::istream &f) {
+  // No other bytes are consumed, so that protobuf can be parsed otherwise
+  return f.peek() == std::char_traits<char>::to_int_type(magic[0]);
+}
+
+Motion Motion::Impl::from_columnar(std::istream &f) {
+  std::string data(header_size, '\0');
+  if (!f.read(&data[0], static_cast<std::streamsize>(header_size))) {
+    throw errors::ParseError{};
+  }
+  std::uint64_t file_size;
+  std::memcpy(&file_size, data.data() + 88, sizeof(file_size));
+  if (file_size < header_size || file_size > data.max_size()) {
+    throw errors::ParseError{};
+  }
+
+  // Read in chunks, not to allocate for a size in a corrupt header
+  // before the data is there
+  constexpr std::uint64_t chunk_size = 1 << 20;
+  while (data.size() < file_size) {
+    auto const offset = data.size();
+    auto const n = std::min(chunk_size, file_size - offset);
+    data.resize(offset + static_cast<std::size_t>(n));
+    if (!f.read(&data[offset], static_cast<std::streamsize>(n))) {
+      throw errors::ParseError{};
+    }
+  }
+  return Motion::Impl::from_columnar(data.data(), data.size());
+}
+
+Motion Motion::Impl::from_columnar(const char *data, std::size_t size) {
+  if (!is_little_endian() || size < header_size ||
+      !Motion::Impl::is_columnar(data, size)) {
+    throw errors::ParseError{};
+  }
+
+  Cursor header{data + sizeof(magic), header_size - sizeof(magic)};
+  if (header.get<std::uint32_t>() != version) {
+    throw errors::ParseError{};
+  }
+  auto const flags = header.get<std::uint32_t>();
+  auto const num_keyframes = header.get<std::uint64_t>();
+  auto const num_joints = header.get<std::uint64_t>();
+  auto const num_effectors = header.get<std::uint64_t>();
+  auto const names_offset = header.get<std::uint64_t>();
+  auto const names_size = header.get<std::uint64_t>();
+  auto const times_offset = header.get<std::uint64_t>();
+  auto const positions_offset = header.get<std::uint64_t>();
+  auto const locations_offset = header.get<std::uint64_t>();
+  auto const rotations_offset = header.get<std::uint64_t>();
+  auto const file_size = header.get<std::uint64_t>();
+
+  auto const check = [file_size](std::uint64_t offset, std::uint64_t bytes) {
+    if (offset > file_size || bytes > file_size - offset) {
+      throw errors::ParseError{};
+    }
+  };
+  if (file_size > size) {
+    throw errors::ParseError{};
+  }
+  check(names_offset, names_size);
+  if ((flags & quantized) != 0) {
+    // Each column extends to the next one
+    check(times_offset, positions_offset - times_offset);
+    check(positions_offset, locations_offset - positions_offset);
+    check(locations_offset, rotations_offset - locations_offset);
+    check(rotations_offset, file_size - rotations_offset);
+    // Each keyframe takes at least a byte of the times
+    if (num_keyframes > positions_offset - times_offset) {
+      throw errors::ParseError{};
+    }
+  } else {
+    check(times_offset, column_size(num_keyframes, 1));
+    check(positions_offset, column_size(num_keyframes, num_joints));
+    check(locations_offset, column_size(num_keyframes, num_effectors * 3));
+    check(rotations_offset, column_size(num_keyframes, num_effectors * 4));
+  }
+  if (num_keyframes == 0) {
+    throw errors::InvalidFrameError{"while loading parsed motion data"};
+  }
+
+  Cursor names{data + names_offset, static_cast<std::size_t>(names_size)};
+  auto const model_id = names.get_string();
+  std::vector<std::string> joint_names;
+  for (std::uint64_t i = 0; i < num_joints; i++) {
+    joint_names.push_back(names.get_string());
+  }
+  std::vector<std::string> effector_names;
+  std::vector<EffectorType> types;
+  std::vector<EffectorWeight> weights;
+  for (std::uint64_t i = 0; i < num_effectors; i++) {
+    effector_names.push_back(names.get_string());
+    auto const location = unpack_coord(names.get<std::uint8_t>());
+    auto const rotation = unpack_coord(names.get<std::uint8_t>());
+    types.emplace_back(location, rotation);
+    auto const location_weight = names.get<double>();
+    auto const rotation_weight = names.get<double>();
+    weights.emplace_back(location_weight, rotation_weight);
+  }
+
+  std::unordered_set<std::string> joint_set{std::cbegin(joint_names),
+                                            std::cend(joint_names)};
+  std::unordered_map<std::string, EffectorType> effector_types;
+  for (std::size_t i = 0; i < effector_names.size(); i++) {
+    effector_types.emplace(effector_names[i], types[i]);
+  }
+  if (joint_set.size() != joint_names.size() ||
+      effector_types.size() != effector_names.size()) {
+    throw errors::InvalidFrameError{"while loading parsed motion data"};
+  }
+
+  Motion m{joint_set, effector_types, model_id};
+  m.mutable_impl().loop =
+      (flags & loop_wrap) != 0 ? LoopType::Wrap : LoopType::None;
+  for (std::size_t i = 0; i < effector_names.size(); i++) {
+    m.set_effector_weight(effector_names[i], weights[i]);
+  }
+
+  // Columns in the file are in the order of names in the file
+  auto const &schema = *m.impl->schema;
+  std::vector<std::size_t> joint_index, effector_index;
+  for (auto const &name : joint_names) {
+    joint_index.push_back(*schema.joints().find(name));
+  }
+  for (auto const &name : effector_names) {
+    effector_index.push_back(*schema.effectors().find(name));
+  }
+
+  auto const k = static_cast<std::size_t>(num_keyframes);
+  auto const nj = joint_names.size();
+  auto const ne = effector_names.size();
+  std::vector<double> times;
+  const char *positions_data = data + positions_offset;
+  const char *locations_data = data + locations_offset;
+  const char *rotations_data = data + rotations_offset;
+  // Decoded columns of a quantized file, in the order of the file
+  std::vector<double> positions_file, locations_file, rotations_file;
+  if ((flags & quantized) != 0) {
+    auto const section = [data](std::uint64_t begin, std::uint64_t end) {
+      return Cursor{data + begin, static_cast<std::size_t>(end - begin)};
+    };
+    // Decoded columns may be larger than the file, but must be addressable
+    auto const length = [](std::uint64_t rows, std::uint64_t width) {
+      auto const bytes = column_size(rows, width);
+      if (bytes > std::numeric_limits<std::size_t>::max()) {
+        throw errors::ParseError{};
+      }
+      return static_cast<std::size_t>(bytes / sizeof(double));
+    };
+
+    auto times_in = section(times_offset, positions_offset);
+    times = get_times(times_in, k);
+
+    positions_file.resize(length(k, nj));
+    auto positions_in = section(positions_offset, locations_offset);
+    for (std::size_t i = 0; i < nj; i++) {
+      get_channel(positions_in, positions_file.data() + i, k, nj);
+    }
+
+    locations_file.resize(length(k, ne * 3));
+    rotations_file.resize(length(k, ne * 4));
+    auto locations_in = section(locations_offset, rotations_offset);
+    auto rotations_in = section(rotations_offset, file_size);
+    for (std::size_t i = 0; i < ne; i++) {
+      if (types[i].location()) {
+        for (std::size_t c = 0; c < 3; c++) {
+          get_channel(locations_in, locations_file.data() + i * 3 + c, k,
+                      ne * 3);
+        }
+      }
+      if (types[i].rotation()) {
+        get_rotations(rotations_in, rotations_file.data(), k, ne, i);
+      } else {
+        for (std::size_t r = 0; r < k; r++) {
+          rotations_file[r * ne * 4 + i] = 1;
+        }
+      }
+    }
+
+    positions_data = bytes_of(positions_file);
+    locations_data = bytes_of(locations_file);
+    rotations_data = bytes_of(rotations_file);
+  } else {
+    times.resize(k);
+    std::memcpy(times.data(), data + times_offset, k * sizeof(double));
+  }
+
+  if (times.front() != 0 ||
+      std::adjacent_find(std::cbegin(times), std::cend(times),
+                         [](double a, double b) { return !(a < b); }) !=
+          std::cend(times)) {
+    throw errors::InvalidFrameError{"while loading parsed motion data"};
+  }
+  auto positions = read_column(positions_data, k, 1, joint_index, 1);
+  auto locations = read_column(locations_data, k, 1, effector_index, 3);
+  auto rotations = read_column(rotations_data, k, 4, effector_index, 1);
+
+  // Components an effector doesn't have must be zero and identity
+  auto const &store_types = m.impl->keyframes().types();
+  for (std::size_t r = 0; r < k; r++) {
+    for (std::size_t i = 0; i < ne; i++) {
+      auto const l = locations.data() + (r * ne + i) * 3;
+      auto const q = rotations.data() + r * ne * 4 + i;
+      if ((!store_types[i].location() &&
+           (l[0] != 0 || l[1] != 0 || l[2] != 0)) ||
+          (!store_types[i].rotation() &&
+           (q[0] != 1 || q[ne] != 0 || q[2 * ne] != 0 || q[3 * ne] != 0))) {
+        throw errors::InvalidFrameError{"while loading parsed motion data"};
+      }
+    }
+  }
+
+  m.mutable_impl().mutable_keyframes().assign(
+      std::move(times), std::move(positions), std::move(locations),
+      std::move(rotations));
+  return m;
+}
+
+namespace {
+
+std::string
+names_of(const std::string &model_id, const KeyframeStore &keyframes,
+         const std::unordered_map<std::string, EffectorWeight> &weights) {
+  auto const &schema = *keyframes.schema();
+  auto const &effectors = schema.effectors();
+
+  std::string names;
+  put_string(names, model_id);
+  for (auto const &name : schema.joints().names()) {
+    put_string(names, name);
+  }
+  for (std::size_t i = 0; i < effectors.size(); i++) {
+    auto const &name = effectors.name(i);
+    auto const &type = keyframes.types()[i];
+    auto const &weight = weights.at(name);
+    put_string(names, name);
+    put(names, pack_coord(type.location()));
+    put(names, pack_coord(type.rotation()));
+    put(names, weight.location());
+    put(names, weight.rotation());
+  }
+  return names;
+}
+
+std::uint32_t loop_flag(LoopType loop) noexcept {
+  return loop == LoopType::Wrap ? loop_wrap : 0;
+}
+
+// Whether the keyframes of b are within the errors from a
+bool within(const KeyframeStore &a, const KeyframeStore &b,
+            const Quantization &q) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  auto const &schema_a = *a.schema();
+  auto const &schema_b = *b.schema();
+  std::vector<std::size_t> joints, effectors;
+  for (auto const &name : schema_a.joints().names()) {
+    joints.push_back(*schema_b.joints().find(name));
+  }
+  for (auto const &name : schema_a.effectors().names()) {
+    effectors.push_back(*schema_b.effectors().find(name));
+  }
+
+  // Exact values must stay exact; the others are compared with errors
+  auto const near = [](double x, double y, double error) {
+    return x == y || std::abs(x - y) <= error;
+  };
+  for (std::size_t k = 0; k < a.size(); k++) {
+    if (!near(a.time(k), b.time(k), q.time)) {
+      return false;
+    }
+    auto const pa = a.positions_at(k);
+    auto const pb = b.positions_at(k);
+    for (std::size_t i = 0; i < joints.size(); i++) {
+      if (!near(pa[i], pb[joints[i]], q.position)) {
+        return false;
+      }
+    }
+    for (std::size_t i = 0; i < effectors.size(); i++) {
+      auto const la = a.location(k, i).vector();
+      auto const lb = b.location(k, effectors[i]).vector();
+      for (Eigen::Index c = 0; c < 3; c++) {
+        if (!near(la[c], lb[c], q.location)) {
+          return false;
+        }
+      }
+      auto const ra = a.rotation(k, i).quaternion();
+      auto const rb = b.rotation(k, effectors[i]).quaternion();
+      if (ra.coeffs() != rb.coeffs() &&
+          !(rotation_angle({ra.w(), ra.x(), ra.y(), ra.z()},
+                           {rb.w(), rb.x(), rb.y(), rb.z()}) <= q.rotation)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+void Motion::dump_columnar(std::ostream &os) const {
+  auto const &impl_ = *this->impl;
+  if (!impl_.is_valid()) {
+    throw errors::InvalidFrameError{
+        "converting motion data before serializaion"};
+  }
+  if (!is_little_endian()) {
+    throw errors::SerializationError{};
+  }
+
+  auto const &keyframes = impl_.keyframes();
+  auto const k = keyframes.size();
+  auto const ne = keyframes.num_effectors();
+  write_file(os, loop_flag(impl_.loop), keyframes,
+             names_of(impl_.model_id, keyframes, impl_.effector_weights),
+             {{{bytes_of(keyframes.times()), column_size(k, 1)},
+               {reinterpret_cast<const char *>(keyframes.positions_at(0)),
+                column_size(k, keyframes.num_joints())},
+               {reinterpret_cast<const char *>(keyframes.locations_at(0)),
+                column_size(k, ne * 3)},
+               {reinterpret_cast<const char *>(keyframes.rotations_at(0)),
+                column_size(k, ne * 4)}}});
+}
+
+void Motion::dump_columnar(std::ostream &os, const Quantization &q) const {
+  auto const &impl_ = *this->impl;
+  if (!impl_.is_valid()) {
+    throw errors::InvalidFrameError{
+        "converting motion data before serializaion"};
+  }
+  if (!is_little_endian()) {
+    throw errors::SerializationError{};
+  }
+
+  auto const &keyframes = impl_.keyframes();
+  auto const &types = keyframes.types();
+  auto const k = keyframes.size();
+  auto const nj = keyframes.num_joints();
+  auto const ne = keyframes.num_effectors();
+
+  std::string times, positions, locations, rotations;
+  put_times(times, keyframes.times(), q.time);
+  for (std::size_t i = 0; i < nj; i++) {
+    put_channel(positions, {keyframes.positions_at(0) + i, k, nj},
+                q.position);
+  }
+  for (std::size_t i = 0; i < ne; i++) {
+    if (types[i].location()) {
+      for (std::size_t c = 0; c < 3; c++) {
+        put_channel(locations,
+                    {keyframes.locations_at(0) + i * 3 + c, k, ne * 3},
+                    q.location);
+      }
+    }
+    if (types[i].rotation()) {
+      put_rotations(rotations, {keyframes.rotations_at(0), k, ne, i},
+                    q.rotation);
+    }
+  }
+
+  std::ostringstream buffer;
+  write_file(buffer, loop_flag(impl_.loop) | quantized, keyframes,
+             names_of(impl_.model_id, keyframes, impl_.effector_weights),
+             {{{times.data(), times.size()},
+               {positions.data(), positions.size()},
+               {locations.data(), locations.size()},
+               {rotations.data(), rotations.size()}}});
+  auto const data = buffer.str();
+
+  if (q.verify) {
+    auto const decoded = Motion::Impl::from_columnar(data.data(), data.size());
+    if (!within(keyframes, decoded.impl->keyframes(), q)) {
+      throw errors::SerializationError{};
+    }
+  }
+
+  os.write(data.data(), static_cast<std::streamsize>(data.size()));
+  if (!os) {
+    throw errors::SerializationError{};
+  }
+}
+
+} // namespace flom
@@ -0,0 +1,144 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/motion_cursor.hpp"
+#include "flom/errors.hpp"
+#include "flom/motion.impl.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+namespace flom {
+
+namespace {
+
+// Number of segments walked from the last one before falling back to
+// binary search
+constexpr std::size_t max_walk = 4;
+
+} // namespace
+
+std::pair<double, std::size_t> loop_time(double t, double motion_length,
+                                         LoopType loop) {
+  if (std::isnan(t) || t < 0) {
+    throw errors::InvalidTimeError(t);
+  }
+  if (t <= motion_length) {
+    return {t, 0};
+  }
+
+  // Out of frames
+  if (loop != LoopType::Wrap) {
+    throw errors::OutOfFramesError(t);
+  }
+  if (motion_length == 0) {
+    // only one frame with t == 0
+    return {0, 0};
+  }
+
+  constexpr auto max_skip =
+      static_cast<double>(std::numeric_limits<std::size_t>::max());
+  std::size_t skip_episode = 0;
+  while (t > motion_length) {
+    auto const skip = std::floor(t / motion_length);
+    if (!(skip < max_skip)) {
+      // Too many loops to be counted, including infinite t
+      throw errors::OutOfFramesError(t);
+    }
+    t -= skip * motion_length;
+    skip_episode += static_cast<std::size_t>(skip);
+  }
+  // t / motion_length may be rounded up when t is close to a multiple
+  return {std::max(t, 0.0), skip_episode};
+}
+
+std::size_t MotionCursor::locate(const KeyframeStore &keyframes,
+                                 double t) noexcept {
+  auto const last = keyframes.size() - 1;
+  auto k = std::min(this->segment_, last);
+  if (t < keyframes.time(k)) {
+    // Small backward seek
+    for (std::size_t i = 0; i < max_walk && k > 0; i++) {
+      k--;
+      if (keyframes.time(k) <= t) {
+        return this->segment_ = k;
+      }
+    }
+    // Otherwise start over from the beginning, as looping playback does
+    k = 0;
+  }
+
+  // Forward playback
+  for (std::size_t i = 0; i < max_walk; i++) {
+    if (k == last || t < keyframes.time(k + 1)) {
+      return this->segment_ = k;
+    }
+    k++;
+  }
+
+  // There always is a keyframe at 0, so upper_bound(t) > 0 here
+  return this->segment_ = keyframes.upper_bound(t) - 1;
+}
+
+template <typename Out> void MotionCursor::evaluate(double t, Out &&out) {
+  auto const &keyframes = this->motion->impl->keyframes();
+  auto const motion_length = keyframes.time(keyframes.size() - 1);
+  std::size_t skip_episode;
+  std::tie(t, skip_episode) =
+      loop_time(t, motion_length, this->motion->impl->loop);
+
+  auto const k = this->locate(keyframes, t);
+  if (keyframes.time(k) == t) {
+    // found a frame with exactly same time
+    keyframes.read(k, out);
+  } else {
+    // Between two frames -> interpolate
+    auto const t1 = keyframes.time(k);
+    auto const t2 = keyframes.time(k + 1);
+    keyframes.interpolate(k, (t - t1) / (t2 - t1), out);
+  }
+
+  if (skip_episode != 0) {
+    keyframes.add_loop_offset(skip_episode, out);
+  }
+}
+
+Frame MotionCursor::frame_at(double t) {
+  Frame f{this->motion->impl->schema};
+  this->frame_at_into(t, f);
+  return f;
+}
+
+void MotionCursor::frame_at_into(double t, Frame &f) {
+  auto const &schema = this->motion->impl->keyframes().schema();
+  if (f.schema() != schema) {
+    // Allocates only for the first time
+    f = Frame{schema};
+  }
+  this->evaluate(t, f);
+}
+
+void MotionCursor::frame_at_into(double t, FrameRow row) {
+  this->evaluate(t, row);
+}
+
+} // namespace flom
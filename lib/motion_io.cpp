@@ -18,46 +18,192 @@
 //
 
 #include "flom/errors.hpp"
+#include "flom/mapped_file.hpp"
 #include "flom/motion.hpp"
 #include "flom/motion.impl.hpp"
 #include "flom/proto_util.hpp"
+#include "flom/thread_pool.hpp"
 
 #include "motion.pb.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <numeric>
 #include <string>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
-#include <google/protobuf/util/json_util.h>
+#include <google/protobuf/arena.h>
 
 namespace flom {
 
+namespace {
+
+[[noreturn]] void invalid_motion() {
+  throw errors::InvalidFrameError{"while loading parsed motion data"};
+}
+
+} // namespace
+
 Motion Motion::load(std::istream &f) {
-  proto::Motion m;
-  if (!m.ParseFromIstream(&f)) {
-    throw errors::ParseError{};
-  }
+  google::protobuf::Arena arena{Motion::Impl::arena_options()};
+  return Motion::Impl::parse(f, arena);
+}
 
-  return Motion::Impl::from_protobuf(m);
+Motion Motion::load_file(const std::string &path, bool populate) {
+  MappedFile const file{path, populate};
+  google::protobuf::Arena arena{Motion::Impl::arena_options()};
+  return Motion::Impl::parse(file.data(), file.size(), arena);
 }
 
 Motion Motion::load_json(std::istream &f) {
   std::string s;
-  f >> s;
-  return Motion::load_json_string(s);
+  char chunk[1 << 16];
+  while (f.read(chunk, sizeof(chunk)), f.gcount() > 0) {
+    s.append(chunk, static_cast<std::size_t>(f.gcount()));
+  }
+  return Motion::Impl::from_json(s.data(), s.size());
 }
 
 Motion Motion::load_json_string(std::string const &s) {
-  proto::Motion m;
-  auto const status = google::protobuf::util::JsonStringToMessage(s, &m);
-  if (!status.ok()) {
-    throw errors::JSONLoadError(status.ToString());
+  return Motion::Impl::from_json(s.data(), s.size());
+}
+
+Motion Motion::Impl::parse(std::istream &f, google::protobuf::Arena &arena,
+                           ThreadPool *pool) {
+  if (Motion::Impl::is_columnar(f)) {
+    return Motion::Impl::from_columnar(f);
+  }
+
+  if (pool) {
+    // Frames are located in the whole message to be decoded in parallel
+    std::string s;
+    char chunk[1 << 16];
+    while (f.read(chunk, sizeof(chunk)), f.gcount() > 0) {
+      s.append(chunk, static_cast<std::size_t>(f.gcount()));
+    }
+    return Motion::Impl::parse(s.data(), s.size(), arena, pool);
+  }
+
+  auto const m = google::protobuf::Arena::CreateMessage<proto::Motion>(&arena);
+  if (!m->ParseFromIstream(&f)) {
+    throw errors::ParseError{};
+  }
+
+  return Motion::Impl::from_protobuf(*m);
+}
+
+Motion Motion::Impl::parse(const char *data, std::size_t size,
+                           google::protobuf::Arena &arena, ThreadPool *pool) {
+  if (Motion::Impl::is_columnar(data, size)) {
+    return Motion::Impl::from_columnar(data, size);
+  }
+
+  if (size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    // Messages of 2 GiB or more can't be parsed by protobuf anyway
+    throw errors::ParseError{};
+  }
+
+  if (pool) {
+    return Motion::Impl::parse_parallel(data, size, *pool);
+  }
+
+  auto const m = google::protobuf::Arena::CreateMessage<proto::Motion>(&arena);
+  if (!m->ParseFromArray(data, static_cast<int>(size))) {
+    throw errors::ParseError{};
+  }
+
+  return Motion::Impl::from_protobuf(*m);
+}
+
+google::protobuf::ArenaOptions Motion::Impl::arena_options() noexcept {
+  // Messages of a motion are freed at once with the arena,
+  // so larger blocks only mean fewer allocations
+  google::protobuf::ArenaOptions options;
+  options.max_block_size = 1 << 20;
+  return options;
+}
+
+void Motion::Impl::assign_keyframes(std::vector<double> times,
+                                    std::vector<double> positions,
+                                    std::vector<double> locations,
+                                    std::vector<double> rotations,
+                                    const ColumnOrder *order) {
+  auto &store = this->mutable_keyframes();
+  auto const size = times.size();
+  auto const in_order =
+      std::adjacent_find(std::cbegin(times), std::cend(times),
+                         std::greater_equal<double>{}) == std::cend(times);
+  if (!order && in_order && times.front() == 0) {
+    // Common case, without copying
+    store.assign(std::move(times), std::move(positions), std::move(locations),
+                 std::move(rotations));
+    return;
   }
-  return Motion::Impl::from_protobuf(m);
+
+  std::vector<std::size_t> sorted(size);
+  std::iota(std::begin(sorted), std::end(sorted), 0);
+  if (!in_order) {
+    std::stable_sort(std::begin(sorted), std::end(sorted),
+                     [&times](auto a, auto b) { return times[a] < times[b]; });
+  }
+  std::vector<std::size_t> rows;
+  rows.reserve(size);
+  for (std::size_t i = 0; i < size; i++) {
+    if (i + 1 < size && times[sorted[i]] == times[sorted[i + 1]]) {
+      continue;
+    }
+    rows.push_back(sorted[i]);
+  }
+
+  auto const nj = store.num_joints();
+  auto const ne = store.num_effectors();
+  auto const initial = times[rows.front()] > 0;
+  auto const rows_out = rows.size() + (initial ? 1 : 0);
+  std::vector<double> times_out, positions_out(rows_out * nj),
+      locations_out(rows_out * ne * 3), rotations_out(rows_out * ne * 4);
+  times_out.reserve(rows_out);
+  std::size_t r = 0;
+  if (initial) {
+    times_out.push_back(0);
+    std::fill_n(std::begin(rotations_out), ne, 1);
+    r++;
+  }
+  for (auto const k : rows) {
+    times_out.push_back(times[k]);
+    if (!order) {
+      std::copy_n(&positions[k * nj], nj, &positions_out[r * nj]);
+      std::copy_n(&locations[k * ne * 3], ne * 3, &locations_out[r * ne * 3]);
+      std::copy_n(&rotations[k * ne * 4], ne * 4, &rotations_out[r * ne * 4]);
+    } else {
+      for (std::size_t i = 0; i < nj; i++) {
+        positions_out[r * nj + order->joints[i]] = positions[k * nj + i];
+      }
+      for (std::size_t i = 0; i < ne; i++) {
+        auto const e = order->effectors[i];
+        std::copy_n(&locations[(k * ne + i) * 3], 3,
+                    &locations_out[(r * ne + e) * 3]);
+        auto const q = &rotations[(k * ne + i) * 4];
+        for (std::size_t c = 0; c < 4; c++) {
+          rotations_out[r * ne * 4 + c * ne + e] = q[c];
+        }
+      }
+    }
+    r++;
+  }
+
+  store.assign(std::move(times_out), std::move(positions_out),
+               std::move(locations_out), std::move(rotations_out));
 }
 
 Motion Motion::Impl::from_protobuf(proto::Motion const &motion_proto) {
+  if (motion_proto.frames_size() == 0) {
+    invalid_motion();
+  }
+
   std::unordered_set<std::string> joint_names;
   std::unordered_map<std::string, EffectorType> effector_types;
   std::transform(std::cbegin(motion_proto.effector_types()),
@@ -80,44 +226,80 @@ Motion Motion::Impl::from_protobuf(proto::Motion const &motion_proto) {
   }
 
   if (motion_proto.loop() == proto::Motion::Loop::Motion_Loop_Wrap) {
-    m.impl->loop = LoopType::Wrap;
+    m.mutable_impl().loop = LoopType::Wrap;
   } else if (motion_proto.loop() == proto::Motion::Loop::Motion_Loop_None) {
-    m.impl->loop = LoopType::None;
+    m.mutable_impl().loop = LoopType::None;
   }
-  for (auto const &frame_proto : motion_proto.frames()) {
-    std::unordered_map<std::string, double> positions;
-    std::unordered_map<std::string, Effector> effectors;
 
+  // Frames are decoded directly into columns in the layout of the store,
+  // in the order of the message
+  auto const &schema = *m.impl->schema;
+  auto const &joints = schema.joints();
+  auto const &effectors = schema.effectors();
+  auto const &types = m.impl->keyframes().types();
+  auto const nj = joints.size();
+  auto const ne = effectors.size();
+  auto const size = static_cast<std::size_t>(motion_proto.frames_size());
+  std::vector<double> times(size), positions(size * nj),
+      locations(size * ne * 3), rotations(size * ne * 4);
+  for (std::size_t k = 0; k < size; k++) {
+    auto const &frame_proto = motion_proto.frames(static_cast<int>(k));
     auto const &positions_proto = frame_proto.positions();
-    std::copy(std::cbegin(positions_proto), std::cend(positions_proto),
-              std::inserter(positions, std::end(positions)));
     auto const &effectors_proto = frame_proto.effectors();
-    std::transform(
-        std::cbegin(effectors_proto), std::cend(effectors_proto),
-        std::inserter(effectors, std::end(effectors)), [](auto const &p) {
-          auto const &effect_proto = p.second;
-          Effector e;
-          if (effect_proto.has_location()) {
-            e.set_location(
-                proto_util::unpack_location(effect_proto.location().value()));
-          }
-          if (effect_proto.has_rotation()) {
-            e.set_rotation(
-                proto_util::unpack_rotation(effect_proto.rotation().value()));
-          }
-          // TODO: Delete copy
-          return std::make_pair(p.first, e);
-        });
-    m.insert_keyframe(frame_proto.t(), Frame{positions, effectors});
-  }
-
-  if (!m.is_valid()) {
-    throw errors::InvalidFrameError{"while loading parsed motion data"};
-  }
-
-  // copy occurs...
+    // Negative times make the motion invalid, and NaN can't be sorted
+    if (!(frame_proto.t() >= 0) || positions_proto.size() != nj ||
+        effectors_proto.size() != ne) {
+      invalid_motion();
+    }
+    times[k] = frame_proto.t();
+
+    auto *const p = positions.data() + k * nj;
+    for (auto const &[name, v] : positions_proto) {
+      auto const i = joints.find(name);
+      if (!i) {
+        invalid_motion();
+      }
+      p[*i] = v;
+    }
+    auto *const l = locations.data() + k * ne * 3;
+    auto *const r = rotations.data() + k * ne * 4;
+    for (auto const &[name, effector_proto] : effectors_proto) {
+      auto const i = effectors.find(name);
+      if (!i ||
+          effector_proto.has_location() !=
+              static_cast<bool>(types[*i].location()) ||
+          effector_proto.has_rotation() !=
+              static_cast<bool>(types[*i].rotation())) {
+        invalid_motion();
+      }
+      if (effector_proto.has_location()) {
+        auto const v =
+            proto_util::unpack_location(effector_proto.location().value())
+                .vector();
+        l[*i * 3] = v.x();
+        l[*i * 3 + 1] = v.y();
+        l[*i * 3 + 2] = v.z();
+      }
+      if (effector_proto.has_rotation()) {
+        auto const q =
+            proto_util::unpack_rotation(effector_proto.rotation().value())
+                .quaternion();
+        r[*i] = q.w();
+        r[ne + *i] = q.x();
+        r[2 * ne + *i] = q.y();
+        r[3 * ne + *i] = q.z();
+      } else {
+        r[*i] = 1;
+      }
+    }
+  }
+
+  m.mutable_impl().assign_keyframes(std::move(times), std::move(positions),
+                                    std::move(locations),
+                                    std::move(rotations));
   return m;
 }
+
 void Motion::dump(std::ostream &f) const {
   auto const m = this->impl->to_protobuf();
   if (!m.SerializeToOstream(&f)) {
@@ -125,18 +307,20 @@ void Motion::dump(std::ostream &f) const {
   }
 }
 
-void Motion::dump_json(std::ostream &f) const { f << this->dump_json_string(); }
+void Motion::dump_json(std::ostream &f) const {
+  this->dump_json(f, JSONFormat{});
+}
+
+void Motion::dump_json(std::ostream &f, const JSONFormat &format) const {
+  this->impl->to_json(&f, format);
+}
 
 std::string Motion::dump_json_string() const {
-  std::string s;
-  auto const m = this->impl->to_protobuf();
-  google::protobuf::util::JsonPrintOptions opt;
-  opt.always_print_primitive_fields = true;
-  auto const status = google::protobuf::util::MessageToJsonString(m, &s, opt);
-  if (!status.ok()) {
-    throw errors::JSONDumpError(status.ToString());
-  }
-  return s;
+  return this->dump_json_string(JSONFormat{});
+}
+
+std::string Motion::dump_json_string(const JSONFormat &format) const {
+  return this->impl->to_json(nullptr, format);
 }
 
 proto::Motion Motion::Impl::to_protobuf() const {
@@ -159,24 +343,28 @@ proto::Motion Motion::Impl::to_protobuf() const {
   for (auto const &[link, type] : this->effector_types) {
     proto_util::pack_effector_type(type, &(*m.mutable_effector_types())[link]);
   }
-  for (auto const &[t, frame] : this->raw_frames) {
+  auto const &joints = this->schema->joints();
+  auto const &effectors = this->schema->effectors();
+  auto const &types = this->keyframes().types();
+  for (std::size_t k = 0; k < this->keyframes().size(); k++) {
     auto *frame_proto = m.add_frames();
-    frame_proto->set_t(t);
-    // TODO: Use <algorithm> (e.g. std::copy)
-    for (auto const &[joint, change] : frame.positions()) {
-      (*frame_proto->mutable_positions())[joint] = change;
+    frame_proto->set_t(this->keyframes().time(k));
+    auto &positions_proto = *frame_proto->mutable_positions();
+    auto const positions = this->keyframes().positions_at(k);
+    for (std::size_t i = 0; i < joints.size(); i++) {
+      positions_proto[joints.name(i)] = positions[i];
     }
-    for (auto const &[link, effect] : frame.effectors()) {
-      proto::Effector e;
-      if (effect.location()) {
-        proto_util::pack_location(*effect.location(),
+    auto &effectors_proto = *frame_proto->mutable_effectors();
+    for (std::size_t i = 0; i < effectors.size(); i++) {
+      auto &e = effectors_proto[effectors.name(i)];
+      if (types[i].location()) {
+        proto_util::pack_location(this->keyframes().location(k, i),
                                   e.mutable_location()->mutable_value());
       }
-      if (effect.rotation()) {
-        proto_util::pack_rotation(*effect.rotation(),
+      if (types[i].rotation()) {
+        proto_util::pack_rotation(this->keyframes().rotation(k, i),
                                   e.mutable_rotation()->mutable_value());
       }
-      (*frame_proto->mutable_effectors())[link] = e;
     }
   }
 
@@ -0,0 +1,1110 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/compat/charconv.hpp"
+#include "flom/errors.hpp"
+#include "flom/interpolation.hpp"
+#include "flom/motion.hpp"
+#include "flom/motion.impl.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace flom {
+
+// Motions are read from the JSON mapping of motion.proto, as written by
+// protobuf: fields are named in either lowerCamelCase or as in the proto,
+// doubles are numbers or strings (including "NaN" and "[-]Infinity"),
+// enums are names or numbers, and null is the default value.
+//
+// With a name table (JSONFormat::name_table), the motion also has
+//   "jointNames": [names...], "effectorNames": [names...]
+// before "frames", and values of each frame are arrays in that order:
+//   {"t": t, "positions": [values...],
+//    "effectors": [{"location": [x, y, z], "rotation": [w, x, y, z]}...]}
+
+namespace {
+
+// Effector components present in a frame
+constexpr std::uint8_t has_location = 1;
+constexpr std::uint8_t has_rotation = 2;
+
+[[noreturn]] void invalid_frame() {
+  throw errors::InvalidFrameError{"while loading parsed motion data"};
+}
+
+class Parser {
+private:
+  const char *begin;
+  const char *p;
+  const char *end;
+  // Unescaped contents of the last string with escapes
+  std::string buffer;
+
+  void skip_whitespace() noexcept {
+    while (this->p != this->end && (*this->p == ' ' || *this->p == '\n' ||
+                                    *this->p == '\r' || *this->p == '\t')) {
+      this->p++;
+    }
+  }
+
+  double parse_number(const char *first, const char *last) const {
+    double v;
+    auto const [ptr, ec] = compat::from_chars(first, last, v);
+    if (ec != std::errc{} || ptr != last || first == last) {
+      this->error("Invalid number");
+    }
+    return v;
+  }
+
+  unsigned hex4() {
+    if (this->end - this->p < 4) {
+      this->error("Invalid escape");
+    }
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+      auto const c = *this->p++;
+      v <<= 4;
+      if (c >= '0' && c <= '9') {
+        v |= static_cast<unsigned>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        v |= static_cast<unsigned>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        v |= static_cast<unsigned>(c - 'A' + 10);
+      } else {
+        this->error("Invalid escape");
+      }
+    }
+    return v;
+  }
+
+  void put_utf8(unsigned c) {
+    auto const put = [this](unsigned b) {
+      this->buffer.push_back(static_cast<char>(b));
+    };
+    if (c < 0x80) {
+      put(c);
+    } else if (c < 0x800) {
+      put(0xC0 | (c >> 6));
+      put(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      put(0xE0 | (c >> 12));
+      put(0x80 | ((c >> 6) & 0x3F));
+      put(0x80 | (c & 0x3F));
+    } else {
+      put(0xF0 | (c >> 18));
+      put(0x80 | ((c >> 12) & 0x3F));
+      put(0x80 | ((c >> 6) & 0x3F));
+      put(0x80 | (c & 0x3F));
+    }
+  }
+
+  void unescape() {
+    if (this->p == this->end) {
+      this->error("Unterminated string");
+    }
+    switch (*this->p++) {
+    case '"':
+      this->buffer.push_back('"');
+      break;
+    case '\\':
+      this->buffer.push_back('\\');
+      break;
+    case '/':
+      this->buffer.push_back('/');
+      break;
+    case 'b':
+      this->buffer.push_back('\b');
+      break;
+    case 'f':
+      this->buffer.push_back('\f');
+      break;
+    case 'n':
+      this->buffer.push_back('\n');
+      break;
+    case 'r':
+      this->buffer.push_back('\r');
+      break;
+    case 't':
+      this->buffer.push_back('\t');
+      break;
+    case 'u': {
+      auto c = this->hex4();
+      if (c >= 0xD800 && c < 0xDC00) {
+        // A surrogate pair
+        if (this->end - this->p < 2 || this->p[0] != '\\' ||
+            this->p[1] != 'u') {
+          this->error("Invalid escape");
+        }
+        this->p += 2;
+        auto const low = this->hex4();
+        if (low < 0xDC00 || low >= 0xE000) {
+          this->error("Invalid escape");
+        }
+        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+      } else if (c >= 0xDC00 && c < 0xE000) {
+        this->error("Invalid escape");
+      }
+      this->put_utf8(c);
+      break;
+    }
+    default:
+      this->error("Invalid escape");
+    }
+  }
+
+public:
+  Parser(const char *data, std::size_t size) noexcept
+      : begin(data), p(data), end(data + size) {}
+
+  [[noreturn]] void error(const char *message) const {
+    throw errors::JSONLoadError{std::string{message} + " at offset " +
+                                std::to_string(this->p - this->begin)};
+  }
+
+  // Consumes c if it comes next
+  bool consume(char c) noexcept {
+    this->skip_whitespace();
+    if (this->p != this->end && *this->p == c) {
+      this->p++;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!this->consume(c)) {
+      this->error(c == '"' ? "Expected a string" : "Unexpected character");
+    }
+  }
+
+  // Whether c comes next, without consuming it
+  bool next_is(char c) noexcept {
+    this->skip_whitespace();
+    return this->p != this->end && *this->p == c;
+  }
+
+  bool null() noexcept {
+    this->skip_whitespace();
+    if (this->end - this->p >= 4 &&
+        std::string_view{this->p, 4} == std::string_view{"null"}) {
+      this->p += 4;
+      return true;
+    }
+    return false;
+  }
+
+  void finish() {
+    this->skip_whitespace();
+    if (this->p != this->end) {
+      this->error("Unexpected character");
+    }
+  }
+
+  // The result is valid until the next call
+  std::string_view string() {
+    this->expect('"');
+    auto const first = this->p;
+    while (this->p != this->end && *this->p != '"' && *this->p != '\\') {
+      this->p++;
+    }
+    if (this->p == this->end) {
+      this->error("Unterminated string");
+    }
+    if (*this->p == '"') {
+      return {first, static_cast<std::size_t>(this->p++ - first)};
+    }
+
+    this->buffer.assign(first, this->p);
+    while (true) {
+      if (this->p == this->end) {
+        this->error("Unterminated string");
+      }
+      auto const c = *this->p++;
+      if (c == '"') {
+        return this->buffer;
+      } else if (c == '\\') {
+        this->unescape();
+      } else {
+        this->buffer.push_back(c);
+      }
+    }
+  }
+
+  double number() {
+    if (this->null()) {
+      return 0;
+    }
+    if (this->consume('"')) {
+      auto const first = this->p;
+      while (this->p != this->end && *this->p != '"') {
+        this->p++;
+      }
+      if (this->p == this->end) {
+        this->error("Unterminated string");
+      }
+      std::string_view const s{first,
+                               static_cast<std::size_t>(this->p++ - first)};
+      if (s == "NaN") {
+        return std::numeric_limits<double>::quiet_NaN();
+      } else if (s == "Infinity") {
+        return std::numeric_limits<double>::infinity();
+      } else if (s == "-Infinity") {
+        return -std::numeric_limits<double>::infinity();
+      }
+      return this->parse_number(first, first + s.size());
+    }
+
+    auto const first = this->p;
+    while (this->p != this->end &&
+           ((*this->p >= '0' && *this->p <= '9') || *this->p == '-' ||
+            *this->p == '+' || *this->p == '.' || *this->p == 'e' ||
+            *this->p == 'E')) {
+      this->p++;
+    }
+    return this->parse_number(first, this->p);
+  }
+
+  // Enum values are given by names or numbers
+  template <std::size_t N>
+  std::size_t enumeration(const std::string_view (&names)[N]) {
+    if (this->null()) {
+      return 0;
+    }
+    this->skip_whitespace();
+    if (this->p != this->end && *this->p == '"') {
+      auto const name = this->string();
+      for (std::size_t i = 0; i < N; i++) {
+        if (name == names[i]) {
+          return i;
+        }
+      }
+      this->error("Unknown enum value");
+    }
+    auto const v = this->number();
+    if (!(v >= 0 && v < static_cast<double>(N)) ||
+        v != static_cast<double>(static_cast<std::size_t>(v))) {
+      this->error("Unknown enum value");
+    }
+    return static_cast<std::size_t>(v);
+  }
+
+  // Calls f(key) for each member, which must consume the value.
+  // Returns false if the object is null.
+  template <typename F> bool object(F &&f) {
+    if (this->null()) {
+      return false;
+    }
+    this->expect('{');
+    if (this->consume('}')) {
+      return true;
+    }
+    do {
+      auto const key = this->string();
+      this->expect(':');
+      f(key);
+    } while (this->consume(','));
+    this->expect('}');
+    return true;
+  }
+
+  // Calls f() for each element, which must consume it
+  template <typename F> void array(F &&f) {
+    if (this->null()) {
+      return;
+    }
+    this->expect('[');
+    if (this->consume(']')) {
+      return;
+    }
+    do {
+      f();
+    } while (this->consume(','));
+    this->expect(']');
+  }
+
+  // Reads an array of exactly n numbers
+  void numbers(double *out, std::size_t n) {
+    std::size_t i = 0;
+    this->array([&] {
+      if (i == n) {
+        this->error("Too many elements");
+      }
+      out[i++] = this->number();
+    });
+    if (i != n) {
+      this->error("Too few elements");
+    }
+  }
+
+  [[noreturn]] void unknown_field() const { this->error("Unknown field"); }
+};
+
+bool is_field(std::string_view key, std::string_view name) noexcept {
+  return key == name;
+}
+
+bool is_field(std::string_view key, std::string_view json_name,
+              std::string_view proto_name) noexcept {
+  return key == json_name || key == proto_name;
+}
+
+// Names in the order of their first appearance
+class NameOrder {
+private:
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, std::size_t> index;
+
+public:
+  const std::vector<std::string> &names() const noexcept {
+    return this->names_;
+  }
+  std::size_t size() const noexcept { return this->names_.size(); }
+
+  compat::optional<std::size_t> find(std::string_view name,
+                                     std::size_t hint) const {
+    // Names usually come in the same order in every frame
+    if (hint < this->names_.size() && this->names_[hint] == name) {
+      return hint;
+    }
+    auto const it = this->index.find(std::string{name});
+    if (it == std::cend(this->index)) {
+      return compat::nullopt;
+    }
+    return it->second;
+  }
+
+  std::size_t insert(std::string_view name) {
+    auto const [it, inserted] =
+        this->index.emplace(std::string{name}, this->names_.size());
+    if (inserted) {
+      this->names_.emplace_back(name);
+    }
+    return it->second;
+  }
+};
+
+// Frames are decoded into rows in the order of names in the name table
+// or the first frame
+class MotionBuilder {
+private:
+  Parser parser;
+
+  std::string model_id;
+  LoopType loop = LoopType::None;
+  std::unordered_map<std::string, EffectorType> effector_types;
+  std::vector<std::pair<std::string, EffectorWeight>> effector_weights;
+
+  NameOrder joints;
+  NameOrder effectors;
+  // Whether names are given in "jointNames" and "effectorNames"
+  bool joint_table = false;
+  bool effector_table = false;
+
+  //   positions:  [keyframes x joints]
+  //   locations:  [keyframes x effectors x 3] (x, y, z)
+  //   rotations:  [keyframes x effectors x 4] (w, x, y, z)
+  //   components: [keyframes x effectors]
+  std::vector<double> times;
+  std::vector<double> positions;
+  std::vector<double> locations;
+  std::vector<double> rotations;
+  std::vector<std::uint8_t> components;
+
+  // Index of the frame where each name was last seen, plus one,
+  // to find missing names
+  std::vector<std::size_t> joint_seen;
+  std::vector<std::size_t> effector_seen;
+
+  static constexpr std::string_view coordinate_systems[] = {"None", "World",
+                                                            "Local"};
+  static constexpr std::string_view loop_types[] = {"None", "Wrap"};
+
+  static compat::optional<CoordinateSystem>
+  coordinate_system(std::size_t v) noexcept {
+    if (v == 1) {
+      return CoordinateSystem::World;
+    } else if (v == 2) {
+      return CoordinateSystem::Local;
+    }
+    return compat::nullopt;
+  }
+
+  EffectorType effector_type() {
+    compat::optional<CoordinateSystem> location, rotation;
+    this->parser.object([&](std::string_view key) {
+      if (is_field(key, "location")) {
+        location = coordinate_system(
+            this->parser.enumeration(coordinate_systems));
+      } else if (is_field(key, "rotation")) {
+        rotation = coordinate_system(
+            this->parser.enumeration(coordinate_systems));
+      } else {
+        this->parser.unknown_field();
+      }
+    });
+    return {location, rotation};
+  }
+
+  EffectorWeight effector_weight() {
+    double location = 0, rotation = 0;
+    this->parser.object([&](std::string_view key) {
+      if (is_field(key, "location")) {
+        location = this->parser.number();
+      } else if (is_field(key, "rotation")) {
+        rotation = this->parser.number();
+      } else {
+        this->parser.unknown_field();
+      }
+    });
+    return {location, rotation};
+  }
+
+  // Reads {"w": .., "x": .., ...} into the components named in order
+  void components_of(std::string_view names, double *out) {
+    this->parser.object([&](std::string_view key) {
+      auto const c =
+          key.size() == 1 ? names.find(key.front()) : std::string_view::npos;
+      if (c == std::string_view::npos) {
+        this->parser.unknown_field();
+      }
+      out[c] = this->parser.number();
+    });
+  }
+
+  // Reads {"value": {name: {...}}}, returning if it is set
+  bool optional_value(std::string_view name, std::string_view fields,
+                      double *out) {
+    return this->parser.object([&](std::string_view key) {
+      if (!is_field(key, "value")) {
+        this->parser.unknown_field();
+      }
+      this->parser.object([&](std::string_view inner) {
+        if (!is_field(inner, name)) {
+          this->parser.unknown_field();
+        }
+        this->components_of(fields, out);
+      });
+    });
+  }
+
+  void frame() {
+    auto const k = this->times.size();
+    auto const stamp = k + 1;
+    // The first frame names joints and effectors unless given in a table
+    auto const define_joints = k == 0 && !this->joint_table;
+    auto const define_effectors = k == 0 && !this->effector_table;
+    std::size_t num_positions = 0, num_effectors = 0;
+    double t = 0;
+
+    this->positions.resize(this->positions.size() + this->joints.size(), 0);
+    this->locations.resize(
+        this->locations.size() + this->effectors.size() * 3, 0);
+    this->rotations.resize(
+        this->rotations.size() + this->effectors.size() * 4, 0);
+    this->components.resize(this->components.size() + this->effectors.size(),
+                            0);
+
+    // Finds the index of a name, or adds one if defining names
+    auto const index = [&](NameOrder &names, std::vector<std::size_t> &seen,
+                           bool define, std::string_view name,
+                           std::size_t hint) {
+      compat::optional<std::size_t> i;
+      if (define) {
+        i = names.insert(name);
+        seen.resize(names.size(), 0);
+      } else {
+        i = names.find(name, hint);
+      }
+      if (!i) {
+        invalid_frame();
+      }
+      return *i;
+    };
+    // Counts each name once in the frame
+    auto const count = [stamp](std::vector<std::size_t> &seen, std::size_t i,
+                               std::size_t &n) {
+      if (seen[i] != stamp) {
+        seen[i] = stamp;
+        n++;
+      }
+    };
+
+    this->parser.object([&](std::string_view key) {
+      if (is_field(key, "t")) {
+        t = this->parser.number();
+      } else if (is_field(key, "positions")) {
+        if (this->parser.next_is('[')) {
+          if (!this->joint_table) {
+            this->parser.error("Positions in an array without jointNames");
+          }
+          std::size_t i = 0;
+          this->parser.array([&] {
+            if (i == this->joints.size()) {
+              invalid_frame();
+            }
+            count(this->joint_seen, i, num_positions);
+            this->positions[k * this->joints.size() + i++] =
+                this->parser.number();
+          });
+          return;
+        }
+        std::size_t hint = 0;
+        this->parser.object([&](std::string_view name) {
+          auto const i = index(this->joints, this->joint_seen, define_joints,
+                               name, hint);
+          if (define_joints) {
+            this->positions.resize(this->joints.size());
+          }
+          hint = i + 1;
+          count(this->joint_seen, i, num_positions);
+          this->positions[k * this->joints.size() + i] = this->parser.number();
+        });
+      } else if (is_field(key, "effectors")) {
+        if (this->parser.next_is('[')) {
+          if (!this->effector_table) {
+            this->parser.error("Effectors in an array without effectorNames");
+          }
+          std::size_t i = 0;
+          this->parser.array([&] {
+            if (i == this->effectors.size()) {
+              invalid_frame();
+            }
+            count(this->effector_seen, i, num_effectors);
+            this->effector(k * this->effectors.size() + i++);
+          });
+          return;
+        }
+        std::size_t hint = 0;
+        this->parser.object([&](std::string_view name) {
+          auto const i = index(this->effectors, this->effector_seen,
+                               define_effectors, name, hint);
+          if (define_effectors) {
+            auto const size = this->effectors.size();
+            this->locations.resize(size * 3, 0);
+            this->rotations.resize(size * 4, 0);
+            this->components.resize(size, 0);
+          }
+          hint = i + 1;
+          count(this->effector_seen, i, num_effectors);
+          this->effector(k * this->effectors.size() + i);
+        });
+      } else {
+        this->parser.unknown_field();
+      }
+    });
+
+    if (num_positions != this->joints.size() ||
+        num_effectors != this->effectors.size()) {
+      invalid_frame();
+    }
+    this->times.push_back(t);
+  }
+
+  void effector(std::size_t i) {
+    auto const location = &this->locations[i * 3];
+    auto const rotation = &this->rotations[i * 4];
+    std::uint8_t present = 0;
+    std::fill_n(location, 3, 0);
+    std::fill_n(rotation, 4, 0);
+    // Components are arrays with a name table, or wrapped in messages
+    auto const component = [&](std::uint8_t bit, std::string_view name,
+                               std::string_view fields, double *out) {
+      auto const set =
+          this->parser.next_is('[')
+              ? (this->parser.numbers(out, fields.size()), true)
+              : this->optional_value(name, fields, out);
+      if (set) {
+        present |= bit;
+      } else {
+        present &= static_cast<std::uint8_t>(~bit);
+      }
+    };
+    this->parser.object([&](std::string_view key) {
+      if (is_field(key, "location")) {
+        component(has_location, "vector", "xyz", location);
+      } else if (is_field(key, "rotation")) {
+        component(has_rotation, "quaternion", "wxyz", rotation);
+      } else {
+        this->parser.unknown_field();
+      }
+    });
+    if ((present & has_rotation) != 0) {
+      auto const q =
+          Rotation{rotation[0], rotation[1], rotation[2], rotation[3]}
+              .quaternion();
+      rotation[0] = q.w();
+      rotation[1] = q.x();
+      rotation[2] = q.y();
+      rotation[3] = q.z();
+    } else {
+      rotation[0] = 1;
+      rotation[1] = rotation[2] = rotation[3] = 0;
+    }
+    if ((present & has_location) == 0) {
+      std::fill_n(location, 3, 0);
+    }
+    this->components[i] = present;
+  }
+
+  // Reads names of a table, which must come before frames
+  void name_table(NameOrder &names, std::vector<std::size_t> &seen,
+                  bool &table) {
+    if (!this->times.empty() || table) {
+      this->parser.error("Name table after frames");
+    }
+    table = true;
+    this->parser.array([&] {
+      auto const size = names.size();
+      if (names.insert(this->parser.string()) != size) {
+        invalid_frame();
+      }
+    });
+    seen.resize(names.size(), 0);
+  }
+
+public:
+  MotionBuilder(const char *data, std::size_t size) : parser(data, size) {}
+
+  void parse() {
+    this->parser.object([&](std::string_view key) {
+      if (is_field(key, "modelId", "model_id")) {
+        if (!this->parser.null()) {
+          this->model_id = this->parser.string();
+        }
+      } else if (is_field(key, "loop")) {
+        this->loop = this->parser.enumeration(loop_types) == 1
+                         ? LoopType::Wrap
+                         : LoopType::None;
+      } else if (is_field(key, "effectorTypes", "effector_types")) {
+        this->parser.object([&](std::string_view name) {
+          std::string n{name};
+          this->effector_types.insert_or_assign(std::move(n),
+                                                this->effector_type());
+        });
+      } else if (is_field(key, "jointNames", "joint_names")) {
+        this->name_table(this->joints, this->joint_seen, this->joint_table);
+      } else if (is_field(key, "effectorNames", "effector_names")) {
+        this->name_table(this->effectors, this->effector_seen,
+                         this->effector_table);
+      } else if (is_field(key, "frames")) {
+        this->parser.array([&] { this->frame(); });
+      } else if (is_field(key, "effectorWeights", "effector_weights")) {
+        this->parser.object([&](std::string_view name) {
+          std::string n{name};
+          this->effector_weights.emplace_back(std::move(n),
+                                              this->effector_weight());
+        });
+      } else {
+        this->parser.unknown_field();
+      }
+    });
+    this->parser.finish();
+  }
+
+  // Validates frames, returning a motion with the initial keyframe only
+  Motion motion() const {
+    auto const size = this->times.size();
+    if (size == 0) {
+      invalid_frame();
+    }
+
+    auto const &effector_names = this->effectors.names();
+    if (effector_names.size() != this->effector_types.size()) {
+      invalid_frame();
+    }
+    std::vector<EffectorType> types;
+    types.reserve(effector_names.size());
+    for (auto const &name : effector_names) {
+      auto const it = this->effector_types.find(name);
+      if (it == std::cend(this->effector_types)) {
+        invalid_frame();
+      }
+      types.push_back(it->second);
+    }
+
+    auto const ne = effector_names.size();
+    for (std::size_t k = 0; k < size; k++) {
+      // Negative times make the motion invalid, and NaN can't be sorted
+      if (!(this->times[k] >= 0)) {
+        invalid_frame();
+      }
+      for (std::size_t i = 0; i < ne; i++) {
+        auto const present = this->components[k * ne + i];
+        if (((present & has_location) != 0) !=
+                static_cast<bool>(types[i].location()) ||
+            ((present & has_rotation) != 0) !=
+                static_cast<bool>(types[i].rotation())) {
+          invalid_frame();
+        }
+      }
+    }
+
+    auto const &joint_names = this->joints.names();
+    Motion m{{std::cbegin(joint_names), std::cend(joint_names)},
+             this->effector_types, this->model_id};
+    m.set_loop(this->loop);
+    for (auto const &[name, weight] : this->effector_weights) {
+      if (this->effector_types.count(name) == 0) {
+        this->parser.error("Unknown effector in effectorWeights");
+      }
+      m.set_effector_weight(name, weight);
+    }
+    return m;
+  }
+
+  // Columns of the keyframes in the schema of the motion returned by motion()
+  ColumnOrder column_order(const FrameSchema &schema) const {
+    ColumnOrder order;
+    for (auto const &name : this->joints.names()) {
+      order.joints.push_back(*schema.joints().find(name));
+    }
+    for (auto const &name : this->effectors.names()) {
+      order.effectors.push_back(*schema.effectors().find(name));
+    }
+    return order;
+  }
+
+  // Moves out keyframes in the order of names in the input
+  auto take_keyframes() {
+    return std::make_tuple(std::move(this->times), std::move(this->positions),
+                           std::move(this->locations),
+                           std::move(this->rotations));
+  }
+};
+
+// Writes JSON into a buffer, which is flushed to the stream in chunks
+class Writer {
+private:
+  static constexpr std::size_t chunk_size = 1 << 16;
+
+  std::ostream *os;
+  std::string buffer;
+
+public:
+  explicit Writer(std::ostream *os_) : os(os_) {
+    if (this->os) {
+      this->buffer.reserve(chunk_size * 2);
+    }
+  }
+
+  void put(char c) { this->buffer.push_back(c); }
+  void put(std::string_view s) { this->buffer.append(s); }
+
+  // Doubles are written in the shortest form which reads back exactly
+  void number(double v) {
+    if (std::isnan(v)) {
+      this->put("\"NaN\"");
+    } else if (std::isinf(v)) {
+      this->put(v > 0 ? "\"Infinity\"" : "\"-Infinity\"");
+    } else {
+      char s[32];
+      auto const result = compat::to_chars(std::begin(s), std::end(s), v);
+      this->buffer.append(s, result.ptr);
+    }
+  }
+
+  void string(std::string_view s) {
+    this->put('"');
+    for (auto const c : s) {
+      switch (c) {
+      case '"':
+        this->put("\\\"");
+        break;
+      case '\\':
+        this->put("\\\\");
+        break;
+      case '\b':
+        this->put("\\b");
+        break;
+      case '\f':
+        this->put("\\f");
+        break;
+      case '\n':
+        this->put("\\n");
+        break;
+      case '\r':
+        this->put("\\r");
+        break;
+      case '\t':
+        this->put("\\t");
+        break;
+      default:
+        if (auto const u = static_cast<unsigned char>(c); u < 0x20) {
+          char const hex[] = "0123456789abcdef";
+          this->put("\\u00");
+          this->put(hex[u >> 4]);
+          this->put(hex[u & 0xF]);
+        } else {
+          this->put(c);
+        }
+      }
+    }
+    this->put('"');
+  }
+
+  void key(std::string_view k) {
+    this->string(k);
+    this->put(':');
+  }
+
+  // Same as key, for a key encoded in advance
+  void encoded_key(const std::string &k) { this->put(k); }
+
+  std::string encode_key(std::string_view k) {
+    auto const size = this->buffer.size();
+    this->key(k);
+    std::string encoded = this->buffer.substr(size);
+    this->buffer.resize(size);
+    return encoded;
+  }
+
+  // Writes out the buffer if it is full
+  void flush_if_full() {
+    if (this->os && this->buffer.size() >= chunk_size) {
+      this->flush();
+    }
+  }
+
+  void flush() {
+    if (this->os) {
+      this->os->write(this->buffer.data(),
+                      static_cast<std::streamsize>(this->buffer.size()));
+      this->buffer.clear();
+      if (!*this->os) {
+        throw errors::JSONDumpError{"Failed to write to the stream"};
+      }
+    }
+  }
+
+  std::string take() { return std::move(this->buffer); }
+};
+
+std::string_view coordinate_system_name(
+    const compat::optional<CoordinateSystem> &c) noexcept {
+  if (!c) {
+    return "\"None\"";
+  }
+  return *c == CoordinateSystem::World ? "\"World\"" : "\"Local\"";
+}
+
+} // namespace
+
+Motion Motion::Impl::from_json(const char *data, std::size_t size) {
+  MotionBuilder builder{data, size};
+  builder.parse();
+  auto m = builder.motion();
+  auto &impl = m.mutable_impl();
+  auto const order = builder.column_order(*impl.schema);
+  auto [times, positions, locations, rotations] = builder.take_keyframes();
+  impl.assign_keyframes(std::move(times), std::move(positions),
+                        std::move(locations), std::move(rotations), &order);
+  return m;
+}
+
+std::string Motion::Impl::to_json(std::ostream *os,
+                                  const JSONFormat &format) const {
+  if (!this->is_valid()) {
+    throw errors::InvalidFrameError{
+        "converting motion data before serializaion"};
+  }
+
+  auto const &keyframes = this->keyframes();
+  auto const &joint_names = this->schema->joints().names();
+  auto const &effector_names = this->schema->effectors().names();
+  auto const &types = keyframes.types();
+  auto const nj = keyframes.num_joints();
+  auto const ne = keyframes.num_effectors();
+
+  // Fields in the order of motion.proto, as protobuf writes them
+  Writer out{os};
+  out.put('{');
+  out.key("modelId");
+  out.string(this->model_id);
+  out.put(',');
+  out.key("loop");
+  out.put(this->loop == LoopType::Wrap ? "\"Wrap\"" : "\"None\"");
+  out.put(',');
+  out.key("effectorTypes");
+  out.put('{');
+  for (std::size_t i = 0; i < ne; i++) {
+    if (i != 0) {
+      out.put(',');
+    }
+    out.key(effector_names[i]);
+    out.put("{\"location\":");
+    out.put(coordinate_system_name(types[i].location()));
+    out.put(",\"rotation\":");
+    out.put(coordinate_system_name(types[i].rotation()));
+    out.put('}');
+  }
+  out.put("},");
+
+  auto const weights = [&] {
+    out.key("effectorWeights");
+    out.put('{');
+    for (std::size_t i = 0; i < ne; i++) {
+      if (i != 0) {
+        out.put(',');
+      }
+      auto const &weight = this->effector_weights.at(effector_names[i]);
+      out.key(effector_names[i]);
+      out.put("{\"location\":");
+      out.number(weight.location());
+      out.put(",\"rotation\":");
+      out.number(weight.rotation());
+      out.put('}');
+    }
+    out.put('}');
+  };
+  if (format.name_table) {
+    weights();
+    out.put(',');
+    auto const table = [&](std::string_view key, auto const &names) {
+      out.key(key);
+      out.put('[');
+      for (std::size_t i = 0; i < names.size(); i++) {
+        if (i != 0) {
+          out.put(',');
+        }
+        out.string(names[i]);
+      }
+      out.put("],");
+    };
+    table("jointNames", joint_names);
+    table("effectorNames", effector_names);
+  }
+
+  // Keys of names in each frame
+  std::vector<std::string> joint_keys, effector_keys;
+  if (!format.name_table) {
+    for (auto const &name : joint_names) {
+      joint_keys.push_back(out.encode_key(name));
+    }
+    for (auto const &name : effector_names) {
+      effector_keys.push_back(out.encode_key(name));
+    }
+  }
+
+  out.key("frames");
+  out.put('[');
+  for (std::size_t k = 0; k < keyframes.size(); k++) {
+    if (k != 0) {
+      out.put(',');
+    }
+    auto const positions = keyframes.positions_at(k);
+    auto const locations = keyframes.locations_at(k);
+    auto const rotations = keyframes.rotations_at(k);
+
+    out.put("{\"t\":");
+    out.number(keyframes.time(k));
+    out.put(format.name_table ? ",\"positions\":[" : ",\"positions\":{");
+    for (std::size_t i = 0; i < nj; i++) {
+      if (i != 0) {
+        out.put(',');
+      }
+      if (!format.name_table) {
+        out.encoded_key(joint_keys[i]);
+      }
+      out.number(positions[i]);
+    }
+    out.put(format.name_table ? "],\"effectors\":[" : "},\"effectors\":{");
+    for (std::size_t i = 0; i < ne; i++) {
+      if (i != 0) {
+        out.put(',');
+      }
+      if (!format.name_table) {
+        out.encoded_key(effector_keys[i]);
+      }
+      out.put('{');
+      if (types[i].location()) {
+        auto const l = locations + i * 3;
+        if (format.name_table) {
+          out.put("\"location\":[");
+          out.number(l[0]);
+          out.put(',');
+          out.number(l[1]);
+          out.put(',');
+          out.number(l[2]);
+          out.put(']');
+        } else {
+          out.put("\"location\":{\"value\":{\"vector\":{\"x\":");
+          out.number(l[0]);
+          out.put(",\"y\":");
+          out.number(l[1]);
+          out.put(",\"z\":");
+          out.number(l[2]);
+          out.put("}}}");
+        }
+      }
+      if (types[i].rotation()) {
+        if (types[i].location()) {
+          out.put(',');
+        }
+        auto const r = planar_quaternions(rotations, ne);
+        if (format.name_table) {
+          out.put("\"rotation\":[");
+          out.number(r.w[i]);
+          out.put(',');
+          out.number(r.x[i]);
+          out.put(',');
+          out.number(r.y[i]);
+          out.put(',');
+          out.number(r.z[i]);
+          out.put(']');
+        } else {
+          out.put("\"rotation\":{\"value\":{\"quaternion\":{\"w\":");
+          out.number(r.w[i]);
+          out.put(",\"x\":");
+          out.number(r.x[i]);
+          out.put(",\"y\":");
+          out.number(r.y[i]);
+          out.put(",\"z\":");
+          out.number(r.z[i]);
+          out.put("}}}");
+        }
+      }
+      out.put('}');
+    }
+    out.put(format.name_table ? "]}" : "}}");
+    out.flush_if_full();
+  }
+  out.put(']');
+
+  if (!format.name_table) {
+    out.put(',');
+    weights();
+  }
+  out.put('}');
+  out.flush();
+  return out.take();
+}
+
+} // namespace flom
@@ -0,0 +1,80 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/motion_loader.hpp"
+#include "flom/errors.hpp"
+#include "flom/mapped_file.hpp"
+#include "flom/motion.impl.hpp"
+
+#include "motion.pb.h"
+
+#include <google/protobuf/arena.h>
+
+namespace flom {
+
+namespace {
+
+// Calls parse(arena) with an arena starting with the block,
+// then grows the block to the size the arena used
+template <typename F>
+Motion load_in(std::unique_ptr<char[]> &block, std::size_t &block_size,
+               google::protobuf::ArenaOptions options, F &&parse) {
+  std::size_t used = 0;
+  auto motion = [&] {
+    options.initial_block = block.get();
+    options.initial_block_size = block_size;
+
+    google::protobuf::Arena arena{options};
+    auto m = parse(arena);
+    used = static_cast<std::size_t>(arena.SpaceAllocated());
+    return m;
+  }();
+
+  // The arena is gone, so the block can be replaced now
+  if (used > block_size) {
+    block.reset(new char[used]);
+    block_size = used;
+  }
+  return motion;
+}
+
+} // namespace
+
+Motion MotionLoader::load(std::istream &f) {
+  return load_in(this->block, this->block_size, Motion::Impl::arena_options(),
+                 [this, &f](google::protobuf::Arena &arena) {
+                   return Motion::Impl::parse(f, arena, this->pool);
+                 });
+}
+
+Motion MotionLoader::load_file(const std::string &path, bool populate) {
+  MappedFile const file{path, populate};
+  return load_in(this->block, this->block_size, Motion::Impl::arena_options(),
+                 [this, &file](google::protobuf::Arena &arena) {
+                   return Motion::Impl::parse(file.data(), file.size(), arena,
+                                              this->pool);
+                 });
+}
+
+void MotionLoader::shrink_to_fit() noexcept {
+  this->block.reset();
+  this->block_size = 0;
+}
+
+} // namespace flom
@@ -0,0 +1,452 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/motion_reader.hpp"
+#include "flom/compat/optional.hpp"
+#include "flom/errors.hpp"
+#include "flom/motion.impl.hpp"
+#include "flom/motion_reader.impl.hpp"
+#include "flom/proto_util.hpp"
+#include "flom/thread_pool.hpp"
+
+#include "motion.pb.h"
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace flom {
+
+namespace wire {
+
+void parse_error() { throw errors::ParseError{}; }
+
+bool is_length_delimited(std::uint32_t tag) {
+  return WireFormatLite::GetTagWireType(tag) ==
+         WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+}
+
+bool is_double(std::uint32_t tag) {
+  return WireFormatLite::GetTagWireType(tag) ==
+         WireFormatLite::WIRETYPE_FIXED64;
+}
+
+double read_double(CodedInputStream &in) {
+  double v;
+  if (!WireFormatLite::ReadPrimitive<double, WireFormatLite::TYPE_DOUBLE>(
+          &in, &v)) {
+    parse_error();
+  }
+  return v;
+}
+
+void read_string(CodedInputStream &in, std::string &s) {
+  if (!WireFormatLite::ReadString(&in, &s)) {
+    parse_error();
+  }
+}
+
+namespace {
+
+// Reads n doubles in fields 1 to n of a message nested in `depth` messages
+// of a single field 1, i.e. Location and Rotation in their wrappers
+void read_nested(CodedInputStream &in, int depth, double *v, int n) {
+  read_message(in, [&](int field, std::uint32_t tag) {
+    if (depth > 0 && field == 1 && is_length_delimited(tag)) {
+      read_nested(in, depth - 1, v, n);
+      return true;
+    }
+    if (depth == 0 && field >= 1 && field <= n && is_double(tag)) {
+      v[field - 1] = read_double(in);
+      return true;
+    }
+    return false;
+  });
+}
+
+bool has_same_names(const NameTable &a, const NameTable &b) {
+  return a.size() == b.size() &&
+         std::all_of(std::cbegin(a.names()), std::cend(a.names()),
+                     [&b](auto const &name) {
+                       return static_cast<bool>(b.find(name));
+                     });
+}
+
+} // namespace
+
+Effector read_effector(CodedInputStream &in) {
+  Effector e;
+  read_message(in, [&](int field, std::uint32_t tag) {
+    if (!is_length_delimited(tag)) {
+      return false;
+    }
+    if (field == fields::effector_location) {
+      // LocationValue { Location { Vec3 } }
+      double v[3] = {};
+      read_nested(in, 2, v, 3);
+      e.set_location(Location{v[0], v[1], v[2]});
+      return true;
+    }
+    if (field == fields::effector_rotation) {
+      // RotationValue { Rotation { Quaternion } }
+      double v[4] = {};
+      read_nested(in, 2, v, 4);
+      e.set_rotation(Rotation{v[0], v[1], v[2], v[3]});
+      return true;
+    }
+    return false;
+  });
+  return e;
+}
+
+std::pair<double, Frame> read_frame(CodedInputStream &in, std::string &key) {
+  std::unordered_map<std::string, double> positions;
+  std::unordered_map<std::string, Effector> effectors;
+  auto const t = read_frame(
+      in, key, [&](auto const &name, double v) { positions[name] = v; },
+      [&](auto const &name, auto const &e) { effectors[name] = e; });
+  return {t, Frame{std::move(positions), std::move(effectors)}};
+}
+
+FrameDecoder::FrameDecoder(std::shared_ptr<const FrameSchema> schema_,
+                           std::vector<EffectorType> types_)
+    : schema(std::move(schema_)), types(std::move(types_)),
+      seen_joints(this->schema->joints().size()),
+      seen_effectors(this->schema->effectors().size()) {}
+
+double FrameDecoder::read(CodedInputStream &in, Frame &frame) {
+  auto const &joints = this->schema->joints();
+  auto const &effectors = this->schema->effectors();
+  auto const positions = frame.position_data();
+  auto const e = frame.effector_data();
+  std::fill(std::begin(this->seen_joints), std::end(this->seen_joints), 0);
+  std::fill(std::begin(this->seen_effectors), std::end(this->seen_effectors),
+            0);
+  auto const index = [](auto const &names, auto const &name) {
+    auto const i = names.find(name);
+    if (!i) {
+      throw errors::InvalidFrameError{"while reading keyframes"};
+    }
+    return *i;
+  };
+
+  auto const t = read_frame(
+      in, this->key,
+      [&](auto const &name, double v) {
+        auto const i = index(joints, name);
+        positions[i] = v;
+        this->seen_joints[i] = 1;
+      },
+      [&](auto const &name, auto const &effector) {
+        auto const i = index(effectors, name);
+        e[i] = effector;
+        this->seen_effectors[i] = 1;
+      });
+
+  auto const all = [](auto const &seen) {
+    return std::all_of(std::cbegin(seen), std::cend(seen),
+                       [](char c) { return c != 0; });
+  };
+  if (!all(this->seen_joints) || !all(this->seen_effectors)) {
+    throw errors::InvalidFrameError{"while reading keyframes"};
+  }
+  for (std::size_t i = 0; i < this->types.size(); i++) {
+    if (!this->types[i].is_compatible(e[i])) {
+      throw errors::InvalidFrameError{"while reading keyframes"};
+    }
+  }
+  return t;
+}
+
+Frame FrameDecoder::bind(const Frame &frame) const {
+  auto const &names = *frame.schema();
+  if (!has_same_names(names.joints(), this->schema->joints()) ||
+      !has_same_names(names.effectors(), this->schema->effectors())) {
+    throw errors::InvalidFrameError{"while reading keyframes"};
+  }
+
+  auto bound = frame.rebind(this->schema);
+  auto const e = bound.effector_data();
+  for (std::size_t i = 0; i < this->types.size(); i++) {
+    if (!this->types[i].is_compatible(e[i])) {
+      throw errors::InvalidFrameError{"while reading keyframes"};
+    }
+  }
+  return bound;
+}
+
+} // namespace wire
+
+namespace {
+
+using wire::CodedInputStream;
+using wire::WireFormatLite;
+namespace fields = wire::fields;
+
+// Reads a field of a motion other than frames into the header.
+// Returns false to skip the field.
+bool read_header_field(CodedInputStream &in, int field, std::uint32_t tag,
+                       MotionHeader &header, std::string &key,
+                       std::string &buffer) {
+  switch (field) {
+  case fields::model_id:
+    if (!wire::is_length_delimited(tag)) {
+      return false;
+    }
+    wire::read_string(in, header.model_id);
+    return true;
+  case fields::loop: {
+    std::uint32_t v;
+    if (WireFormatLite::GetTagWireType(tag) !=
+        WireFormatLite::WIRETYPE_VARINT) {
+      return false;
+    }
+    if (!in.ReadVarint32(&v)) {
+      wire::parse_error();
+    }
+    auto const wrap =
+        static_cast<std::uint32_t>(proto::Motion::Loop::Motion_Loop_Wrap);
+    header.loop = v == wrap ? LoopType::Wrap : LoopType::None;
+    return true;
+  }
+  case fields::effector_types: {
+    if (!wire::is_length_delimited(tag)) {
+      return false;
+    }
+    proto::EffectorType type_proto;
+    wire::read_message_entry(in, key, buffer, type_proto);
+    header.effector_types.insert_or_assign(
+        key, proto_util::unpack_effector_type(type_proto));
+    return true;
+  }
+  case fields::effector_weights: {
+    if (!wire::is_length_delimited(tag)) {
+      return false;
+    }
+    proto::EffectorWeight weight_proto;
+    wire::read_message_entry(in, key, buffer, weight_proto);
+    header.effector_weights.insert_or_assign(
+        key, proto_util::unpack_effector_weight(weight_proto));
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// Reads a motion, calling begin(header, first frame) when the first frame
+// is read. begin returns a frame whose schema is used for all frames,
+// which are then passed to f(t, frame).
+template <typename B, typename F>
+MotionHeader read_motion(std::istream &is, B &&begin, F &&f) {
+  google::protobuf::io::IstreamInputStream stream{&is};
+  CodedInputStream in{&stream};
+
+  MotionHeader header;
+  std::string key, buffer;
+
+  // Set up when the first frame is read
+  compat::optional<Frame> frame;
+  compat::optional<wire::FrameDecoder> decoder;
+
+  wire::read_fields(in, [&](int field, std::uint32_t tag) {
+    if (field != fields::frames || !wire::is_length_delimited(tag)) {
+      if (field == fields::effector_types && frame &&
+          wire::is_length_delimited(tag)) {
+        // Layout of frames is already fixed
+        wire::parse_error();
+      }
+      return read_header_field(in, field, tag, header, key, buffer);
+    }
+
+    double t;
+    if (frame) {
+      t = decoder->read(in, *frame);
+    } else {
+      auto [first_t, first] = wire::read_frame(in, key);
+      frame = begin(header, static_cast<const Frame &>(first));
+      auto const &schema = frame->schema();
+      decoder.emplace(schema, types_in(*schema, header.effector_types));
+      *frame = decoder->bind(first);
+      t = first_t;
+    }
+    f(t, static_cast<const Frame &>(*frame));
+    return true;
+  });
+
+  if (!frame) {
+    throw errors::InvalidFrameError{"while reading keyframes"};
+  }
+  return header;
+}
+
+} // namespace
+
+MotionHeader read_keyframes(std::istream &is, const KeyframeCallback &f) {
+  return read_motion(
+      is,
+      [](const MotionHeader &header, const Frame &first) {
+        auto const joints = first.joint_names();
+        return Frame{make_schema({std::cbegin(joints), std::cend(joints)},
+                                 header.effector_types)};
+      },
+      f);
+}
+
+Motion Motion::load_streaming(std::istream &is) {
+  if (Motion::Impl::is_columnar(is)) {
+    // Keyframes are columns there, not to be decoded one at a time
+    return Motion::Impl::from_columnar(is);
+  }
+
+  compat::optional<Motion> motion;
+  auto const header = read_motion(
+      is,
+      [&motion](const MotionHeader &h, const Frame &first) {
+        auto const joints = first.joint_names();
+        motion.emplace(
+            std::unordered_set<std::string>{std::cbegin(joints),
+                                            std::cend(joints)},
+            h.effector_types, h.model_id);
+        return motion->new_keyframe();
+      },
+      [&motion](double t, const Frame &frame) {
+        // insert_keyframe accepts any time, unlike Motion::load
+        if (!(t >= 0)) {
+          throw errors::InvalidFrameError{"while reading keyframes"};
+        }
+        motion->insert_keyframe(t, frame);
+      });
+
+  // These may follow frames in the input
+  motion->set_model_id(header.model_id);
+  motion->set_loop(header.loop);
+  for (auto const &[name, weight] : header.effector_weights) {
+    motion->set_effector_weight(name, weight);
+  }
+
+  return std::move(*motion);
+}
+
+Motion Motion::Impl::parse_parallel(const char *data, std::size_t size,
+                                    ThreadPool &pool) {
+  if (size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    wire::parse_error();
+  }
+  auto const bytes = reinterpret_cast<const std::uint8_t *>(data);
+
+  // Frames are only located here, as offsets and sizes of the messages
+  // including their length
+  MotionHeader header;
+  std::string key, buffer;
+  std::vector<std::pair<int, int>> frames;
+  {
+    CodedInputStream in{bytes, static_cast<int>(size)};
+    wire::read_fields(in, [&](int field, std::uint32_t tag) {
+      if (field != fields::frames || !wire::is_length_delimited(tag)) {
+        return read_header_field(in, field, tag, header, key, buffer);
+      }
+      auto const begin = in.CurrentPosition();
+      std::uint32_t length;
+      if (!in.ReadVarint32(&length) ||
+          length > static_cast<std::uint32_t>(
+                       std::numeric_limits<int>::max()) ||
+          !in.Skip(static_cast<int>(length))) {
+        wire::parse_error();
+      }
+      frames.emplace_back(begin, in.CurrentPosition() - begin);
+      return true;
+    });
+  }
+  if (frames.empty()) {
+    throw errors::InvalidFrameError{"while reading keyframes"};
+  }
+
+  auto const first = [&] {
+    CodedInputStream in{bytes + frames.front().first, frames.front().second};
+    return wire::read_frame(in, key).second;
+  }();
+  auto const joint_names = first.joint_names();
+  Motion m{std::unordered_set<std::string>{std::cbegin(joint_names),
+                                           std::cend(joint_names)},
+           header.effector_types, header.model_id};
+  m.set_loop(header.loop);
+  for (auto const &[name, weight] : header.effector_weights) {
+    m.set_effector_weight(name, weight);
+  }
+
+  auto const &schema = m.impl->schema;
+  auto const &types = m.impl->keyframes().types();
+  auto const nj = schema->joints().size();
+  auto const ne = schema->effectors().size();
+  auto const n = frames.size();
+  std::vector<double> times(n), positions(n * nj), locations(n * ne * 3),
+      rotations(n * ne * 4);
+  auto const chunks = (n + frames_per_chunk - 1) / frames_per_chunk;
+  pool.run(chunks, [&](std::size_t c) {
+    wire::FrameDecoder decoder{schema, types};
+    Frame frame{schema};
+    auto const end = std::min(n, (c + 1) * frames_per_chunk);
+    for (auto k = c * frames_per_chunk; k < end; k++) {
+      CodedInputStream in{bytes + frames[k].first, frames[k].second};
+      auto const t = decoder.read(in, frame);
+      // Negative times make the motion invalid, and NaN can't be sorted
+      if (!(t >= 0)) {
+        throw errors::InvalidFrameError{"while reading keyframes"};
+      }
+      times[k] = t;
+
+      std::copy_n(frame.position_data(), nj, &positions[k * nj]);
+      auto const e = frame.effector_data();
+      auto *const l = &locations[k * ne * 3];
+      auto *const r = &rotations[k * ne * 4];
+      for (std::size_t i = 0; i < ne; i++) {
+        if (e[i].location()) {
+          auto const &v = e[i].location()->vector();
+          l[i * 3] = v.x();
+          l[i * 3 + 1] = v.y();
+          l[i * 3 + 2] = v.z();
+        }
+        if (e[i].rotation()) {
+          auto const &q = e[i].rotation()->quaternion();
+          r[i] = q.w();
+          r[ne + i] = q.x();
+          r[2 * ne + i] = q.y();
+          r[3 * ne + i] = q.z();
+        } else {
+          r[i] = 1;
+        }
+      }
+    }
+  });
+
+  m.mutable_impl().assign_keyframes(std::move(times), std::move(positions),
+                                    std::move(locations),
+                                    std::move(rotations));
+  return m;
+}
+
+} // namespace flom
@@ -0,0 +1,187 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/interpolation.hpp"
+#include "flom/keyframe_store.hpp"
+#include "flom/motion.hpp"
+#include "flom/motion.impl.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace flom {
+
+namespace {
+
+// Error relative to the tolerance, which is within it if <= 1
+double relative(double error, double tolerance) noexcept {
+  if (!(error >= 0)) {
+    // NaN
+    return std::numeric_limits<double>::infinity();
+  }
+  if (tolerance > 0) {
+    return error / tolerance;
+  }
+  return error > 0 ? std::numeric_limits<double>::infinity() : 0;
+}
+
+// Evaluates interpolation of two keyframes at another keyframe
+// in the same way as MotionCursor, writing into scratch rows
+class SegmentError {
+private:
+  const KeyframeStore &keyframes;
+  double position_tolerance;
+  double rotation_tolerance;
+
+  std::vector<double> positions;
+  std::vector<double> locations;
+  std::vector<double> rotations;
+
+public:
+  SegmentError(const KeyframeStore &keyframes_, double position_tolerance_,
+               double rotation_tolerance_)
+      : keyframes(keyframes_), position_tolerance(position_tolerance_),
+        rotation_tolerance(rotation_tolerance_),
+        positions(keyframes_.num_joints()),
+        locations(keyframes_.num_effectors() * 3),
+        rotations(keyframes_.num_effectors() * 4) {}
+
+  // Largest error relative to the tolerances, over all tracks
+  double operator()(std::size_t a, std::size_t b, std::size_t k) {
+    auto const &store = this->keyframes;
+    auto const nj = store.num_joints();
+    auto const ne = store.num_effectors();
+    auto const &types = store.types();
+    auto const t =
+        (store.time(k) - store.time(a)) / (store.time(b) - store.time(a));
+
+    double error = 0;
+    lerp_n(t, store.positions_at(a), store.positions_at(b),
+           this->positions.data(), nj);
+    auto const p = store.positions_at(k);
+    for (std::size_t i = 0; i < nj; i++) {
+      error = std::max(error, relative(std::abs(this->positions[i] - p[i]),
+                                       this->position_tolerance));
+    }
+
+    lerp_n(t, store.locations_at(a), store.locations_at(b),
+           this->locations.data(), ne * 3);
+    auto const l = store.locations_at(k);
+    for (std::size_t i = 0; i < ne; i++) {
+      if (!types[i].location()) {
+        continue;
+      }
+      double squared = 0;
+      for (std::size_t c = i * 3; c < i * 3 + 3; c++) {
+        squared += (this->locations[c] - l[c]) * (this->locations[c] - l[c]);
+      }
+      error = std::max(error, relative(std::sqrt(squared),
+                                       this->position_tolerance));
+    }
+
+    auto const out = planar_quaternions(this->rotations.data(), ne);
+    slerp_n(t, planar_quaternions(store.rotations_at(a), ne),
+            planar_quaternions(store.rotations_at(b), ne), out, ne);
+    auto const r = planar_quaternions(store.rotations_at(k), ne);
+    for (std::size_t i = 0; i < ne; i++) {
+      if (types[i].rotation()) {
+        auto const angle =
+            rotation_angle({out.w[i], out.x[i], out.y[i], out.z[i]},
+                           {r.w[i], r.x[i], r.y[i], r.z[i]});
+        error = std::max(error, relative(angle, this->rotation_tolerance));
+      }
+    }
+    return error;
+  }
+};
+
+} // namespace
+
+void Motion::simplify(double max_position_error, double max_rotation_error) {
+  auto const &keyframes = this->impl->keyframes();
+  auto const size = keyframes.size();
+  if (size < 3) {
+    return;
+  }
+
+  // Douglas-Peucker over all tracks at once: a segment is kept if the
+  // keyframes inside it are within the errors, otherwise split at the
+  // worst one. Joint positions and locations are piecewise linear in both
+  // the original and the simplified motion, so the largest difference
+  // between them is at one of the removed keyframes.
+  SegmentError error{keyframes, max_position_error, max_rotation_error};
+  std::vector<bool> keep(size, false);
+  keep.front() = keep.back() = true;
+  std::vector<std::pair<std::size_t, std::size_t>> segments{{0, size - 1}};
+  while (!segments.empty()) {
+    auto const [a, b] = segments.back();
+    segments.pop_back();
+
+    double worst = 1;
+    auto split = a;
+    for (auto k = a + 1; k < b; k++) {
+      auto const e = error(a, b, k);
+      if (e > worst) {
+        worst = e;
+        split = k;
+      }
+    }
+    if (split != a) {
+      keep[split] = true;
+      segments.emplace_back(a, split);
+      segments.emplace_back(split, b);
+    }
+  }
+
+  auto const kept =
+      static_cast<std::size_t>(std::count(std::cbegin(keep), std::cend(keep),
+                                          true));
+  if (kept == size) {
+    // Not to detach from copies
+    return;
+  }
+
+  auto const nj = keyframes.num_joints();
+  auto const ne = keyframes.num_effectors();
+  std::vector<double> times, positions, locations, rotations;
+  times.reserve(kept);
+  positions.reserve(kept * nj);
+  locations.reserve(kept * ne * 3);
+  rotations.reserve(kept * ne * 4);
+  for (std::size_t k = 0; k < size; k++) {
+    if (!keep[k]) {
+      continue;
+    }
+    times.push_back(keyframes.time(k));
+    positions.insert(std::end(positions), keyframes.positions_at(k),
+                     keyframes.positions_at(k) + nj);
+    locations.insert(std::end(locations), keyframes.locations_at(k),
+                     keyframes.locations_at(k) + ne * 3);
+    rotations.insert(std::end(rotations), keyframes.rotations_at(k),
+                     keyframes.rotations_at(k) + ne * 4);
+  }
+  this->mutable_impl().mutable_keyframes().assign(
+      std::move(times), std::move(positions), std::move(locations),
+      std::move(rotations));
+}
+
+} // namespace flom
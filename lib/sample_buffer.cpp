@@ -0,0 +1,113 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/sample_buffer.hpp"
+#include "flom/effector.hpp"
+
+#include <algorithm>
+
+namespace flom {
+
+SampleBuffer::SampleBuffer()
+    : schema_(FrameSchema::empty()), size_(0), num_joints_(0),
+      num_effectors_(0) {}
+
+void SampleBuffer::reshape(const std::shared_ptr<const FrameSchema> &schema,
+                           const std::vector<EffectorType> &types,
+                           std::size_t n) {
+  if (schema != this->schema_) {
+    this->schema_ = schema;
+    this->types_ = types;
+    this->num_joints_ = schema->joints().size();
+    this->num_effectors_ = schema->effectors().size();
+  }
+  this->size_ = n;
+  this->positions_.resize(n * this->num_joints_);
+  this->locations_.resize(n * this->num_effectors_ * 3);
+  this->rotations_.resize(n * this->num_effectors_ * 4);
+}
+
+const std::shared_ptr<const FrameSchema> &SampleBuffer::schema() const
+    noexcept {
+  return this->schema_;
+}
+
+const std::vector<EffectorType> &SampleBuffer::types() const noexcept {
+  return this->types_;
+}
+
+std::size_t SampleBuffer::size() const noexcept { return this->size_; }
+bool SampleBuffer::empty() const noexcept { return this->size_ == 0; }
+
+std::size_t SampleBuffer::num_joints() const noexcept {
+  return this->num_joints_;
+}
+std::size_t SampleBuffer::num_effectors() const noexcept {
+  return this->num_effectors_;
+}
+
+compat::span<const double> SampleBuffer::positions() const noexcept {
+  return this->positions_;
+}
+compat::span<const double> SampleBuffer::locations() const noexcept {
+  return this->locations_;
+}
+compat::span<const double> SampleBuffer::rotations() const noexcept {
+  return this->rotations_;
+}
+
+const double *SampleBuffer::positions_at(std::size_t i) const noexcept {
+  return this->positions_.data() + i * this->num_joints_;
+}
+const double *SampleBuffer::locations_at(std::size_t i) const noexcept {
+  return this->locations_.data() + i * this->num_effectors_ * 3;
+}
+const double *SampleBuffer::rotations_at(std::size_t i) const noexcept {
+  return this->rotations_.data() + i * this->num_effectors_ * 4;
+}
+
+FrameRow SampleBuffer::row(std::size_t i) noexcept {
+  return {this->positions_.data() + i * this->num_joints_,
+          this->locations_.data() + i * this->num_effectors_ * 3,
+          this->rotations_.data() + i * this->num_effectors_ * 4};
+}
+
+Frame SampleBuffer::frame(std::size_t i) const {
+  Frame f{this->schema_};
+
+  auto const p = this->positions_at(i);
+  std::copy(p, p + this->num_joints_, f.position_data());
+
+  auto const l = this->locations_at(i);
+  auto const r = this->rotations_at(i);
+  auto const effectors = f.effector_data();
+  for (std::size_t e = 0; e < this->num_effectors_; e++) {
+    if (this->types_[e].location()) {
+      effectors[e].set_location(
+          Location{l[e * 3], l[e * 3 + 1], l[e * 3 + 2]});
+    }
+    if (this->types_[e].rotation()) {
+      effectors[e].set_rotation(
+          Rotation{r[e * 4], r[e * 4 + 1], r[e * 4 + 2], r[e * 4 + 3]});
+    }
+  }
+  return f;
+}
+
+} // namespace flom
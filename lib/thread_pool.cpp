@@ -0,0 +1,165 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "flom/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace flom {
+
+class ThreadPool::Impl {
+private:
+  std::vector<std::thread> workers;
+  // Serializes jobs from different callers
+  std::mutex run_mutex;
+
+  std::mutex mutex;
+  std::condition_variable job_ready;
+  std::condition_variable job_done;
+  bool stopping = false;
+  // Incremented for each job, so that workers take every job once
+  std::size_t generation = 0;
+  // Workers yet to finish the current job
+  std::size_t pending = 0;
+
+  const std::function<void(std::size_t)> *job = nullptr;
+  std::size_t job_size = 0;
+  std::atomic<std::size_t> next{0};
+  std::exception_ptr error;
+
+  void work() {
+    for (;;) {
+      auto const i = this->next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= this->job_size) {
+        return;
+      }
+      try {
+        (*this->job)(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{this->mutex};
+        if (!this->error) {
+          this->error = std::current_exception();
+        }
+        this->next.store(this->job_size, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void worker() {
+    std::size_t seen = 0;
+    std::unique_lock<std::mutex> lock{this->mutex};
+    for (;;) {
+      this->job_ready.wait(lock, [this, seen] {
+        return this->stopping || this->generation != seen;
+      });
+      if (this->stopping) {
+        return;
+      }
+      seen = this->generation;
+
+      lock.unlock();
+      this->work();
+      lock.lock();
+      if (--this->pending == 0) {
+        this->job_done.notify_one();
+      }
+    }
+  }
+
+public:
+  explicit Impl(std::size_t threads) {
+    this->workers.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; i++) {
+      this->workers.emplace_back([this] { this->worker(); });
+    }
+  }
+
+  ~Impl() {
+    {
+      std::lock_guard<std::mutex> lock{this->mutex};
+      this->stopping = true;
+    }
+    this->job_ready.notify_all();
+    for (auto &t : this->workers) {
+      t.join();
+    }
+  }
+
+  Impl(const Impl &) = delete;
+  Impl &operator=(const Impl &) = delete;
+
+  std::size_t size() const noexcept { return this->workers.size() + 1; }
+
+  void run(std::size_t n, const std::function<void(std::size_t)> &f) {
+    if (n == 0) {
+      return;
+    }
+    if (this->workers.empty() || n == 1) {
+      for (std::size_t i = 0; i < n; i++) {
+        f(i);
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> run_lock{this->run_mutex};
+    {
+      std::lock_guard<std::mutex> lock{this->mutex};
+      this->job = &f;
+      this->job_size = n;
+      this->next.store(0, std::memory_order_relaxed);
+      this->error = nullptr;
+      this->pending = this->workers.size();
+      this->generation++;
+    }
+    this->job_ready.notify_all();
+    this->work();
+
+    std::unique_lock<std::mutex> lock{this->mutex};
+    // f is referenced by workers until all of them are done
+    this->job_done.wait(lock, [this] { return this->pending == 0; });
+    this->job = nullptr;
+    if (auto const e = std::exchange(this->error, nullptr)) {
+      std::rethrow_exception(e);
+    }
+  }
+};
+
+ThreadPool::ThreadPool(std::size_t threads)
+    : impl(std::make_unique<Impl>(
+          threads != 0
+              ? threads
+              : std::max(1u, std::thread::hardware_concurrency()))) {}
+
+ThreadPool::~ThreadPool() = default;
+
+std::size_t ThreadPool::size() const noexcept { return this->impl->size(); }
+
+void ThreadPool::run(std::size_t n,
+                     const std::function<void(std::size_t)> &f) {
+  this->impl->run(n, f);
+}
+
+} // namespace flom
@@ -25,7 +25,12 @@
 
 #include <boost/range/algorithm.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <string>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <flom/frame.hpp>
 #include <flom/interpolation.hpp>
@@ -104,4 +109,109 @@ RC_BOOST_PROP(interpolation, (const flom::Frame &f1)) {
   }
 }
 
+RC_BOOST_PROP(lerp_n, (const std::vector<double> &a)) {
+  const double t = static_cast<double>(*rc::gen::inRange(0, 100)) / 100;
+  auto const b = *rc::gen::container<std::vector<double>>(
+      a.size(), rc::gen::arbitrary<double>());
+
+  std::vector<double> out(a.size());
+  flom::lerp_n(t, a.data(), b.data(), out.data(), a.size());
+  for (std::size_t i = 0; i < a.size(); i++) {
+    RC_ASSERT(out[i] == flom::lerp(t, a[i], b[i]) ||
+              (std::isnan(out[i]) && std::isnan(flom::lerp(t, a[i], b[i]))));
+  }
+
+  // in-place
+  auto inplace = a;
+  flom::lerp_n(t, inplace.data(), b.data(), inplace.data(), a.size());
+  RC_ASSERT(std::equal(std::cbegin(inplace), std::cend(inplace),
+                       std::cbegin(out), [](double x, double y) {
+                         return x == y || (std::isnan(x) && std::isnan(y));
+                       }));
+}
+
+RC_BOOST_PROP(rebind, (const flom::Frame &f)) {
+  auto const &schema = *f.schema();
+
+  // Reverse the order of names to get a different layout
+  std::vector<std::string> joints{schema.joints().names().rbegin(),
+                                  schema.joints().names().rend()};
+  std::vector<std::string> effectors{schema.effectors().names().rbegin(),
+                                     schema.effectors().names().rend()};
+  auto const reversed = std::make_shared<const flom::FrameSchema>(
+      flom::NameTable{joints}, flom::NameTable{effectors});
+
+  auto const f2 = f.rebind(reversed);
+  RC_ASSERT(f2.schema() == reversed);
+  RC_ASSERT(f2 == f);
+}
+
+RC_BOOST_PROP(set_position, (flom::Frame f, const std::string &name, double v)) {
+  auto const size = f.positions().size();
+  auto const exists = f.positions().count(name) != 0;
+
+  f.set_position(name, v);
+
+  RC_ASSERT(f.positions().at(name) == v);
+  RC_ASSERT(f.positions().size() == (exists ? size : size + 1));
+}
+
+RC_BOOST_PROP(set_position_shared_schema,
+              (flom::Frame f, const std::vector<std::string> &names)) {
+  auto const copy = f;
+  auto const positions = f.positions().to_map();
+  auto const effectors = f.effectors().to_map();
+
+  for (auto const &name : names) {
+    f.set_position(name, 1);
+    f.set_effector(name, flom::Effector{});
+  }
+
+  // Names are added to f only, not to the schema it shared
+  RC_ASSERT(copy.positions().to_map() == positions);
+  RC_ASSERT(copy.effectors().to_map() == effectors);
+  for (auto const &name : names) {
+    RC_ASSERT(f.positions().at(name) == 1);
+    RC_ASSERT(f.effectors().count(name) == 1);
+  }
+}
+
+RC_BOOST_PROP(from_maps, (const flom::Frame &f)) {
+  auto positions = f.positions().to_map();
+  auto effectors = f.effectors().to_map();
+
+  RC_ASSERT((flom::Frame{positions, effectors}) == f);
+  RC_ASSERT((flom::Frame{std::move(positions), std::move(effectors)}) == f);
+}
+
+RC_BOOST_PROP(set_positions_in_place, (const flom::Frame &f)) {
+  auto g = f.new_compatible_frame();
+  auto const schema = g.schema();
+
+  g.set_positions(f.positions().to_map());
+  g.set_effectors(f.effectors().to_map());
+  RC_ASSERT(g.schema() == schema);
+  RC_ASSERT(g == f);
+
+  auto h = f.new_compatible_frame();
+  auto positions = f.positions().to_map();
+  auto effectors = f.effectors().to_map();
+  h.set_positions(std::move(positions));
+  h.set_effectors(std::move(effectors));
+  RC_ASSERT(h.schema() == schema);
+  RC_ASSERT(h == f);
+}
+
+RC_BOOST_PROP(set_positions_new_names,
+              (flom::Frame f, const std::string &name, double v)) {
+  RC_PRE(f.positions().count(name) == 0);
+
+  auto positions = f.positions().to_map();
+  positions.emplace(name, v);
+  auto const expected = positions;
+
+  f.set_positions(std::move(positions));
+  RC_ASSERT(f.positions().to_map() == expected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
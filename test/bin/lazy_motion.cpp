@@ -0,0 +1,205 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace filesystem = std::filesystem;
+#elif __has_include(<experimental/filesystem>)
+#include <experimental/filesystem>
+namespace filesystem = std::experimental::filesystem;
+#else
+#error Could not find filesystem header
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <flom/errors.hpp>
+#include <flom/lazy_motion.hpp>
+#include <flom/motion.hpp>
+#include <flom/range.hpp>
+
+#include "comparison.hpp"
+#include "generators.hpp"
+#include "printers.hpp"
+
+namespace {
+
+filesystem::path dump_to_temp(const flom::Motion &m) {
+  auto const path = filesystem::temp_directory_path() / "out_lazy.fom";
+  std::ofstream f(path, std::ios::binary);
+  m.dump(f);
+  return path;
+}
+
+// Appends a frame holding only t (field 1, 64-bit) as field 4
+void put_time_frame(std::ostream &os, double t) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &t, sizeof(bits));
+  os << '\x22' << '\x09' << '\x09';
+  for (int i = 0; i < 8; i++) {
+    os << static_cast<char>((bits >> (i * 8)) & 0xff);
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(lazy_motion)
+
+RC_BOOST_PROP(metadata, (const flom::Motion &m)) {
+  auto const path = dump_to_temp(m);
+  flom::LazyMotion const lazy{path.string()};
+  filesystem::remove(path);
+
+  RC_ASSERT(lazy.model_id() == m.model_id());
+  RC_ASSERT(lazy.loop() == m.loop());
+  RC_ASSERT(lazy.length() == m.length());
+
+  auto const joints = lazy.joint_names();
+  auto const m_joints = m.joint_names();
+  RC_ASSERT(std::set<std::string>(joints.begin(), joints.end()) ==
+            std::set<std::string>(m_joints.begin(), m_joints.end()));
+  for (auto const &name : m.effector_names()) {
+    RC_ASSERT(lazy.effector_type(name) == m.effector_type(name));
+    RC_ASSERT(lazy.effector_weight(name) == m.effector_weight(name));
+  }
+
+  std::vector<double> times;
+  for (auto const &[t, f] : m.const_keyframes()) {
+    times.push_back(t);
+  }
+  RC_ASSERT(lazy.keyframe_times() == times);
+}
+
+RC_BOOST_PROP(keyframe, (const flom::Motion &m, std::size_t cache_size)) {
+  auto const path = dump_to_temp(m);
+  flom::LazyMotion lazy{path.string(), cache_size % 4};
+  filesystem::remove(path);
+
+  std::vector<flom::Frame> frames;
+  for (auto const &[t, f] : m.const_keyframes()) {
+    frames.push_back(f);
+  }
+  // Twice in reverse, to evict and decode again
+  for (int i = 0; i < 2; i++) {
+    for (auto k = frames.size(); k-- > 0;) {
+      FLOM_ALMOST_EQUAL(lazy.keyframe(k), frames[k]);
+    }
+  }
+  RC_ASSERT_THROWS_AS(lazy.keyframe(lazy.keyframe_times().size()),
+                      std::out_of_range);
+}
+
+RC_BOOST_PROP(frame_at, (const flom::Motion &m, std::size_t cache_size)) {
+  auto const path = dump_to_temp(m);
+  flom::LazyMotion lazy{path.string(), cache_size % 4};
+  filesystem::remove(path);
+
+  auto const times = *rc::gen::container<std::vector<double>>(
+      rc::gen::inRange(0, 300));
+  for (auto const i : times) {
+    // Beyond the length to check loops
+    auto const t = m.length() * i / 100.0;
+    if (!m.is_in_range_at(t)) {
+      RC_ASSERT(!lazy.is_in_range_at(t));
+      RC_ASSERT_THROWS_AS(lazy.frame_at(t), flom::errors::OutOfFramesError);
+      continue;
+    }
+    FLOM_ALMOST_EQUAL(lazy.frame_at(t), m.frame_at(t));
+  }
+  RC_ASSERT_THROWS_AS(lazy.frame_at(-1), flom::errors::InvalidTimeError);
+}
+
+RC_BOOST_PROP(to_motion, (const flom::Motion &m)) {
+  auto const path = dump_to_temp(m);
+  flom::LazyMotion const lazy{path.string(), 1};
+  filesystem::remove(path);
+
+  FLOM_ALMOST_EQUAL(lazy.to_motion(), m);
+}
+
+BOOST_AUTO_TEST_CASE(open_error) {
+  auto const path = filesystem::temp_directory_path() / "empty_lazy.fom";
+  filesystem::remove(path);
+  BOOST_CHECK_THROW(flom::LazyMotion{path.string()}, flom::errors::FileError);
+
+  std::ofstream{path, std::ios::binary};
+  BOOST_CHECK_THROW(flom::LazyMotion{path.string()},
+                    flom::errors::InvalidFrameError);
+
+  std::ofstream{path, std::ios::binary} << "\x22\xff";
+  BOOST_CHECK_THROW(flom::LazyMotion{path.string()},
+                    flom::errors::ParseError);
+  filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_time) {
+  // Frames holding only t are valid without joints and effectors
+  flom::Motion m{{}, {}};
+  m.insert_keyframe(1, m.new_keyframe());
+  auto const path = filesystem::temp_directory_path() / "invalid_lazy.fom";
+  for (auto const t : {-1.0, std::numeric_limits<double>::quiet_NaN()}) {
+    {
+      std::ofstream f(path, std::ios::binary);
+      m.dump(f);
+      // Between valid frames in the file and by time
+      put_time_frame(f, t);
+      put_time_frame(f, 2);
+    }
+    BOOST_CHECK_THROW(flom::LazyMotion{path.string()},
+                      flom::errors::InvalidFrameError);
+  }
+  filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_frame) {
+  // A frame without positions of the joints, found only when decoded
+  flom::Motion m{{"j"}, {}};
+  m.insert_keyframe(1, m.new_keyframe());
+  auto const path = filesystem::temp_directory_path() / "corrupt_lazy.fom";
+  {
+    std::ofstream f(path, std::ios::binary);
+    m.dump(f);
+    put_time_frame(f, 2);
+  }
+
+  for (auto const cache_size : {std::size_t{1}, std::size_t{4}}) {
+    flom::LazyMotion lazy{path.string(), cache_size};
+    // Not cached after the first failure
+    BOOST_CHECK_THROW(lazy.keyframe(2), flom::errors::InvalidFrameError);
+    BOOST_CHECK_THROW(lazy.keyframe(2), flom::errors::InvalidFrameError);
+    BOOST_CHECK_THROW(lazy.frame_at(2), flom::errors::InvalidFrameError);
+  }
+  filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
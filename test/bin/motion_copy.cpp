@@ -0,0 +1,157 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#include <boost/range/begin.hpp>
+#include <boost/range/empty.hpp>
+
+#include <flom/motion.hpp>
+#include <flom/range.hpp>
+
+#include <array>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "comparison.hpp"
+#include "generators.hpp"
+#include "printers.hpp"
+
+BOOST_AUTO_TEST_SUITE(motion_copy)
+
+RC_BOOST_PROP(copy_equal, (const flom::Motion &m)) {
+  auto const copy = m;
+  RC_ASSERT(copy == m);
+
+  auto assigned = flom::Motion{{}, {}};
+  assigned = m;
+  RC_ASSERT(assigned == m);
+}
+
+RC_BOOST_PROP(move, (const flom::Motion &m)) {
+  auto source = m;
+  auto moved = std::move(source);
+  RC_ASSERT(moved == m);
+
+  source = std::move(moved);
+  RC_ASSERT(source == m);
+  RC_ASSERT(source.is_valid());
+}
+
+RC_BOOST_PROP(insert_keyframe_detaches, (const flom::Motion &m)) {
+  auto const length = m.length();
+  auto const t = length + 1;
+
+  auto copy = m;
+  copy.insert_keyframe(t, m.new_keyframe());
+  RC_ASSERT(copy.length() == t);
+  RC_ASSERT(m.length() == length);
+  RC_ASSERT(copy != m);
+}
+
+RC_BOOST_PROP(delete_keyframe_detaches, (flom::Motion m)) {
+  auto const t = m.length() + 1;
+  m.insert_keyframe(t, m.new_keyframe());
+
+  auto copy = m;
+  copy.delete_keyframe(t);
+  RC_ASSERT(copy.length() < t);
+  RC_ASSERT(m.length() == t);
+
+  copy = m;
+  copy.clear_keyframes();
+  RC_ASSERT(copy.length() == 0);
+  RC_ASSERT(m.length() == t);
+}
+
+RC_BOOST_PROP(copy_mutate_threads, (const flom::Motion &m)) {
+  auto const t = m.length() + 1;
+
+  // Owns its keyframes, so that it is written in place once copies are gone
+  auto source = m;
+  source.insert_keyframe(t, m.new_keyframe());
+
+  std::array<bool, 4> detached;
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < detached.size(); i++) {
+    threads.emplace_back([copy = source, t, &detached, i]() mutable {
+      copy.insert_keyframe(t + 1, copy.new_keyframe());
+      detached[i] = copy.length() == t + 1;
+    });
+  }
+  // Races with the copies dropped by the threads
+  for (int i = 0; i < 100; i++) {
+    source.insert_keyframe(t + 2, source.new_keyframe());
+    source.delete_keyframe(t + 2);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  RC_ASSERT(source.length() == t);
+  RC_ASSERT(m.length() == t - 1);
+  for (auto const d : detached) {
+    RC_ASSERT(d);
+  }
+}
+
+RC_BOOST_PROP(set_loop_detaches, (const flom::Motion &m)) {
+  auto const loop = m.loop() == flom::LoopType::Wrap ? flom::LoopType::None
+                                                     : flom::LoopType::Wrap;
+  auto copy = m;
+  copy.set_loop(loop);
+  RC_ASSERT(copy.loop() == loop);
+  RC_ASSERT(m.loop() != loop);
+}
+
+RC_BOOST_PROP(set_effector_weight_detaches, (const flom::Motion &m)) {
+  RC_PRE(!boost::empty(m.effector_names()));
+
+  auto const &name = *boost::begin(m.effector_names());
+  auto const weight = m.effector_weight(name);
+  auto copy = m;
+  auto const location = weight.location() == 0 ? 1.0 : 0.0;
+  copy.set_effector_weight(name,
+                           flom::EffectorWeight{location, weight.rotation()});
+  RC_ASSERT(copy.effector_weight(name) != weight);
+  RC_ASSERT(m.effector_weight(name) == weight);
+}
+
+RC_BOOST_PROP(keyframe_range_detaches, (flom::Motion m)) {
+  RC_PRE(!boost::empty(m.joint_names()));
+
+  auto range = m.keyframes();
+  auto const copy = m;
+  auto const before = m.frame_at(0);
+
+  auto frame = m.new_keyframe();
+  frame.set_position(*boost::begin(m.joint_names()), 1);
+  for (auto &&[t, ref] : range) {
+    ref = frame;
+  }
+  FLOM_ALMOST_EQUAL(m.frame_at(0), frame);
+  FLOM_ALMOST_EQUAL(copy.frame_at(0), before);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
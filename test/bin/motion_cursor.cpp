@@ -0,0 +1,148 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include <flom/errors.hpp>
+#include <flom/motion.hpp>
+#include <flom/motion_cursor.hpp>
+#include <flom/range.hpp>
+
+#include "comparison.hpp"
+#include "generators.hpp"
+#include "printers.hpp"
+
+BOOST_AUTO_TEST_SUITE(motion_cursor)
+
+namespace {
+
+// Checks the cursor is at the segment containing t
+void check_segment(const flom::Motion &m, const flom::MotionCursor &cursor,
+                   double t) {
+  auto const range = m.const_keyframes();
+  auto const k = cursor.segment();
+  RC_ASSERT(k < range.size());
+  RC_ASSERT((range.begin() + static_cast<long>(k))->first <= t);
+  if (k + 1 < range.size()) {
+    RC_ASSERT(t < (range.begin() + static_cast<long>(k + 1))->first);
+  }
+}
+
+// Times within [0, length], in random order
+std::vector<double> times_in_range(const flom::Motion &m) {
+  auto const ratios = *rc::gen::container<std::vector<int>>(
+      rc::gen::inRange(0, 1001));
+  std::vector<double> times;
+  std::transform(std::cbegin(ratios), std::cend(ratios),
+                 std::back_inserter(times), [&m](int r) {
+                   return m.length() * static_cast<double>(r) / 1000;
+                 });
+  return times;
+}
+
+} // namespace
+
+RC_BOOST_PROP(sequential, (const flom::Motion &m)) {
+  auto times = times_in_range(m);
+  std::sort(std::begin(times), std::end(times));
+
+  flom::MotionCursor cursor{m};
+  for (auto const t : times) {
+    FLOM_ALMOST_EQUAL(cursor.frame_at(t), m.frame_at(t));
+    check_segment(m, cursor, t);
+  }
+}
+
+RC_BOOST_PROP(seek, (const flom::Motion &m)) {
+  auto const times = times_in_range(m);
+
+  flom::MotionCursor cursor{m};
+  for (auto const t : times) {
+    FLOM_ALMOST_EQUAL(cursor.frame_at(t), m.frame_at(t));
+    check_segment(m, cursor, t);
+  }
+}
+
+RC_BOOST_PROP(wrap, (flom::Motion m)) {
+  m.set_loop(flom::LoopType::Wrap);
+  RC_PRE(m.length() != 0);
+
+  auto const step = m.length() / *rc::gen::inRange(1, 50);
+  flom::MotionCursor cursor{m};
+  flom::Frame f;
+  for (int i = 0; i < 200; i++) {
+    auto const t = step * i;
+    cursor.frame_at_into(t, f);
+    FLOM_ALMOST_EQUAL(f, m.frame_at(t));
+  }
+}
+
+RC_BOOST_PROP(frames, (const flom::Motion &m)) {
+  // Looping motion has infinite frames
+  RC_PRE(m.loop() == flom::LoopType::None);
+  auto const fps = m.length() / *rc::gen::inRange(1, 100);
+  RC_PRE(fps != 0);
+
+  for (auto const &[t, f] : m.frames(fps)) {
+    FLOM_ALMOST_EQUAL(f, m.frame_at(t));
+  }
+}
+
+RC_BOOST_PROP(modified, (flom::Motion m)) {
+  RC_PRE(m.length() != 0);
+
+  flom::MotionCursor cursor{m};
+  cursor.frame_at(m.length());
+  m.clear_keyframes();
+  FLOM_ALMOST_EQUAL(cursor.frame_at(0), m.frame_at(0));
+  RC_ASSERT(cursor.segment() == 0);
+}
+
+RC_BOOST_PROP(out_of_frames, (const flom::Motion &m)) {
+  RC_PRE(m.loop() == flom::LoopType::None);
+
+  flom::MotionCursor cursor{m};
+  RC_ASSERT_THROWS_AS(cursor.frame_at(m.length() + 1),
+                      flom::errors::OutOfFramesError);
+}
+
+RC_BOOST_PROP(too_many_loops, (flom::Motion m)) {
+  m.set_loop(flom::LoopType::Wrap);
+  RC_PRE(m.length() != 0);
+
+  flom::MotionCursor cursor{m};
+  RC_ASSERT_THROWS_AS(cursor.frame_at(std::numeric_limits<double>::infinity()),
+                      flom::errors::OutOfFramesError);
+}
+
+RC_BOOST_PROP(invalid_time, (const flom::Motion &m)) {
+  flom::MotionCursor cursor{m};
+  RC_ASSERT_THROWS_AS(cursor.frame_at(-1), flom::errors::InvalidTimeError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -63,8 +63,8 @@ RC_BOOST_PROP(retrieve_frame, (flom::Motion m)) {
       auto [l, u] = std::equal_range(range.begin(), range.end(), t, Comp{});
       auto const t1 = std::next(l, -1)->first;
       auto const t2 = u->first;
-      auto const &f1 = std::next(l, -1)->second;
-      auto const &f2 = u->second;
+      auto const f1 = std::next(l, -1)->second;
+      auto const f2 = u->second;
       expected_frame = flom::interpolate((t - t1) / (t2 - t1), f1, f2);
     } else {
       expected_frame = it->second;
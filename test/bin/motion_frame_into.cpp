@@ -0,0 +1,91 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#include <cstdlib>
+#include <new>
+
+#include <flom/errors.hpp>
+#include <flom/motion.hpp>
+
+#include "comparison.hpp"
+#include "generators.hpp"
+#include "printers.hpp"
+
+namespace {
+
+std::size_t allocation_count = 0;
+
+// Out of line, so that the compiler can't pair the allocation with
+// the deallocation functions of the caller
+[[gnu::noinline]] void *allocate(std::size_t size) {
+  allocation_count++;
+  if (auto *const p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void deallocate(void *p) noexcept { std::free(p); }
+
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void *p) noexcept { deallocate(p); }
+void operator delete[](void *p) noexcept { deallocate(p); }
+void operator delete(void *p, std::size_t) noexcept { deallocate(p); }
+void operator delete[](void *p, std::size_t) noexcept { deallocate(p); }
+
+BOOST_AUTO_TEST_SUITE(motion_frame_into)
+
+RC_BOOST_PROP(frame_at_into, (const flom::Motion &m, flom::Frame f)) {
+  auto const t = *rc::gen::nonNegative<double>();
+  RC_PRE(m.is_in_range_at(t));
+
+  m.frame_at_into(t, f);
+  FLOM_ALMOST_EQUAL(f, m.frame_at(t));
+}
+
+RC_BOOST_PROP(frame_at_into_no_allocation, (const flom::Motion &m)) {
+  auto const t1 = *rc::gen::nonNegative<double>();
+  auto const t2 = *rc::gen::nonNegative<double>();
+  RC_PRE(m.is_in_range_at(t1) && m.is_in_range_at(t2));
+
+  auto f = m.new_keyframe();
+  m.frame_at_into(t1, f);
+
+  auto const count = allocation_count;
+  m.frame_at_into(t2, f);
+  RC_ASSERT(allocation_count == count);
+
+  FLOM_ALMOST_EQUAL(f, m.frame_at(t2));
+}
+
+RC_BOOST_PROP(frame_at_into_invalid_time, (const flom::Motion &m)) {
+  auto f = m.new_keyframe();
+  RC_ASSERT_THROWS_AS(m.frame_at_into(-1, f), flom::errors::InvalidTimeError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
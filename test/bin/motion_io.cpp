@@ -33,15 +33,33 @@ namespace filesystem = std::experimental::filesystem;
 #error Could not find filesystem header
 #endif
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include <flom/compat/optional.hpp>
+#include <flom/errors.hpp>
 #include <flom/motion.hpp>
+#include <flom/motion_loader.hpp>
+#include <flom/motion_reader.hpp>
+#include <flom/range.hpp>
+#include <flom/thread_pool.hpp>
 
 #include "comparison.hpp"
 #include "generators.hpp"
 #include "printers.hpp"
 
+#include <sys/stat.h>
+
 BOOST_AUTO_TEST_SUITE(motion_io)
 
 RC_BOOST_PROP(dump_load, (const flom::Motion &m)) {
@@ -90,4 +108,524 @@ RC_BOOST_PROP(dump_load_json, (const flom::Motion &m)) {
   }
 }
 
+RC_BOOST_PROP(dump_load_json_name_table, (const flom::Motion &m)) {
+  flom::JSONFormat format;
+  format.name_table = true;
+  std::stringstream s;
+  m.dump_json(s, format);
+  RC_ASSERT(s.str() == m.dump_json_string(format));
+
+  auto const m2 = flom::Motion::load_json(s);
+  FLOM_ALMOST_EQUAL(m, m2);
+}
+
+BOOST_AUTO_TEST_CASE(dump_json_format) {
+  auto const world = flom::CoordinateSystem::World;
+  flom::Motion m{{"j"},
+                 {{"e\"", flom::EffectorType{world, flom::compat::nullopt}}},
+                 "model"};
+  m.set_loop(flom::LoopType::Wrap);
+  auto frame = m.new_keyframe();
+  frame.set_position("j", 0.1);
+  frame.set_effector("e\"", flom::Effector{flom::Location{1, -2.5, 1e-300},
+                                           flom::compat::nullopt});
+  m.insert_keyframe(0.5, frame);
+
+  BOOST_TEST(
+      m.dump_json_string() ==
+      R"({"modelId":"model","loop":"Wrap",)"
+      R"("effectorTypes":{"e\"":{"location":"World","rotation":"None"}},)"
+      R"("frames":[{"t":0,"positions":{"j":0},"effectors":{"e\"":)"
+      R"({"location":{"value":{"vector":{"x":0,"y":0,"z":0}}}}}},)"
+      R"({"t":0.5,"positions":{"j":0.1},"effectors":{"e\"":)"
+      R"({"location":{"value":{"vector":{"x":1,"y":-2.5,"z":1e-300}}}}}}],)"
+      R"("effectorWeights":{"e\"":{"location":0,"rotation":0}}})");
+
+  flom::JSONFormat format;
+  format.name_table = true;
+  BOOST_TEST(
+      m.dump_json_string(format) ==
+      R"({"modelId":"model","loop":"Wrap",)"
+      R"("effectorTypes":{"e\"":{"location":"World","rotation":"None"}},)"
+      R"("effectorWeights":{"e\"":{"location":0,"rotation":0}},)"
+      R"("jointNames":["j"],"effectorNames":["e\""],)"
+      R"("frames":[{"t":0,"positions":[0],"effectors":[{"location":[0,0,0]}]},)"
+      R"({"t":0.5,"positions":[0.1],"effectors":[{"location":[1,-2.5,1e-300]}]}]})");
+}
+
+RC_BOOST_PROP(load_json_pretty, (const flom::Motion &m)) {
+  // Whitespace around every structural character
+  std::string pretty;
+  bool in_string = false, escaped = false;
+  for (auto const c : m.dump_json_string()) {
+    if (in_string) {
+      pretty.push_back(c);
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        in_string = false;
+      }
+      continue;
+    }
+    if (c == '"') {
+      in_string = true;
+      pretty.push_back(c);
+    } else if (std::string{"{}[]:,"}.find(c) == std::string::npos) {
+      pretty.push_back(c);
+    } else {
+      pretty += "\n\t ";
+      pretty.push_back(c);
+      pretty += "\r\n ";
+    }
+  }
+
+  std::istringstream s{pretty};
+  auto const m2 = flom::Motion::load_json(s);
+  FLOM_ALMOST_EQUAL(m, m2);
+}
+
+BOOST_AUTO_TEST_CASE(load_json_fields) {
+  // Proto field names, fields in any order, doubles as strings,
+  // enums as numbers, null as defaults and escaped names
+  auto const json = R"({
+    "frames": [
+      {
+        "effectors": {
+          "h\u00e9and": {"rotation": {"value": {"quaternion":
+            {"z": 0, "y": 0, "x": "0", "w": 2}}}, "location": null}
+        },
+        "positions": {"b": "NaN", "a": 1},
+        "t": 0.5
+      },
+      {"t": "1e0", "positions": {"a": -2.5e-1, "b": "-Infinity"},
+       "effectors": {"h\u00e9and": {"rotation": {"value": {}}}}},
+      {"t": null, "positions": {"a": 3, "b": 4},
+       "effectors": {"h\u00e9and": {"rotation": {"value": {"quaternion":
+         {"w": 1}}}}}}
+    ],
+    "effector_weights": {"h\u00e9and": {"location": 0.5, "rotation": null}},
+    "effector_types": {"h\u00e9and": {"location": 0, "rotation": "Local"}},
+    "loop": 1,
+    "model_id": "m\"odel"
+  })";
+  auto const m = flom::Motion::load_json_string(json);
+
+  BOOST_TEST(m.model_id() == "m\"odel");
+  BOOST_TEST((m.loop() == flom::LoopType::Wrap));
+  auto const name = "h\xc3\xa9" "and";
+  BOOST_TEST((m.effector_type(name) ==
+              flom::EffectorType{flom::compat::nullopt,
+                                 flom::CoordinateSystem::Local}));
+  BOOST_TEST((m.effector_weight(name) == flom::EffectorWeight{0.5, 0}));
+  BOOST_TEST(m.length() == 1);
+
+  auto f0 = m.frame_at(0);
+  BOOST_TEST(f0.positions().at("a") == 3);
+  auto f1 = m.frame_at(0.5);
+  BOOST_TEST(f1.positions().at("a") == 1);
+  BOOST_TEST(std::isnan(f1.positions().at("b")));
+  BOOST_TEST(f1.effectors().at(name).rotation()->quaternion().w() == 1);
+  auto f2 = m.frame_at(1);
+  BOOST_TEST(f2.positions().at("a") == -0.25);
+  BOOST_TEST(f2.positions().at("b") == -std::numeric_limits<double>::infinity());
+}
+
+RC_BOOST_PROP(load_json_broken, (const flom::Motion &m, bool name_table)) {
+  flom::JSONFormat format;
+  format.name_table = name_table;
+  auto const json = m.dump_json_string(format);
+  auto const size = *rc::gen::inRange<std::size_t>(0, json.size());
+  RC_ASSERT_THROWS_AS(flom::Motion::load_json_string(json.substr(0, size)),
+                      flom::errors::JSONLoadError);
+}
+
+BOOST_AUTO_TEST_CASE(load_json_invalid) {
+  auto const load = [](const std::string &json) {
+    return flom::Motion::load_json_string(json);
+  };
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0}], "unknown": 1})"),
+                    flom::errors::JSONLoadError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0x1}]})"),
+                    flom::errors::JSONLoadError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0}]} {})"),
+                    flom::errors::JSONLoadError);
+  BOOST_CHECK_THROW(load(R"({"loop": "Loop", "frames": [{"t": 0}]})"),
+                    flom::errors::JSONLoadError);
+  BOOST_CHECK_THROW(load(R"({"frames": []})"),
+                    flom::errors::InvalidFrameError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0, "positions": {"a": 0}},
+                                        {"t": 1, "positions": {"b": 0}}]})"),
+                    flom::errors::InvalidFrameError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0, "positions": {"a": 0}},
+                                        {"t": 1}]})"),
+                    flom::errors::InvalidFrameError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0, "positions": [0]}]})"),
+                    flom::errors::JSONLoadError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0}], "jointNames": []})"),
+                    flom::errors::JSONLoadError);
+  BOOST_CHECK_THROW(load(R"({"jointNames": ["a"],
+                             "frames": [{"t": 0, "positions": [0, 1]}]})"),
+                    flom::errors::InvalidFrameError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": -1}]})"),
+                    flom::errors::InvalidFrameError);
+  BOOST_CHECK_THROW(load(R"({"frames": [{"t": 0, "effectors": {"e": {}}}]})"),
+                    flom::errors::InvalidFrameError);
+}
+
+RC_BOOST_PROP(dump_load_file, (const flom::Motion &m, bool populate)) {
+  auto const path = filesystem::temp_directory_path() / "out_file.fom";
+
+  {
+    std::ofstream f(path, std::ios::binary);
+    m.dump(f);
+  }
+
+  auto const m2 = flom::Motion::load_file(path.string(), populate);
+  auto const m3 = flom::MotionLoader{}.load_file(path.string(), populate);
+  filesystem::remove(path);
+
+  FLOM_ALMOST_EQUAL(m, m2);
+  FLOM_ALMOST_EQUAL(m, m3);
+}
+
+RC_BOOST_PROP(load_file_fifo, (const flom::Motion &m)) {
+  std::stringstream s;
+  m.dump(s);
+  auto const data = s.str();
+
+  // Files which can't be mapped are read instead
+  auto const path = filesystem::temp_directory_path() / "in_fifo.fom";
+  filesystem::remove(path);
+  RC_ASSERT(::mkfifo(path.c_str(), 0600) == 0);
+  std::thread writer{[&path, &data] {
+    std::ofstream{path, std::ios::binary} << data;
+  }};
+  flom::compat::optional<flom::Motion> m2;
+  try {
+    m2.emplace(flom::Motion::load_file(path.string()));
+  } catch (...) {
+    writer.join();
+    filesystem::remove(path);
+    throw;
+  }
+  writer.join();
+  filesystem::remove(path);
+
+  FLOM_ALMOST_EQUAL(m, *m2);
+}
+
+RC_BOOST_PROP(dump_load_columnar, (const flom::Motion &m)) {
+  std::stringstream s;
+  m.dump_columnar(s);
+  auto const data = s.str();
+  RC_ASSERT(flom::Motion::load(s) == m);
+
+  auto const path = filesystem::temp_directory_path() / "out.fomc";
+  std::ofstream{path, std::ios::binary} << data;
+  auto const m2 = flom::Motion::load_file(path.string());
+  auto const m3 = flom::MotionLoader{}.load_file(path.string());
+  filesystem::remove(path);
+
+  RC_ASSERT(m2 == m);
+  RC_ASSERT(m3 == m);
+}
+
+RC_BOOST_PROP(load_columnar_broken, (const flom::Motion &m)) {
+  std::ostringstream os;
+  m.dump_columnar(os);
+  auto const data = os.str();
+  auto const size = *rc::gen::inRange<std::size_t>(1, data.size());
+
+  std::istringstream is{data.substr(0, size)};
+  RC_ASSERT_THROWS_AS(flom::Motion::load(is), flom::errors::ParseError);
+}
+
+RC_BOOST_PROP(load_columnar_oversized, (const flom::Motion &m)) {
+  std::ostringstream os;
+  m.dump_columnar(os);
+  auto data = os.str();
+
+  // Size of the file in the header, larger than the data
+  auto const size = *rc::gen::element(
+      std::uint64_t{data.size() + 1}, std::uint64_t{1} << 40,
+      std::numeric_limits<std::uint64_t>::max());
+  std::memcpy(&data[88], &size, sizeof(size));
+
+  std::istringstream is{data};
+  RC_ASSERT_THROWS_AS(flom::Motion::load(is), flom::errors::ParseError);
+}
+
+namespace {
+
+// Whether keyframes of b are within the errors from a
+bool within(const flom::Motion &a, const flom::Motion &b,
+            const flom::Quantization &q) {
+  auto const near = [](double x, double y, double error) {
+    return x == y || std::abs(x - y) <= error;
+  };
+  // Rotations are compared with a tolerance for rounding of the angle
+  auto const rotation_error = q.rotation + 1e-12;
+
+  auto const ka = a.const_keyframes();
+  auto const kb = b.const_keyframes();
+  if (ka.size() != kb.size()) {
+    return false;
+  }
+  for (auto ia = ka.begin(), ib = kb.begin(); ia != ka.end(); ++ia, ++ib) {
+    auto const &[ta, fa] = *ia;
+    auto const &[tb, fb] = *ib;
+    if (!near(ta, tb, q.time)) {
+      return false;
+    }
+    auto const pb = flom::Frame{fb}.positions();
+    for (auto const &[name, v] : fa.positions()) {
+      if (!near(v, pb.at(name), q.position)) {
+        return false;
+      }
+    }
+    auto const eb = flom::Frame{fb}.effectors();
+    for (auto const &[name, e] : fa.effectors()) {
+      auto const &other = eb.at(name);
+      if (e.location()) {
+        auto const &va = e.location()->vector();
+        auto const &vb = other.location()->vector();
+        for (Eigen::Index i = 0; i < 3; i++) {
+          if (!near(va[i], vb[i], q.location)) {
+            return false;
+          }
+        }
+      }
+      if (e.rotation() &&
+          e.rotation()->quaternion().angularDistance(
+              other.rotation()->quaternion()) > rotation_error) {
+        return false;
+      }
+    }
+  }
+  return a.model_id() == b.model_id() && a.loop() == b.loop();
+}
+
+} // namespace
+
+RC_BOOST_PROP(dump_load_quantized, (const flom::Motion &m)) {
+  auto const error = *rc::gen::element(0.0, 1e-6, 1e-3, 0.1);
+  flom::Quantization q;
+  q.position = q.location = q.rotation = error;
+  if (error == 0) {
+    q.time = 0;
+  }
+  q.verify = true;
+
+  std::stringstream s;
+  m.dump_columnar(s, q);
+  auto const m2 = flom::Motion::load(s);
+  RC_ASSERT(within(m, m2, q));
+  if (error == 0) {
+    RC_ASSERT(m2 == m);
+  }
+}
+
+RC_BOOST_PROP(load_quantized_broken, (const flom::Motion &m)) {
+  std::ostringstream os;
+  m.dump_columnar(os, flom::Quantization{});
+  auto const data = os.str();
+  auto const size = *rc::gen::inRange<std::size_t>(1, data.size());
+
+  std::istringstream is{data.substr(0, size)};
+  RC_ASSERT_THROWS_AS(flom::Motion::load(is), flom::errors::ParseError);
+}
+
+RC_BOOST_PROP(load_quantized_corrupt_size, (const flom::Motion &m)) {
+  std::ostringstream os;
+  m.dump_columnar(os, flom::Quantization{});
+  auto data = os.str();
+
+  // Number of keyframes in the header, larger than the file
+  auto const k = *rc::gen::element(std::uint64_t{1} << 32,
+                                   std::uint64_t{1} << 61,
+                                   std::numeric_limits<std::uint64_t>::max());
+  std::memcpy(&data[16], &k, sizeof(k));
+
+  std::istringstream is{data};
+  RC_ASSERT_THROWS_AS(flom::Motion::load(is), flom::errors::ParseError);
+}
+
+BOOST_AUTO_TEST_CASE(quantized_size) {
+  // A smooth motion of 2 seconds at 60 fps
+  std::unordered_set<std::string> joints;
+  for (int i = 0; i < 20; i++) {
+    joints.insert("joint" + std::to_string(i));
+  }
+  auto const world = flom::CoordinateSystem::World;
+  flom::Motion m{joints, {{"hand", flom::EffectorType{world, world}}}};
+  for (int k = 1; k <= 120; k++) {
+    auto const t = k / 60.0;
+    auto frame = m.new_keyframe();
+    int i = 0;
+    for (auto const &name : joints) {
+      frame.set_position(name, std::sin(t + i++));
+    }
+    auto const angle = t / 2;
+    frame.set_effector(
+        "hand",
+        flom::Effector{flom::Location{t, std::sin(t), 1},
+                       flom::Rotation{std::cos(angle), std::sin(angle), 0, 0}});
+    m.insert_keyframe(t, frame);
+  }
+
+  std::ostringstream fom, quantized;
+  m.dump(fom);
+  flom::Quantization q;
+  q.verify = true;
+  m.dump_columnar(quantized, q);
+  BOOST_TEST(fom.str().size() >= 4 * quantized.str().size());
+
+  std::istringstream is{quantized.str()};
+  auto const m2 = flom::Motion::load(is);
+  BOOST_TEST(within(m, m2, q));
+  // Between keyframes, the error is bounded by interpolation
+  for (int i = 0; i < 200; i++) {
+    auto const t = i / 100.0;
+    auto const a = m.frame_at(t).positions();
+    auto const b = m2.frame_at(t).positions();
+    for (auto const &[name, v] : a) {
+      BOOST_TEST(std::abs(v - b.at(name)) <= 2 * q.position);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(load_file_error) {
+  auto const path = filesystem::temp_directory_path() / "empty.fom";
+  filesystem::remove(path);
+  BOOST_CHECK_THROW(flom::Motion::load_file(path.string()),
+                    flom::errors::FileError);
+
+  std::ofstream{path, std::ios::binary};
+  BOOST_CHECK_THROW(flom::Motion::load_file(path.string()),
+                    flom::errors::InvalidFrameError);
+  filesystem::remove(path);
+}
+
+RC_BOOST_PROP(dump_load_streaming, (const flom::Motion &m)) {
+  std::stringstream s;
+  m.dump(s);
+
+  auto const m2 = flom::Motion::load_streaming(s);
+  FLOM_ALMOST_EQUAL(m, m2);
+}
+
+RC_BOOST_PROP(dump_columnar_load_streaming, (const flom::Motion &m)) {
+  std::stringstream s;
+  m.dump_columnar(s);
+
+  // Detected as load does
+  RC_ASSERT(flom::Motion::load_streaming(s) == m);
+}
+
+RC_BOOST_PROP(read_keyframes, (const flom::Motion &m)) {
+  std::stringstream s;
+  m.dump(s);
+
+  std::vector<std::pair<double, flom::Frame>> frames;
+  auto const header = flom::read_keyframes(
+      s, [&](double t, const flom::Frame &f) { frames.emplace_back(t, f); });
+
+  RC_ASSERT(header.model_id == m.model_id());
+  RC_ASSERT(header.loop == m.loop());
+  for (auto const &[name, type] : header.effector_types) {
+    RC_ASSERT(m.effector_type(name) == type);
+  }
+  for (auto const &[name, weight] : header.effector_weights) {
+    RC_ASSERT(m.effector_weight(name) == weight);
+  }
+
+  auto const keyframes = m.const_keyframes();
+  RC_ASSERT(frames.size() == keyframes.size());
+  auto it = keyframes.begin();
+  for (auto const &[t, f] : frames) {
+    RC_ASSERT(t == (*it).first);
+    FLOM_ALMOST_EQUAL(f, (*it).second);
+    ++it;
+  }
+}
+
+RC_BOOST_PROP(load_streaming_broken, (const flom::Motion &m)) {
+  std::stringstream s;
+  m.dump(s);
+  auto data = s.str();
+  RC_PRE(data.size() > 1);
+  data.pop_back();
+
+  std::stringstream broken{data};
+  RC_ASSERT_THROWS_AS(flom::Motion::load_streaming(broken),
+                      flom::errors::ParseError);
+
+  // Frames at invalid times, appended to a motion without joints and
+  // effectors as field 4 holding only t (field 1, 64-bit)
+  flom::Motion empty{{}, {}};
+  empty.insert_keyframe(1, empty.new_keyframe());
+  for (auto const t : {-1.0, std::numeric_limits<double>::quiet_NaN()}) {
+    std::stringstream s2;
+    empty.dump(s2);
+    std::uint64_t bits;
+    std::memcpy(&bits, &t, sizeof(bits));
+    s2 << '\x22' << '\x09' << '\x09';
+    for (int i = 0; i < 8; i++) {
+      s2 << static_cast<char>((bits >> (i * 8)) & 0xff);
+    }
+
+    std::stringstream streamed{s2.str()}, loaded{s2.str()};
+    RC_ASSERT_THROWS_AS(flom::Motion::load_streaming(streamed),
+                        flom::errors::InvalidFrameError);
+    RC_ASSERT_THROWS_AS(flom::Motion::load(loaded),
+                        flom::errors::InvalidFrameError);
+  }
+}
+
+RC_BOOST_PROP(loader, (const flom::Motion &m1, const flom::Motion &m2)) {
+  flom::MotionLoader loader;
+
+  // Loads in growing and reused memory
+  for (auto const &m : {m1, m2, m1}) {
+    std::stringstream s;
+    m.dump(s);
+    auto const loaded = loader.load(s);
+    FLOM_ALMOST_EQUAL(m, loaded);
+    RC_ASSERT(loader.capacity() > 0);
+  }
+
+  std::stringstream broken{"broken"};
+  RC_ASSERT_THROWS_AS(loader.load(broken), flom::errors::ParseError);
+
+  loader.shrink_to_fit();
+  RC_ASSERT(loader.capacity() == 0);
+
+  std::stringstream s;
+  m1.dump(s);
+  FLOM_ALMOST_EQUAL(m1, loader.load(s));
+}
+
+RC_BOOST_PROP(loader_pool, (flom::Motion m)) {
+  // Enough keyframes for several chunks
+  auto const keyframes = *rc::gen::inRange<std::size_t>(1, 1000);
+  auto const t = *rc::gen::positive<double>();
+  auto const frame = m.frame_at(0);
+  for (std::size_t k = 1; k <= keyframes; k++) {
+    m.insert_keyframe(t + static_cast<double>(k), frame);
+  }
+
+  flom::ThreadPool pool{*rc::gen::inRange<std::size_t>(1, 9)};
+  flom::MotionLoader loader{pool};
+  std::stringstream s;
+  m.dump(s);
+  auto data = s.str();
+  FLOM_ALMOST_EQUAL(m, loader.load(s));
+
+  data.pop_back();
+  std::stringstream broken{data};
+  RC_ASSERT_THROWS_AS(loader.load(broken), flom::errors::ParseError);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -23,11 +23,22 @@
 #include <rapidcheck.h>
 #include <rapidcheck/boost_test.h>
 
+#include <boost/range/begin.hpp>
+#include <boost/range/empty.hpp>
 #include <boost/range/size.hpp>
 
 #include <flom/errors.hpp>
+#include <flom/frame_schema.hpp>
 #include <flom/motion.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "comparison.hpp"
 #include "generators.hpp"
 #include "printers.hpp"
@@ -50,6 +61,85 @@ RC_BOOST_PROP(insert_keyframe, (flom::Motion m)) {
   FLOM_ALMOST_EQUAL(m.frame_at(t), frame);
 }
 
+RC_BOOST_PROP(insert_keyframe_sorted, (flom::Motion m)) {
+  auto const times = *rc::gen::container<std::vector<double>>(
+      rc::gen::nonNegative<double>());
+
+  auto const size = m.const_keyframes().size();
+  auto const frame = m.new_keyframe();
+  for (auto const t : times) {
+    m.insert_keyframe(t, frame);
+    m.insert_keyframe(t, frame);
+  }
+
+  auto const range = m.const_keyframes();
+  RC_ASSERT(std::is_sorted(range.begin(), range.end(),
+                           [](auto const &a, auto const &b) {
+                             return a.first < b.first;
+                           }));
+  RC_ASSERT(std::adjacent_find(range.begin(), range.end(),
+                               [](auto const &a, auto const &b) {
+                                 return a.first == b.first;
+                               }) == range.end());
+  RC_ASSERT(range.size() >= size);
+  RC_ASSERT(m.is_valid());
+}
+
+RC_BOOST_PROP(insert_keyframe_foreign, (flom::Motion m)) {
+  auto const t = *rc::gen::nonNegative<double>();
+
+  // Same names in another schema, in reversed order
+  auto const frame = m.new_keyframe();
+  auto const &schema = *frame.schema();
+  std::vector<std::string> joints{schema.joints().names().rbegin(),
+                                  schema.joints().names().rend()};
+  std::vector<std::string> effectors{schema.effectors().names().rbegin(),
+                                     schema.effectors().names().rend()};
+  auto const foreign = frame.rebind(std::make_shared<const flom::FrameSchema>(
+      flom::NameTable{joints}, flom::NameTable{effectors}));
+
+  RC_ASSERT(m.is_valid_frame(foreign));
+  m.insert_keyframe(t, foreign);
+  FLOM_ALMOST_EQUAL(m.frame_at(t), frame);
+}
+
+RC_BOOST_PROP(insert_keyframes, (flom::Motion m)) {
+  auto times = *rc::gen::container<std::vector<double>>(
+      rc::gen::nonNegative<double>());
+  // Existing and repeated times
+  times.push_back(0);
+  times.push_back(m.length());
+  times.push_back(times.front());
+
+  auto expected = m;
+  std::vector<std::pair<double, flom::Frame>> frames;
+  for (auto const t : times) {
+    auto frame = m.new_keyframe();
+    if (!boost::empty(m.joint_names())) {
+      frame.set_position(*boost::begin(m.joint_names()), t);
+    }
+    expected.insert_keyframe(t, frame);
+    frames.emplace_back(t, std::move(frame));
+  }
+
+  m.insert_keyframes(std::move(frames));
+  RC_ASSERT(m.is_valid());
+  RC_ASSERT(m == expected);
+}
+
+RC_BOOST_PROP(insert_keyframes_invalid,
+              (flom::Motion m, const flom::Frame &f)) {
+  RC_PRE(!m.is_valid_frame(f));
+
+  auto const original = m;
+  std::vector<std::pair<double, flom::Frame>> frames;
+  frames.emplace_back(1, m.new_keyframe());
+  frames.emplace_back(2, f);
+  RC_ASSERT_THROWS_AS(m.insert_keyframes(std::move(frames)),
+                      flom::errors::InvalidFrameError);
+  RC_ASSERT(m == original);
+}
+
 RC_BOOST_PROP(insert_init_keyframe, (flom::Motion m)) {
   //
   // Check if insertion to t == 0 is working properly
@@ -106,6 +196,24 @@ RC_BOOST_PROP(delete_keyframe, (flom::Motion m)) {
                       flom::errors::KeyframeNotFoundError);
 }
 
+RC_BOOST_PROP(validity_tracked, (flom::Motion m)) {
+  auto const t = *rc::gen::positive<double>();
+
+  RC_ASSERT(m.is_valid());
+  m.insert_keyframe(-t, m.new_keyframe());
+  RC_ASSERT(!m.is_valid());
+  auto const invalid = m;
+  std::ostringstream os;
+  RC_ASSERT_THROWS_AS(invalid.dump(os), flom::errors::InvalidFrameError);
+
+  m.delete_keyframe(-t);
+  RC_ASSERT(m.is_valid());
+  RC_ASSERT(!invalid.is_valid());
+  m.insert_keyframe(t, m.new_keyframe());
+  m.clear_keyframes();
+  RC_ASSERT(m.is_valid());
+}
+
 RC_BOOST_PROP(clear_keyframe, (flom::Motion m)) {
   RC_ASSERT(m.is_valid());
 
@@ -0,0 +1,91 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <flom/errors.hpp>
+#include <flom/motion.hpp>
+#include <flom/sample_buffer.hpp>
+
+#include "comparison.hpp"
+#include "generators.hpp"
+#include "printers.hpp"
+
+BOOST_AUTO_TEST_SUITE(motion_sample)
+
+RC_BOOST_PROP(sample, (const flom::Motion &m)) {
+  auto const times = *rc::gen::container<std::vector<double>>(
+      rc::gen::nonNegative<double>());
+  RC_PRE(std::all_of(std::cbegin(times), std::cend(times),
+                     [&m](double t) { return m.is_in_range_at(t); }));
+
+  auto const buffer = m.sample(times);
+  RC_ASSERT(buffer.size() == times.size());
+  for (std::size_t i = 0; i < times.size(); i++) {
+    FLOM_ALMOST_EQUAL(buffer.frame(i), m.frame_at(times[i]));
+  }
+}
+
+RC_BOOST_PROP(sample_temporary, (const flom::Motion &m)) {
+  auto const length = m.length();
+  RC_PRE(m.is_in_range_at(length));
+
+  // Binds to span<const double> without a named vector
+  auto const buffer = m.sample(std::vector<double>{length, 0, length / 2});
+  RC_ASSERT(buffer.size() == 3);
+  FLOM_ALMOST_EQUAL(buffer.frame(0), m.frame_at(length));
+  FLOM_ALMOST_EQUAL(buffer.frame(1), m.frame_at(0));
+  FLOM_ALMOST_EQUAL(buffer.frame(2), m.frame_at(length / 2));
+}
+
+RC_BOOST_PROP(sample_sorted, (const flom::Motion &m)) {
+  auto times = *rc::gen::container<std::vector<double>>(
+      rc::gen::nonNegative<double>());
+  std::sort(std::begin(times), std::end(times));
+  RC_PRE(std::all_of(std::cbegin(times), std::cend(times),
+                     [&m](double t) { return m.is_in_range_at(t); }));
+
+  flom::SampleBuffer buffer;
+  m.sample(times, buffer);
+  RC_ASSERT(buffer.size() == times.size());
+  for (std::size_t i = 0; i < times.size(); i++) {
+    FLOM_ALMOST_EQUAL(buffer.frame(i), m.frame_at(times[i]));
+  }
+}
+
+RC_BOOST_PROP(sample_out_of_frames, (const flom::Motion &m)) {
+  RC_PRE(m.loop() == flom::LoopType::None);
+
+  std::vector<double> const times{0, m.length() + 1};
+  RC_ASSERT_THROWS_AS(m.sample(times), flom::errors::OutOfFramesError);
+}
+
+RC_BOOST_PROP(sample_invalid_time, (const flom::Motion &m)) {
+  std::vector<double> const times{0, -1};
+  RC_ASSERT_THROWS_AS(m.sample(times), flom::errors::InvalidTimeError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#include <flom/motion.hpp>
+
+#include <cmath>
+#include <string>
+#include <unordered_set>
+
+#include "comparison.hpp"
+#include "generators.hpp"
+#include "printers.hpp"
+
+namespace {
+
+// Whether frames of b at keyframe times of a are within the errors,
+// with some slack for rounding
+bool within(const flom::Motion &a, const flom::Motion &b, double position,
+            double rotation) {
+  auto const near = [](double x, double y, double error) {
+    return x == y ||
+           std::abs(x - y) <= error + 1e-9 * (1 + std::abs(x) + std::abs(y));
+  };
+
+  for (auto const &[t, fa] : a.const_keyframes()) {
+    auto const fb = b.frame_at(t);
+    auto const pb = fb.positions();
+    for (auto const &[name, v] : fa.positions()) {
+      if (!near(v, pb.at(name), position)) {
+        return false;
+      }
+    }
+    auto const eb = fb.effectors();
+    for (auto const &[name, e] : fa.effectors()) {
+      auto const &other = eb.at(name);
+      if (e.location() &&
+          !near(0, (e.location()->vector() - other.location()->vector()).norm(),
+                position)) {
+        return false;
+      }
+      if (e.rotation() &&
+          !near(0,
+                e.rotation()->quaternion().angularDistance(
+                    other.rotation()->quaternion()),
+                rotation)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(motion_simplify)
+
+RC_BOOST_PROP(simplify_within, (const flom::Motion &m)) {
+  auto const position = *rc::gen::element(0.0, 1e-3, 0.1, 10.0);
+  auto const rotation = *rc::gen::element(0.0, 1e-3, 0.1, 1.0);
+
+  auto s = m;
+  s.simplify(position, rotation);
+  RC_ASSERT(s.is_valid());
+  RC_ASSERT(s.const_keyframes().size() <= m.const_keyframes().size());
+  RC_ASSERT(s.length() == m.length());
+  RC_ASSERT(s.loop() == m.loop());
+  RC_ASSERT(s.model_id() == m.model_id());
+  RC_ASSERT(within(m, s, position, rotation));
+}
+
+RC_BOOST_PROP(simplify_detaches, (const flom::Motion &m)) {
+  auto const original = m;
+  auto s = m;
+  s.simplify(1e6, 1e6);
+  RC_ASSERT(m == original);
+  RC_ASSERT(s.const_keyframes().size() <= 2);
+}
+
+BOOST_AUTO_TEST_CASE(simplify_linear) {
+  auto const world = flom::CoordinateSystem::World;
+  auto const motion = [&](auto &&position) {
+    flom::Motion m{{"joint"}, {{"hand", flom::EffectorType{world, world}}}};
+    for (int k = 1; k <= 100; k++) {
+      auto const t = k / 50.0;
+      auto frame = m.new_keyframe();
+      frame.set_position("joint", position(t));
+      frame.set_effector(
+          "hand",
+          flom::Effector{flom::Location{t, 2 * t, -t},
+                         flom::Rotation{std::cos(t / 2), 0, 0, std::sin(t / 2)}});
+      m.insert_keyframe(t, frame);
+    }
+    return m;
+  };
+
+  // Constant velocities are interpolated from the ends
+  auto const linear = motion([](double t) { return 3 * t; });
+  auto s = linear;
+  s.simplify(1e-9, 1e-9);
+  BOOST_TEST(s.const_keyframes().size() == 2);
+  BOOST_TEST(within(linear, s, 1e-9, 1e-9));
+
+  // A bend in the middle is kept
+  auto const bent = motion([](double t) { return t < 1 ? t : 2 - t; });
+  s = bent;
+  s.simplify(1e-9, 1e-9);
+  BOOST_TEST(s.const_keyframes().size() == 3);
+  BOOST_TEST(within(bent, s, 1e-9, 1e-9));
+
+  // Tolerances larger than the bend remove it
+  s = bent;
+  s.simplify(1.5, 1e-9);
+  BOOST_TEST(s.const_keyframes().size() == 2);
+  BOOST_TEST(within(bent, s, 1.5, 1e-9));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
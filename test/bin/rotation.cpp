@@ -24,6 +24,11 @@
 #include <rapidcheck/boost_test.h>
 
 #include <flom/effector.hpp>
+#include <flom/interpolation.hpp>
+
+#include <cmath>
+#include <tuple>
+#include <vector>
 
 #include "comparison.hpp"
 #include "generators.hpp"
@@ -47,6 +52,13 @@ RC_BOOST_PROP(mul_scalar, (const flom::Rotation &rot, unsigned short v)) {
   FLOM_ALMOST_EQUAL(rot1, rot2);
 }
 
+RC_BOOST_PROP(mul_scalar_split,
+              (const flom::Rotation &rot, unsigned v1, unsigned v2)) {
+  auto const n1 = static_cast<std::size_t>(v1);
+  auto const n2 = static_cast<std::size_t>(v2);
+  FLOM_ALMOST_EQUAL(rot * (n1 + n2), rot * n1 + rot * n2);
+}
+
 RC_BOOST_PROP(sub, (const flom::Rotation &rot1, const flom::Rotation &rot2)) {
   auto const res = rot1 - rot2;
   auto const div_quat = rot1.quaternion() * rot2.quaternion().conjugate();
@@ -76,4 +88,44 @@ RC_BOOST_PROP(set_values_normalized,
   FLOM_ALMOST_EQUAL(v.quaternion().norm(), 1);
 }
 
+RC_BOOST_PROP(slerp_n, (const std::vector<flom::Rotation> &a)) {
+  const double t = static_cast<double>(*rc::gen::inRange(0, 100)) / 100;
+
+  // Mix in opposite signs and nearly identical quaternions
+  std::vector<flom::Rotation> b;
+  for (auto const &r : a) {
+    switch (*rc::gen::inRange(0, 3)) {
+    case 0:
+      b.push_back(*rc::gen::arbitrary<flom::Rotation>());
+      break;
+    case 1:
+      b.emplace_back(-r.w(), -r.x(), -r.y(), -r.z());
+      break;
+    default:
+      b.emplace_back(r.w() + 1e-9, r.x(), r.y(), r.z());
+      break;
+    }
+  }
+
+  auto const n = a.size();
+  std::vector<double> pa(n * 4), pb(n * 4), out(n * 4);
+  auto const qa = flom::planar_quaternions(pa.data(), n);
+  auto const qb = flom::planar_quaternions(pb.data(), n);
+  for (std::size_t i = 0; i < n; i++) {
+    std::tie(qa.w[i], qa.x[i], qa.y[i], qa.z[i]) = a[i].wxyz();
+    std::tie(qb.w[i], qb.x[i], qb.y[i], qb.z[i]) = b[i].wxyz();
+  }
+
+  auto const qo = flom::planar_quaternions(out.data(), n);
+  flom::slerp_n(t, flom::planar_quaternions<const double>(pa.data(), n),
+                flom::planar_quaternions<const double>(pb.data(), n), qo, n);
+  for (std::size_t i = 0; i < n; i++) {
+    auto const [w, x, y, z] = flom::interpolate(t, a[i], b[i]).wxyz();
+    RC_ASSERT(std::abs(qo.w[i] - w) <= 1e-12);
+    RC_ASSERT(std::abs(qo.x[i] - x) <= 1e-12);
+    RC_ASSERT(std::abs(qo.y[i] - y) <= 1e-12);
+    RC_ASSERT(std::abs(qo.z[i] - z) <= 1e-12);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
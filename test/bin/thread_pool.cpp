@@ -0,0 +1,95 @@
+//
+// Copyright 2018 coord.e
+//
+// This file is part of Flom.
+//
+// Flom is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Flom is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Flom.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define BOOST_TEST_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <rapidcheck.h>
+#include <rapidcheck/boost_test.h>
+
+#include <flom/thread_pool.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(thread_pool)
+
+RC_BOOST_PROP(run_each, ()) {
+  auto const threads = *rc::gen::inRange<std::size_t>(1, 9);
+  auto const jobs = *rc::gen::inRange<std::size_t>(0, 5);
+  flom::ThreadPool pool{threads};
+  RC_ASSERT(pool.size() == threads);
+
+  for (std::size_t j = 0; j < jobs; j++) {
+    auto const n = *rc::gen::inRange<std::size_t>(0, 2000);
+    std::vector<std::atomic<int>> counts(n);
+    pool.run(n, [&counts](std::size_t i) noexcept { counts[i]++; });
+    for (auto const &c : counts) {
+      RC_ASSERT(c.load() == 1);
+    }
+  }
+}
+
+RC_BOOST_PROP(run_throws, ()) {
+  auto const threads = *rc::gen::inRange<std::size_t>(1, 9);
+  auto const n = *rc::gen::inRange<std::size_t>(1, 2000);
+  auto const failing = *rc::gen::inRange<std::size_t>(0, n);
+  flom::ThreadPool pool{threads};
+
+  RC_ASSERT_THROWS_AS(pool.run(n,
+                               [failing](std::size_t i) {
+                                 if (i == failing) {
+                                   throw std::runtime_error{"failed"};
+                                 }
+                               }),
+                      std::runtime_error);
+
+  // Still usable
+  std::atomic<std::size_t> sum{0};
+  pool.run(n, [&sum](std::size_t i) noexcept { sum += i; });
+  RC_ASSERT(sum.load() == n * (n - 1) / 2);
+}
+
+BOOST_AUTO_TEST_CASE(default_size) {
+  flom::ThreadPool pool;
+  BOOST_TEST(pool.size() ==
+             std::max(1u, std::thread::hardware_concurrency()));
+}
+
+BOOST_AUTO_TEST_CASE(run_concurrently) {
+  flom::ThreadPool pool{4};
+  std::atomic<std::size_t> sum{0};
+  std::vector<std::thread> callers;
+  for (int c = 0; c < 4; c++) {
+    callers.emplace_back([&pool, &sum] {
+      for (int j = 0; j < 50; j++) {
+        pool.run(100, [&sum](std::size_t) noexcept { sum++; });
+      }
+    });
+  }
+  for (auto &t : callers) {
+    t.join();
+  }
+  BOOST_TEST(sum.load() == 4u * 50u * 100u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()